@@ -0,0 +1,49 @@
+#ifndef _GB_EMU_BENCHMARK_H_
+#define  _GB_EMU_BENCHMARK_H_
+
+#include "..\inc\emulator.h"
+
+#include <vector>
+#include <string>
+#include <chrono>
+
+class BenchmarkFramework final{
+public:
+    bool start();
+private:
+    struct Benchmark{
+        std::string benchmarkName;
+        void (BenchmarkFramework::*run)();
+    };
+    std::vector<Benchmark> benchmarks 
+    {
+        {"Opcode dispatch", &BenchmarkFramework::benchOpcodeDispatch},
+        {"Block cache", &BenchmarkFramework::benchBlockCache},
+        {"Dynarec", &BenchmarkFramework::benchDynarec},
+        {"CB opcodes", &BenchmarkFramework::benchCBOpcodes},
+        {"Superinstructions", &BenchmarkFramework::benchSuperinstructions},
+        {"Memory reads", &BenchmarkFramework::benchMemoryReads},
+        {"Cartridge loading", &BenchmarkFramework::benchCartridgeLoading},
+        {"Scanline rendering", &BenchmarkFramework::benchScanlineRendering}
+    };
+    // CPU benchmarks
+    void benchOpcodeDispatch();
+    void benchBlockCache();
+    void benchDynarec();
+    void benchCBOpcodes();
+    void benchSuperinstructions();
+    void runOpcodeLoop(bool blockCache, CPUEngine engine = CPUEngine::interpreter);
+    void runProgram(std::vector<uint8_t> const& program, bool blockCache, CPUEngine engine = CPUEngine::interpreter);
+    void runBatches(std::vector<uint8_t> const& program, bool superinstructions);
+    // Memory map benchmarks
+    void benchMemoryReads();
+    void benchCartridgeLoading();
+    // GPU benchmarks
+    void benchScanlineRendering();
+    void runScanlines(PixelKernels const& kernels);
+    // Utility functions
+    void report(std::string const& metric, double value, std::string const& unit);
+    double secondsSince(std::chrono::time_point<std::chrono::high_resolution_clock> tStart);
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,70 @@
+#ifndef _GB_EMU_BLOCK_CACHE_H_
+#define  _GB_EMU_BLOCK_CACHE_H_
+
+#include "..\inc\memory_map.h"
+
+#include <cstdint>
+#include <vector>
+
+class CPU;
+
+// Native code for a block, as generated by the Dynarec - returns the number of cycles taken
+using NativeBlock = uint32_t (*)(CPU*);
+
+// A single pre-decoded instruction: the handler to run, plus the opcode bytes for the log
+struct DecodedOpcode final{
+    uint16_t (*handler)(CPU&);
+    uint16_t address;
+    uint8_t opcode;
+    uint8_t opcodeCB;
+    bool CBPrefixed;
+};
+
+// Hot loops which may be run as a single step (see CPU::executeSuperinstruction)
+//  poll: LDH A,(u8) ; CP/AND u8, AND/OR A or BIT b,A ; JR cc back to the LDH
+//  delay: DEC r ; JR NZ back, or DEC rr ; LD A,r ; OR r ; JR NZ back
+//  fill: LD (HL+/-),A ; DEC r ; JR NZ back
+//  copy: LD A,(HL+) ; LD (DE),A ; INC DE (or LD A,(DE) ; LD (HL+),A ; INC DE), then DEC r ; JR NZ back or
+//        DEC BC ; LD A,B ; OR C ; JR NZ back
+enum class Superinstruction : uint8_t{none, poll, delay, fill, copy};
+
+// Straight-line run of instructions up to (and including) the first branch
+struct DecodedBlock final{
+    static uint32_t constexpr invalidKey = 0xFFFFFFFF;
+    uint32_t key = invalidKey;
+    uint32_t writeCount = 0; // Sum of MemoryMap write counts over the bytes decoded
+    uint16_t startAddress = 0;
+    uint16_t endAddress = 0; // Last byte of the final instruction
+    bool inRAM = false; // Code in RAM may be overwritten while the block is running
+    std::vector<DecodedOpcode> opcodes;
+    // The loop formed by the block branching back to its start, if it is a superinstruction
+    Superinstruction superinstruction = Superinstruction::none;
+    uint8_t counterOpcode = 0x00; // DEC of the register counting iterations down to zero
+    uint16_t iterationCycles = 0; // Cycles taken by an iteration which branches back
+    // Dynarec state
+    uint32_t executionCount = 0;
+    NativeBlock native = nullptr;
+    uint32_t nativeGeneration = 0;
+    bool nativeRefused = false;
+};
+
+// Direct-mapped cache of decoded blocks, keyed by ROM bank and start address
+// Blocks in RAM are invalidated when any of their bytes are written
+class BlockCache final{
+public:
+    BlockCache(MemoryMap const& memMap);
+    DecodedBlock* find(uint16_t address);
+    DecodedBlock& allocate(uint16_t address);
+    void seal(DecodedBlock& block) const;
+    bool isValid(DecodedBlock const& block) const;
+    uint16_t cacheableRegionEnd(uint16_t address) const;
+    void clear();
+private:
+    uint32_t makeKey(uint16_t address) const;
+    uint32_t sumWriteCounts(uint16_t startAddress, uint16_t endAddress) const;
+    static std::size_t constexpr numBlocks = 0x1000;
+    MemoryMap const& memoryMap;
+    std::vector<DecodedBlock> blocks;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,65 @@
+#ifndef _GB_EMU_CARTRIDGE_H_
+#define  _GB_EMU_CARTRIDGE_H_
+
+#include "..\inc\file_image.h"
+#include "..\inc\save_ram.h"
+
+#include <cstdint>
+#include <vector>
+#include <array>
+#include <string>
+#include <memory>
+
+// The cartridge ROM and RAM, and the memory bank controller (MBC) which selects the banks visible to the CPU
+// Banks are never copied - the MemoryMap points its pages at whichever banks are selected, and repoints them
+// after every write to the MBC's registers (see MemoryMap::mapBanks)
+class Cartridge final{
+public:
+    Cartridge();
+    // Battery-backed RAM is kept in a save file alongside the cartridge, with the extension .sav
+    bool load(std::string const& path);
+    // Writes to 0x0000-0x7FFF, which select banks rather than changing the ROM
+    void writeRegister(uint16_t address, uint8_t value);
+    // The 16 KB ROM bank visible at address (in 0x0000-0x7FFF) and its index
+    uint8_t const* getROMBankData(uint16_t address) const{ return rom->data() + 0x4000 * getROMBank(address); }
+    uint16_t getROMBank(uint16_t address) const{ return address < 0x4000 ? lowerROMBank : upperROMBank; }
+    // The 8 KB RAM bank visible at 0xA000-0xBFFF, or nullptr if accesses must go through readRAM/writeRAM
+    // (while RAM is disabled, or for MBC2 RAM or the MBC3 clock)
+    uint8_t* getRAMBankData();
+    uint8_t readRAM(uint16_t address) const;
+    void writeRAM(uint16_t address, uint8_t value);
+    // The MBC3 clock counts emulated time
+    void advanceClock(uint16_t cycles){ clock.cycles += cycles; }
+    // Starts writing battery-backed RAM back to the save file, if there is one (empty if not)
+    void flushRAM(){ ram.flush(); }
+    std::string const& getSavePath() const{ return ram.getPath(); }
+private:
+    enum class MBCType : uint8_t{none, MBC1, MBC2, MBC3, MBC5};
+    void enableRAM(uint8_t value);
+    void selectBanks();
+    void updateClock();
+    std::shared_ptr<FileImage const> rom; // Mapped from the file and shared by copies, as it cannot change
+    SaveRAM ram;
+    MBCType type = MBCType::none;
+    uint16_t romBankCount = 2; // Always a power of two
+    uint16_t ramBankCount = 1;
+    // MBC registers
+    bool ramEnabled = false;
+    uint16_t romBankRegister = 1; // Lower bits of the ROM bank (all 9 bits for MBC5)
+    uint8_t bankRegister = 0; // RAM bank, MBC1 upper ROM bank bits or MBC3 clock register
+    bool bankingMode = false; // MBC1 only - the upper bits also select the bank at 0x0000 and the RAM bank
+    // Banks selected by the registers
+    uint16_t lowerROMBank = 0;
+    uint16_t upperROMBank = 1;
+    uint8_t ramBank = 0;
+    // MBC3 real time clock - seconds, minutes, hours, day (lower 8 bits) and day (upper bit), halt and day carry
+    struct Clock{
+        std::array<uint8_t, 5> registers{};
+        std::array<uint8_t, 5> latchedRegisters{};
+        uint64_t cycles = 0; // Emulated cycles not yet counted in the registers
+        uint8_t latchWrite = 0xFF; // Last value written to 0x6000-0x7FFF (latched on a write of 0 then 1)
+    } clock;
+    static uint32_t constexpr cyclesPerSecond = 4194304;
+};
+
+#endif
\ No newline at end of file
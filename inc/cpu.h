@@ -3,15 +3,34 @@
 
 #include "..\inc\registers.h"
 #include "..\inc\memory_map.h"
+#include "..\inc\block_cache.h"
+#include "..\inc\dynarec.h"
+#include "..\inc\trace.h"
+#include "..\inc\trace_file.h"
+#include "..\inc\profiler.h"
+#include "..\inc\opcode_info.h"
 
 #include <cstdint>
 #include <iostream>
 #include <iomanip>
-#include <deque>
 #include <algorithm>
+#include <array>
+#include <utility>
+#include <memory>
+#include <bit>
 
 #include <SDL.h>
 
+// Opcode dispatch strategy is selected at build time:
+//  default: compile-time generated tables of per-opcode handlers
+//  -DGB_EMU_COMPUTED_GOTO: computed goto into inlined handlers (GCC/Clang only, falls back to tables otherwise)
+#if defined(GB_EMU_COMPUTED_GOTO) && (defined(__GNUC__) || defined(__clang__))
+#define GB_EMU_USE_COMPUTED_GOTO
+#endif
+
+// -DGB_EMU_LAZY_FLAGS: 8-bit ALU operations record their operands instead of updating F,
+// which is only built when the flags are next read
+
 struct CPUState final{
     std::vector<uint8_t> memory;
     HalfRegister A, F, B, C, D, E, H, L;
@@ -20,38 +39,106 @@ struct CPUState final{
     bool operator==(const CPUState&) const = default;
 };
 
-class CPU final{
+// interpreter: cached interpreter only
+// jit: hot ROM blocks run as native code (where supported)
+// differential: as jit, but every native block is checked against the interpreter
+enum class CPUEngine{interpreter, jit, differential};
+
+// Registers are inherited from the register file, so handlers can name them directly
+class CPU final : private RegisterFile{
+    friend class Dynarec;
 public:
     CPU(MemoryMap& memMap);
     uint16_t executeNextOpcode();
+    uint32_t run(uint32_t cycleBudget, uint32_t nextEventCycle);
     void handleInterrupts();
     void requestInterrupt(uint8_t interrupt);
     void finish();
+    void printTrace(std::size_t count = traceDumpLength);
+    void startTraceFile(std::string const& path);
+    void reportProfile(std::string const& csvPath = "") const;
+    void startGuestProfile(std::string const& symbolPath = "");
+    uint32_t cyclesUntilGuestSample() const;
+    void sampleGuest(uint16_t cycles);
+    void writeGuestProfile(std::string const& path) const;
     void toggleHalt();
+    bool isHalted() const;
+    uint16_t getIdleLoopCycles() const;
     void simulateBoot();
     void getState(CPUState& state);
     void setState(CPUState const& state);
     void processInput(uint8_t buttonInput, uint8_t directionInput);
+    void enableBlockCache(bool enabled = true);
+    void enableSuperinstructions(bool enabled = true);
+    void setEngine(CPUEngine newEngine);
+#ifdef GB_EMU_USE_COMPUTED_GOTO
+    static constexpr char const* dispatchStrategy = "computed goto";
+#else
+    static constexpr char const* dispatchStrategy = "handler table";
+#endif
 private:
     MemoryMap& memoryMap;
-    Register AF, BC, DE, HL;
-    HalfRegister &A = AF.upperByte;
-    HalfRegister &F = AF.lowerByte;
-    HalfRegister &B = BC.upperByte;
-    HalfRegister &C = BC.lowerByte;
-    HalfRegister &D = DE.upperByte;
-    HalfRegister &E = DE.lowerByte;
-    HalfRegister &H = HL.upperByte;
-    HalfRegister &L = HL.lowerByte;
-
-    Register SP;
-    Register PC;
 
     uint8_t clockT, clockM; // technically these are each 16bit, but with only upperByte exposed
     
     uint16_t executeOpcode(uint8_t opcode);
     uint16_t executeCBOpcode(uint8_t opcode);
 
+    // Per-opcode handlers, instantiated for all 256 (+ 256 CB) opcodes to build the dispatch tables
+    using OpcodeTable = std::array<uint16_t (*)(CPU&), 0x100>;
+    template <bool CBPrefixed, std::size_t... opcodes>
+    static constexpr OpcodeTable makeOpcodeTable(std::index_sequence<opcodes...>);
+    template <uint8_t opcode> static uint16_t dispatchOpcode(CPU& cpu);
+    template <uint8_t opcode> static uint16_t dispatchCBOpcode(CPU& cpu);
+    template <uint8_t opcode> uint16_t executeOpcode();
+    template <uint8_t opcode> uint16_t executeCBOpcode();
+    static OpcodeTable const opcodeTable;
+    static OpcodeTable const opcodeCBTable;
+
+    // Cached interpreter - runs pre-decoded blocks instead of fetching and dispatching each opcode
+    uint16_t executeCachedOpcode();
+    bool atBlockBoundary() const;
+    DecodedBlock* enterBlock();
+    DecodedBlock* decodeBlock(uint16_t address);
+    BlockCache blockCache;
+    bool blockCacheEnabled = true;
+    DecodedBlock const* currentBlock = nullptr;
+    uint32_t currentBlockGeneration = 0; // ROM bank generation when the current block was entered
+    std::size_t nextOpcodeIndex = 0;
+    std::size_t const maxBlockLength = 32;
+
+    // Native execution of hot blocks, optionally checked against a shadow interpreter
+    uint16_t executeNativeBlock(DecodedBlock const& block);
+    uint16_t verifyNativeBlock(DecodedBlock const& block);
+    CPUEngine engine = CPUEngine::interpreter;
+    Dynarec dynarec;
+    std::unique_ptr<MemoryMap> shadowMemoryMap;
+    std::unique_ptr<CPU> shadowCPU;
+    uint32_t nativeOpcodesRun = 0; // Instructions run by the last native block, stored by native code only if it leaves early
+
+    // Superinstructions - loops recognised as their blocks are decoded, and run as a single step within a batch
+    void recogniseSuperinstruction(DecodedBlock& block) const;
+    uint32_t executeSuperinstruction(uint32_t cycleBudget, bool synced);
+    uint32_t loopIterations(uint8_t counterOpcode);
+    void countDownLoop(uint8_t counterOpcode, uint16_t iterations);
+    HalfRegister& registerByIndex(uint8_t index);
+    bool superinstructionsEnabled = true;
+
+    // Batched execution - instructions which may access I/O registers or enable interrupts are run one at a time
+    bool nextOpcodeNeedsSync() const;
+
+    // Idle loop detection - checked whenever a branch is taken backwards, remembering the last loop analysed
+    void checkIdleLoop(uint16_t branchAddress);
+    uint16_t analyseIdleLoop(uint16_t start, uint16_t branchAddress) const;
+    struct IdleLoop{
+        uint32_t key = DecodedBlock::invalidKey; // ROM bank and start address, as for cached blocks
+        uint16_t branchAddress = 0;
+        uint16_t cycles = 0; // Cycles per iteration, or 0 if the loop is not idle
+        std::array<uint16_t, 3> pointers{}; // BC, DE and HL when analysed, which the loop may poll through
+    } idleLoop;
+    bool idleLoopRepeated = false; // The last instruction closed the idle loop
+    uint16_t const maxIdleLoopLength = 16; // Bytes
+
     uint16_t readWordAtPC();
     uint8_t readByteAtPC();
 
@@ -135,45 +222,21 @@ private:
     uint16_t CPru8(HalfRegister& reg);
     uint16_t CPL();
 
-    // Bit operations (test, set, clear)
-    uint16_t BITbr(uint8_t bit /*really u3 would be enough!*/, HalfRegister const& reg);
-    uint16_t BITbnn(uint8_t bit, uint16_t address);
-    uint16_t SETbr(uint8_t bit, HalfRegister& reg);
-    uint16_t SETbnn(uint8_t bit, uint16_t address);
-    uint16_t RESbr(uint8_t bit, HalfRegister& reg);
-    uint16_t RESbnn(uint8_t bit, uint16_t address);
-
     // Enable/disable interrupts
     uint16_t EI();
     uint16_t DI();
 
-    // Rotate - old carry flag rotated in, carry flag set to rotated out value 
-    uint16_t RLr(HalfRegister& reg);
-    uint16_t RRr(HalfRegister& reg);
-    uint16_t RLHL();
-    uint16_t RRHL();
-
-    // Rotate circular - a cyclic permutation, carry flag set as before
-    uint16_t RLCr(HalfRegister& reg);
-    uint16_t RRCr(HalfRegister& reg);
-    uint16_t RLCHL();
-    uint16_t RRCHL();
-
-    // Special rotations
+    // Special rotations (the accumulator versions of RLC, RL, RRC and RR, which always clear the zero flag)
     uint16_t RLCA();
     uint16_t RLA();
     uint16_t RRCA();
     uint16_t RRA();
 
-    // Shift/swap operations
-    uint16_t SLAr(HalfRegister& reg);
-    uint16_t SLAHL();
-    uint16_t SRAr(HalfRegister& reg);
-    uint16_t SRAHL();
-    uint16_t SRLr(HalfRegister& reg);
-    uint16_t SRLHL();
-    uint16_t SWAPr(HalfRegister& reg);
-    uint16_t SWAPHL();
+    // CB-prefixed operations, generated from the fields of the opcode (see executeCBOpcode)
+    template <uint8_t operand> HalfRegister& registerCB();
+    template <uint8_t operation> uint8_t shiftCB(uint8_t value);
+    template <uint8_t bit> void testBitCB(uint8_t value);
+    template <uint8_t group, uint8_t bit> uint8_t operateCB(uint8_t value);
 
     // Jump operations
     uint16_t JPnn(uint16_t address);
@@ -197,21 +260,39 @@ private:
     void clearFlag(uint8_t flag);
     bool isFlagSet(uint8_t flag);
 
-    void initOpcodeInfo();
+    // Lazy flags (no-ops unless GB_EMU_LAZY_FLAGS is defined) - resolveFlags must be called before F is
+    // read directly, and discardPendingFlags after F is written directly
+    void resolveFlags();
+    void discardPendingFlags();
+#ifdef GB_EMU_LAZY_FLAGS
+    enum class FlagOperation : uint8_t{none, add, sub, inc, dec, logicAnd, logicOr};
+    struct PendingFlags{
+        FlagOperation operation = FlagOperation::none;
+        uint8_t x, y, carry; // Operands (or result, for logic operations) and carry in
+    } pendingFlags;
+    void deferFlags(FlagOperation operation, uint8_t x, uint8_t y = 0, uint8_t carry = 0);
+    uint8_t carryFlag();
+#endif
 
     void printOpcode(uint8_t opcode);
-    void printOpcodeInfo(uint8_t opcode);
-    void printOpcodeCBInfo(uint8_t opcode);
 
     bool halted = false;
     bool interruptsEnabled = false;
-    std::vector<std::string> opcodeInfo;
-    std::vector<std::string> opcodeCBInfo;
 
-    void addOpcodeToLog(uint8_t opcode);
-    void printRecentOpcodes();
-    unsigned int const maxOpcodeLookback = 8;
-    std::deque<uint8_t> recentOpcodes;
+    // Instruction trace (see trace.h)
+    void traceOpcode(uint16_t address, uint8_t opcode);
+    InstructionTrace trace;
+    uint64_t traceCycles = 0; // Cycles executed, for trace timestamps (only counted when tracing)
+    std::unique_ptr<TraceWriter> traceWriter;
+    static std::size_t constexpr traceDumpLength = 32;
+
+    // Opcode profile (see profiler.h)
+    template <typename Execute> uint16_t profileOpcode(uint16_t address, uint8_t opcode, Execute execute);
+    ExecutionProfiler profiler;
+
+    // Guest profile (see profiler.h) - only a null check per call and return while it is not running
+    uint32_t codeLocation(uint16_t address) const;
+    std::unique_ptr<GuestProfiler> guestProfiler;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,76 @@
+#ifndef _GB_EMU_DYNAREC_H_
+#define  _GB_EMU_DYNAREC_H_
+
+#include "..\inc\block_cache.h"
+
+#include <cstdint>
+#include <initializer_list>
+#include <vector>
+
+// Native code generation is only supported on x86-64 hosts (System V and Windows ABIs)
+#if defined(__x86_64__) || defined(_M_X64)
+#define GB_EMU_DYNAREC_AVAILABLE
+#endif
+
+class CPU;
+
+// Dynamic recompiler - translates hot blocks of ROM code into native x86-64 code
+// Register loads, ALU operations and branches are emitted inline, memory accesses call back into
+// the MemoryMap, and every other instruction calls its interpreter handler, so any block can be
+// compiled. Blocks in RAM (which may be self-modifying) and blocks accessing I/O registers or writing to
+// the MBC at fixed addresses are left to the interpreter, and native code returns to the interpreter before
+// any instruction which would do either through a pointer
+class Dynarec final{
+public:
+    Dynarec() = default;
+    ~Dynarec();
+    Dynarec(Dynarec const&) = delete;
+    Dynarec& operator=(Dynarec const&) = delete;
+    static bool isAvailable();
+    NativeBlock getNativeBlock(DecodedBlock& block, CPU& cpu);
+private:
+    NativeBlock compile(DecodedBlock const& block, CPU& cpu);
+    bool needsInterpreter(DecodedBlock const& block, CPU& cpu) const;
+    bool allocateCodeBuffer();
+    void flush();
+
+    // Calls from native code
+    static uint8_t readByte(CPU* cpu, uint16_t address);
+    static void writeByte(CPU* cpu, uint16_t address, uint8_t value);
+    static void resolveFlags(CPU* cpu);
+
+    // x86-64 code emission - SM83 registers are accessed relative to the CPU pointer held in rbx
+    void emit(std::initializer_list<uint8_t> bytes);
+    void emit16(uint16_t value);
+    void emit32(uint32_t value);
+    void emit64(uint64_t value);
+    void emitCPUOperand(uint8_t reg, int32_t offset);
+    void emitLoadByte(uint8_t reg, int32_t offset);
+    void emitStoreByte(int32_t offset, uint8_t reg);
+    void emitArgCPU();
+    void emitArgWord(uint8_t arg, int32_t offset);
+    void emitArgByte(uint8_t arg, int32_t offset);
+    void emitCall(uintptr_t function);
+    void emitFlags(bool zero, bool halfCarry, bool carry, uint8_t setBits, bool preserveCarry, int32_t offsetF);
+    std::size_t emitJump(uint8_t conditionOpcode);
+    void patchJump(std::size_t jump);
+    void patchJump(std::size_t jump, std::size_t target);
+    void emitAccessGuard(int32_t pairOffset, int8_t offset, bool write, std::vector<std::size_t>& exitJumps);
+
+    // Where native code leaves a block early, handing the instruction at address to the interpreter
+    struct Exit{
+        uint16_t address;
+        uint32_t opcodesRun; // Instructions before it in the block
+        uint32_t cycles; // Cycles taken by inline instructions before it
+        std::vector<std::size_t> jumps;
+    };
+
+    std::vector<uint8_t> code; // Staging area for the block being compiled
+    uint8_t* codeBuffer = nullptr;
+    std::size_t codeBufferUsed = 0;
+    uint32_t generation = 1; // Incremented when the code buffer is flushed, invalidating all native blocks
+    static std::size_t constexpr codeBufferSize = 0x100000;
+    static uint32_t constexpr hotThreshold = 16; // Executions before a block is compiled
+};
+
+#endif
\ No newline at end of file
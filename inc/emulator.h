@@ -11,10 +11,19 @@
 class GBEmulator final{
 public:
     GBEmulator();
-    bool start(std::string const& cartridgePath, std::string const& bootPath, bool printVerbose);
+    bool start(std::string const& cartridgePath, std::string const& bootPath, bool printVerbose, CPUEngine engine = CPUEngine::interpreter,
+               unsigned int headlessFrames = 0, std::string const& tracePath = "", std::string const& profilePath = "",
+               std::string const& guestProfilePath = "", std::string const& symbolPath = "");
 private:
     void finish();
     void frame();
+    void runHeadless(unsigned int frames);
+    void emulate(uint32_t maxCycles);
+    uint16_t skipHalt(uint32_t maxCycles);
+    uint16_t skipIdleLoop(uint32_t maxCycles);
+    void printStats(double hostSeconds) const;
+    void writeProfiles() const;
+    void checkpoint();
     void handleEvents(SDL_Event const&  event);
     void updateTimers(uint16_t cycles);
     MemoryMap memoryMap;
@@ -28,7 +37,25 @@ private:
     bool quit = false;
     uint32_t const maxClockFreq = 4194304; // Hz
     unsigned int cyclesSinceLastUpdate = 0;
+    uint32_t const cyclesPerFrame = 70224; // 154 lines of 456 cycles
+    uint32_t const maxHaltSkip = 0xFFFC; // Largest multiple of 4 representable as a uint16_t
+    uint32_t const maxIdleLoopSkip = 0x10000; // Whole iterations before this fit in a uint16_t
+    uint32_t const maxBatchCycles = 0xF000; // Leaves room for the last instruction (or native block) within a uint16_t
+    unsigned int const saveInterval = 120; // Frames between flushes of the save file (about 2 seconds)
+    struct Stats{
+        uint64_t cycles = 0;
+        uint64_t haltCyclesSkipped = 0; // Cycles spent halted which were fast-forwarded rather than stepped
+        uint64_t idleLoopCyclesSkipped = 0; // Cycles spent in idle loops which were skipped rather than executed
+        unsigned int frames = 0;
+        double startupSeconds = 0.0; // From starting to the first instruction, including loading the cartridge
+    } stats;
+    struct IdleLoopCheck{
+        uint64_t cycle = 0; // Emulated cycle at which an idle loop last completed an iteration
+        uint32_t cyclesUntilEvent = 0; // Cycles from then until polled memory could change
+    } lastIdleLoop;
     bool verbose = false;
+    std::string profilePath; // Where the opcode profile is written on exit (printed if empty)
+    std::string guestProfilePath; // Where the guest profile is written on exit (if enabled)
     uint8_t directionInputReg, buttonInputReg;
 };
 
@@ -0,0 +1,36 @@
+#ifndef _GB_EMU_FILE_IMAGE_H_
+#define  _GB_EMU_FILE_IMAGE_H_
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <string>
+
+// A read-only image of a file, padded with zeros to a fixed size
+// Files are memory mapped (privately) where possible, so nothing is copied at load time - the OS reads pages as they
+// are first accessed and shares them between processes running the same file
+class FileImage final{
+public:
+    FileImage() = default;
+    explicit FileImage(std::size_t size) : buffer(size, 0x00), imageSize{size}{}
+    FileImage(FileImage const&) = delete;
+    FileImage& operator=(FileImage const&) = delete;
+    ~FileImage();
+    // Loads the first size bytes of the file at path (padded with zeros if the file is shorter)
+    bool open(std::string const& path, std::size_t size);
+    uint8_t const* data() const{ return mapping ? mapping : buffer.data(); }
+    std::size_t size() const{ return imageSize; }
+    bool isMapped() const{ return mapping != nullptr; }
+private:
+    bool map(std::string const& path, std::size_t fileSize);
+    bool read(std::string const& path, std::size_t fileSize);
+    void unmap();
+    uint8_t const* mapping = nullptr;
+#ifdef _WIN32
+    void* mappingHandle = nullptr;
+#endif
+    std::vector<uint8_t> buffer; // Used where the file cannot be mapped
+    std::size_t imageSize = 0;
+};
+
+#endif
\ No newline at end of file
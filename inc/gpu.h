@@ -3,9 +3,11 @@
 
 #include "..\inc\memory_map.h"
 #include "..\inc\cpu.h"
+#include "..\inc\tile_cache.h"
 
 #include <SDL.h>
 #include <array>
+#include <limits>
 
 class GPU{
 public:
@@ -13,21 +15,50 @@ public:
     void initialiseRenderer(SDL_Window* win);
     void update(uint16_t cycles);
     void render();
+    uint32_t cyclesUntilModeChange() const;
+    // Renders with the given kernels, rather than the fastest the host supports
+    void setPixelKernels(PixelKernels const& pixelKernels);
+    char const* getPixelKernelsName() const{ return kernels->name; }
+    // The last complete frame, as one shade per pixel (row by row, from white at 0 to black at 3), which is only
+    // expanded to the colours below when displayed
+    std::vector<uint8_t> const& getFrame() const{ return completedFrame; }
+    static std::array<uint32_t, 4> const& getColours();
 private:
     MemoryMap& memoryMap;
     CPU& cpu;
-    SDL_Window* window;
+    SDL_Window* window = nullptr;
     uint16_t clock;
-    // LCD control bits
-    bool LCDEnabled() const;
-    bool windowTileMapArea() const;
-    bool windowEnabled() const;
-    bool bgWindowTileDataArea() const;
-    bool bgTileMapArea() const;
-    bool objSize() const;
-    bool objEnabled() const;
-    bool bgEnabled() const;
-
+    TileCache tileCache;
+    PixelKernels const* kernels = &PixelKernels::best();
+    // Colour indices of the bg or window tiles in the line being drawn, from the first tile at least partly on screen
+    static uint8_t constexpr tilesPerLine = 21;
+    std::array<uint8_t, 8 * tilesPerLine> lineIndices{};
+    // Bg and window colour indices (before the palette) of the line being drawn - objects behind the bg only show
+    // where these are 0, whichever shade that is
+    std::array<uint8_t, 160> bgIndices{};
+    // Decoded copy of the LCD registers (0xFF40-0xFF4B, other than LY and DMA) - refreshed whenever the CPU writes
+    // to one, so the renderer need not read and decode them for every pixel
+    struct LCDRegisters{
+        // LCDC
+        bool LCDEnabled = false;
+        bool windowTileMapArea = false; // Window uses the tile map at 0x9C00 (rather than 0x9800)
+        bool windowEnabled = false;
+        bool bgWindowTileDataArea = false; // Bg and window tile indices are unsigned from 0x8000 (rather than signed from 0x9000)
+        bool bgTileMapArea = false; // Bg uses the tile map at 0x9C00 (rather than 0x9800)
+        bool objSize = false; // Objects are 8x16 (rather than 8x8)
+        bool objEnabled = false;
+        bool bgEnabled = false; // Controls whether bg and window are displayed
+        // STAT
+        uint8_t mode = 0;
+        uint8_t scrollY = 0;
+        uint8_t scrollX = 0;
+        uint8_t bgPalette = 0;
+        uint8_t objPalette0 = 0;
+        uint8_t objPalette1 = 0;
+        uint8_t winY = 0;
+        uint8_t winXPlusSeven = 0;
+    } lcd;
+    void decodeLCDControl(uint8_t value);
 
     // ----
     uint8_t getMode() const;
@@ -43,19 +74,8 @@ private:
     uint8_t getCurrentLine() const;
     uint8_t incrementCurrentLine();
 
-    uint8_t getScrollY() const;
-    uint8_t getScrollX() const;
-
-    uint8_t getBgPalette() const;
-    uint8_t getObjPalette0() const;
-    uint8_t getObjPalette1() const;
-
-    uint8_t getWinY() const;
-    uint8_t getWinXPlusSeven() const;
-
-    void static fillPalette(std::array<uint32_t, 4>& pal, uint16_t address);
-    uint8_t getPaletteIndex(uint16_t tileDataAddress, uint8_t bit) const;
-    // getters for scroll x,y ; win x, y
+    void static fillPalette(std::array<uint8_t, 4>& pal, uint8_t data);
+    uint16_t getBgTile(uint8_t tileIndex) const;
 
     uint16_t const cyclesPerLine = 456;
     uint16_t const scanlinesPerFrame = 154;
@@ -66,21 +86,18 @@ private:
     uint16_t const linesInVBlank = 10;
 
     uint8_t const tileWidthInPixels = 8;
-    uint8_t const tileSizeInBytes = 16;
     uint8_t const tileMapWidth = 32;
 
-    uint8_t const objTileSizeInBytes = 16;
     uint8_t const objOAMSizeInBytes = 4;
     uint8_t const numberOfObjs = 40;
 
     uint8_t const winWidth = 160;
     uint8_t const winHeight = 144;
 
-    SDL_Renderer* renderer;
-    SDL_Texture* texture;
-    std::vector<uint32_t> LCDtexture, bgBuffer, framebuffer; // Issue: consider renaming
+    SDL_Renderer* renderer = nullptr; // Not created when running headless
+    SDL_Texture* texture = nullptr;
+    std::vector<uint8_t> framebuffer, completedFrame; // Shades, as returned by getFrame
 
-    uint16_t const LCDControlRegAddress = 0xFF40;
     uint16_t const OAMAddress = 0xFE00;
 
 };
@@ -0,0 +1,37 @@
+#ifndef _GB_EMU_IO_REGISTERS_H_
+#define  _GB_EMU_IO_REGISTERS_H_
+
+#include <cstdint>
+
+// The I/O registers at 0xFF00-0xFF7F, each named by its offset from 0xFF00
+enum class IORegister : uint8_t{
+    JOYP = 0x00, // Joypad
+    SB = 0x01, // Serial data
+    SC = 0x02, // Serial control
+    DIV = 0x04, // Divider
+    TIMA = 0x05, // Timer counter
+    TMA = 0x06, // Timer modulo
+    TAC = 0x07, // Timer control
+    IF = 0x0F, // Interrupt flag
+    LCDC = 0x40, // LCD control
+    STAT = 0x41, // LCD status
+    SCY = 0x42, // Background scroll
+    SCX = 0x43,
+    LY = 0x44, // Current line
+    LYC = 0x45, // Line compare
+    DMA = 0x46, // OAM DMA source
+    BGP = 0x47, // Palettes
+    OBP0 = 0x48,
+    OBP1 = 0x49,
+    WY = 0x4A, // Window position
+    WX = 0x4B
+};
+
+uint16_t constexpr IO_REGISTERS_ADDRESS = 0xFF00;
+uint16_t constexpr IO_REGISTER_COUNT = 0x80;
+
+constexpr uint16_t ioAddress(IORegister reg){
+    return IO_REGISTERS_ADDRESS | uint8_t(reg);
+}
+
+#endif
\ No newline at end of file
@@ -2,6 +2,8 @@
 #define  _GB_EMU_MEMORY_MAP_H_
 
 #include "..\inc\registers.h"
+#include "..\inc\cartridge.h"
+#include "..\inc\io_registers.h"
 
 #include <cstdint>
 #include <fstream>
@@ -10,13 +12,30 @@
 #include <vector>
 #include <array>
 #include <string>
+#include <algorithm>
+#include <functional>
 
 class MemoryMap final{
 public:
     MemoryMap();
-    uint8_t readByte(uint16_t address) const;
+    MemoryMap(MemoryMap const& other);
+    MemoryMap& operator=(MemoryMap const& other);
+    // Most pages map straight to memory, so most accesses are a single indexed load or store (see mapPages)
+    uint8_t readByte(uint16_t address) const{
+        uint8_t const* const page = readPages[address >> 8];
+        return page ? page[address & 0xFF] : readUnmapped(address);
+    }
     uint16_t readWord(uint16_t address) const;
-    void writeByte(uint16_t address, uint8_t value);
+    void writeByte(uint16_t address, uint8_t value){
+        uint8_t* const page = writePages[address >> 8];
+        if (page){
+            page[address & 0xFF] = value;
+            recordWrite((countedPages[address >> 8] << 8) | (address & 0xFF));
+        }
+        else{
+            writeUnmapped(address, value);
+        }
+    }
     void writeWord(uint16_t address, uint16_t value);
     bool loadBootProgram(std::string const& path);
     bool loadCartridge(std::string const& path);
@@ -26,28 +45,90 @@ public:
     void getState(std::vector<uint8_t>& state) const;
     void disableMapping(bool disabled = true);
     bool updateTimerRegisters(uint16_t cycles);
+    uint32_t cyclesUntilTimerEvent() const;
     bool processInput(uint8_t buttonInput, uint8_t directionInput);
+    void requestInterrupt(uint8_t interrupt);
+    void acknowledgeInterrupt(uint8_t interrupt);
+    // Interrupts both requested (IF) and enabled (IE), one bit per interrupt
+    uint8_t getPendingInterrupts() const{ return pendingInterrupts; }
+    uint16_t getROMBank(uint16_t address) const;
+    // Changes whenever a different ROM bank (or the boot program) is mapped in 0x0000-0x7FFF, so code decoded
+    // before then may no longer be what is mapped
+    uint32_t getROMBankGeneration() const{ return romBankGeneration; }
+    // The I/O registers, as seen by the components which own them - unlike CPU accesses, these have no side effects
+    uint8_t readIO(IORegister reg) const{ return memory[ioAddress(reg)]; }
+    void writeIO(IORegister reg, uint8_t value){ memory[ioAddress(reg)] = value; }
+    // Calls listener with the new value whenever the CPU writes to reg (listeners are not copied with the map)
+    void addIOListener(IORegister reg, std::function<void(uint8_t)> listener);
+    // Battery-backed cartridge RAM is written straight to the save file's pages, which are only flushed to disk here
+    void flushSaveFile(){ cartridge.flushRAM(); }
+    std::string const& getSavePath() const{ return cartridge.getSavePath(); }
+    // Bulk access for fused copy and fill loops - only valid within plain memory, which behaves the same
+    // whether accessed one byte at a time or all at once
+    bool isPlainMemory(uint16_t address, uint32_t length, bool write) const;
+    void copyBlock(uint16_t target, uint16_t source, uint16_t length);
+    void fillBlock(uint16_t target, uint8_t value, uint16_t length);
+    uint32_t getWriteCount(uint16_t address) const;
+    static uint16_t constexpr writeCountLineSize = 0x40;
 private:
-    void writeByte(uint16_t address, uint8_t value, std::vector<uint8_t>& target);
-    bool loadBinary(std::string const& path, std::vector<uint8_t>& target);
+    uint8_t readUnmapped(uint16_t address) const;
+    void writeUnmapped(uint16_t address, uint8_t value);
+    // I/O registers with side effects have handlers in IO_HANDLERS (see memory_map.cpp) - the rest are plain memory
+    using IOReadHandler = uint8_t (MemoryMap::*)(uint8_t offset) const;
+    using IOWriteHandler = void (MemoryMap::*)(uint8_t offset, uint8_t value);
+    struct IOHandlers{
+        IOReadHandler read = nullptr;
+        IOWriteHandler write = nullptr;
+    };
+    static std::array<IOHandlers, IO_REGISTER_COUNT> const IO_HANDLERS;
+    uint8_t readIORegister(uint8_t offset) const;
+    void writeIORegister(uint8_t offset, uint8_t value);
+    uint8_t readJoypad(uint8_t offset) const;
+    void writeJoypad(uint8_t offset, uint8_t value);
+    void writeDivider(uint8_t offset, uint8_t value);
+    void writeTimerControl(uint8_t offset, uint8_t value);
+    void writeDMA(uint8_t offset, uint8_t value);
+    void writeInterruptRegister(uint8_t offset, uint8_t value);
+    void mapPages();
+    void mapBanks();
     void transferDMA(uint8_t value);
     void incrementDIVRegister();
     void incrementCounterRegister();
     bool counterEnabled() const;
     void setCounterFrequency(uint8_t freq);
+    void recordWrite(uint16_t address){ ++writeCounts[address / writeCountLineSize]; }
+    void recordWrites(uint16_t address, uint16_t length);
+    void recordWriteAll();
+    void updatePendingInterrupts();
     std::vector<uint8_t> memory;
-    std::vector<uint8_t> bootMemory;
+    std::shared_ptr<FileImage const> bootProgram;
+    Cartridge cartridge;
     HalfRegister directionInputReg, buttonInputReg;
+    // Number of writes to each line of memory, used to detect modified code
+    std::array<uint32_t, 0x10000 / writeCountLineSize> writeCounts{};
     struct Timer{
         int dividerCycles;
-        uint16_t const dividerFreq = 0x100;
+        static uint16_t constexpr dividerFreq = 0x100;
         int counterCycles;
         uint8_t counterFreqIndex = 0;
         std::array<uint16_t, 4> counterFreq = {0x400, 0x10, 0x40, 0x100};
     } timer;
+    // IE & IF & 0x1F, kept up to date on every write to either register so that the CPU need not read them
+    // after each instruction
+    uint8_t pendingInterrupts = 0x00;
+    std::array<std::function<void(uint8_t)>, IO_REGISTER_COUNT> ioListeners;
 
     bool isBooting = false;
     bool disableMemMapping = false;
+
+    // Memory behind each 256-byte page, or nullptr where accesses are handled by readUnmapped/writeUnmapped
+    std::array<uint8_t const*, 0x100> readPages{};
+    std::array<uint8_t*, 0x100> writePages{};
+    // Page whose write counts are incremented by writes to each page (differing only for echo RAM)
+    std::array<uint8_t, 0x100> countedPages{};
+    // First pages of the boot program (or lower bank), lower bank and upper bank, as last mapped
+    std::array<uint8_t const*, 3> mappedROMPages{};
+    uint32_t romBankGeneration = 0;
 };
 
 #endif
\ No newline at end of file
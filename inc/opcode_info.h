@@ -0,0 +1,185 @@
+#ifndef _GB_EMU_OPCODE_INFO_H_
+#define  _GB_EMU_OPCODE_INFO_H_
+
+#include <cstdint>
+#include <cstddef>
+#include <array>
+#include <string>
+#include <string_view>
+
+// Immediate operand following an opcode (the opcode following a CB prefix is also treated as an operand)
+enum class OperandType : uint8_t{none, u8, i8, u16, opcodeCB};
+
+// Static description of an instruction, shared by every CPU instance and used by the block decoder, idle loop
+// detection, the tracer, the profiler, the disassembler and the tests
+// Operand kinds and lengths follow from the mnemonic, in which immediate operands are written as u8, i8 or u16
+struct OpcodeInfo final{
+    std::string_view mnemonic; // Empty for illegal opcodes
+    uint8_t cycles = 0; // T-cycles, or if a conditional branch is not taken
+    uint8_t branchCycles = 0; // T-cycles if a conditional branch is taken (otherwise as above)
+    OperandType operand = OperandType::none;
+    uint8_t length = 0; // Bytes, including the opcode (CB-prefixed opcodes are described by OPCODE_CB_INFO,
+                        // where the length excludes the prefix)
+    constexpr OpcodeInfo() = default;
+    constexpr OpcodeInfo(std::string_view mnemonic, uint8_t cycles, uint8_t branchCycles = 0) :
+        mnemonic{mnemonic}, cycles{cycles}, branchCycles{branchCycles ? branchCycles : cycles}, operand{operandType(mnemonic)},
+        length{uint8_t(1 + operandLength(operand))}{}
+    constexpr bool isLegal() const{ return !mnemonic.empty(); }
+    constexpr bool isConditionalBranch() const{ return branchCycles != cycles; }
+private:
+    static constexpr OperandType operandType(std::string_view mnemonic){
+        if (mnemonic == "PREFIX CB") return OperandType::opcodeCB;
+        if (mnemonic.find("u16") != std::string_view::npos) return OperandType::u16;
+        if (mnemonic.find("u8") != std::string_view::npos) return OperandType::u8;
+        if (mnemonic.find("i8") != std::string_view::npos) return OperandType::i8;
+        return OperandType::none;
+    }
+    static constexpr uint8_t operandLength(OperandType operand){
+        return operand == OperandType::none ? 0 : operand == OperandType::u16 ? 2 : 1;
+    }
+};
+
+// STOP is treated as a single byte, as its handler does not skip the byte which follows
+std::array<OpcodeInfo, 0x100> inline constexpr OPCODE_INFO = {{
+    {"NOP", 4}, {"LD BC, u16", 12}, {"LD (BC), A", 8}, {"INC BC", 8}, // 0x00
+    {"INC B", 4}, {"DEC B", 4}, {"LD B, u8", 8}, {"RLCA", 4},
+    {"LD (u16), SP", 20}, {"ADD HL, BC", 8}, {"LD A, (BC)", 8}, {"DEC BC", 8},
+    {"INC C", 4}, {"DEC C", 4}, {"LD C, u8", 8}, {"RRCA", 4},
+    {"STOP", 4}, {"LD DE, u16", 12}, {"LD (DE), A", 8}, {"INC DE", 8}, // 0x10
+    {"INC D", 4}, {"DEC D", 4}, {"LD D, u8", 8}, {"RLA", 4},
+    {"JR i8", 12}, {"ADD HL, DE", 8}, {"LD A, (DE)", 8}, {"DEC DE", 8},
+    {"INC E", 4}, {"DEC E", 4}, {"LD E, u8", 8}, {"RRA", 4},
+    {"JR NZ, i8", 8, 12}, {"LD HL, u16", 12}, {"LD (HL+), A", 8}, {"INC HL", 8}, // 0x20
+    {"INC H", 4}, {"DEC H", 4}, {"LD H, u8", 8}, {"DAA", 4},
+    {"JR Z, i8", 8, 12}, {"ADD HL, HL", 8}, {"LD A, (HL+)", 8}, {"DEC HL", 8},
+    {"INC L", 4}, {"DEC L", 4}, {"LD L, u8", 8}, {"CPL", 4},
+    {"JR NC, i8", 8, 12}, {"LD SP, u16", 12}, {"LD (HL-), A", 8}, {"INC SP", 8}, // 0x30
+    {"INC (HL)", 12}, {"DEC (HL)", 12}, {"LD (HL), u8", 12}, {"SCF", 4},
+    {"JR C, i8", 8, 12}, {"ADD HL, SP", 8}, {"LD A, (HL-)", 8}, {"DEC SP", 8},
+    {"INC A", 4}, {"DEC A", 4}, {"LD A, u8", 8}, {"CCF", 4},
+    {"LD B, B", 4}, {"LD B, C", 4}, {"LD B, D", 4}, {"LD B, E", 4}, // 0x40
+    {"LD B, H", 4}, {"LD B, L", 4}, {"LD B, (HL)", 8}, {"LD B, A", 4},
+    {"LD C, B", 4}, {"LD C, C", 4}, {"LD C, D", 4}, {"LD C, E", 4},
+    {"LD C, H", 4}, {"LD C, L", 4}, {"LD C, (HL)", 8}, {"LD C, A", 4},
+    {"LD D, B", 4}, {"LD D, C", 4}, {"LD D, D", 4}, {"LD D, E", 4}, // 0x50
+    {"LD D, H", 4}, {"LD D, L", 4}, {"LD D, (HL)", 8}, {"LD D, A", 4},
+    {"LD E, B", 4}, {"LD E, C", 4}, {"LD E, D", 4}, {"LD E, E", 4},
+    {"LD E, H", 4}, {"LD E, L", 4}, {"LD E, (HL)", 8}, {"LD E, A", 4},
+    {"LD H, B", 4}, {"LD H, C", 4}, {"LD H, D", 4}, {"LD H, E", 4}, // 0x60
+    {"LD H, H", 4}, {"LD H, L", 4}, {"LD H, (HL)", 8}, {"LD H, A", 4},
+    {"LD L, B", 4}, {"LD L, C", 4}, {"LD L, D", 4}, {"LD L, E", 4},
+    {"LD L, H", 4}, {"LD L, L", 4}, {"LD L, (HL)", 8}, {"LD L, A", 4},
+    {"LD (HL), B", 8}, {"LD (HL), C", 8}, {"LD (HL), D", 8}, {"LD (HL), E", 8}, // 0x70
+    {"LD (HL), H", 8}, {"LD (HL), L", 8}, {"HALT", 4}, {"LD (HL), A", 8},
+    {"LD A, B", 4}, {"LD A, C", 4}, {"LD A, D", 4}, {"LD A, E", 4},
+    {"LD A, H", 4}, {"LD A, L", 4}, {"LD A, (HL)", 8}, {"LD A, A", 4},
+    {"ADD A, B", 4}, {"ADD A, C", 4}, {"ADD A, D", 4}, {"ADD A, E", 4}, // 0x80
+    {"ADD A, H", 4}, {"ADD A, L", 4}, {"ADD A, (HL)", 8}, {"ADD A, A", 4},
+    {"ADC A, B", 4}, {"ADC A, C", 4}, {"ADC A, D", 4}, {"ADC A, E", 4},
+    {"ADC A, H", 4}, {"ADC A, L", 4}, {"ADC A, (HL)", 8}, {"ADC A, A", 4},
+    {"SUB A, B", 4}, {"SUB A, C", 4}, {"SUB A, D", 4}, {"SUB A, E", 4}, // 0x90
+    {"SUB A, H", 4}, {"SUB A, L", 4}, {"SUB A, (HL)", 8}, {"SUB A, A", 4},
+    {"SBC A, B", 4}, {"SBC A, C", 4}, {"SBC A, D", 4}, {"SBC A, E", 4},
+    {"SBC A, H", 4}, {"SBC A, L", 4}, {"SBC A, (HL)", 8}, {"SBC A, A", 4},
+    {"AND A, B", 4}, {"AND A, C", 4}, {"AND A, D", 4}, {"AND A, E", 4}, // 0xA0
+    {"AND A, H", 4}, {"AND A, L", 4}, {"AND A, (HL)", 8}, {"AND A, A", 4},
+    {"XOR A, B", 4}, {"XOR A, C", 4}, {"XOR A, D", 4}, {"XOR A, E", 4},
+    {"XOR A, H", 4}, {"XOR A, L", 4}, {"XOR A, (HL)", 8}, {"XOR A, A", 4},
+    {"OR A, B", 4}, {"OR A, C", 4}, {"OR A, D", 4}, {"OR A, E", 4}, // 0xB0
+    {"OR A, H", 4}, {"OR A, L", 4}, {"OR A, (HL)", 8}, {"OR A, A", 4},
+    {"CP A, B", 4}, {"CP A, C", 4}, {"CP A, D", 4}, {"CP A, E", 4},
+    {"CP A, H", 4}, {"CP A, L", 4}, {"CP A, (HL)", 8}, {"CP A, A", 4},
+    {"RET NZ", 8, 20}, {"POP BC", 12}, {"JP NZ, u16", 12, 16}, {"JP u16", 16}, // 0xC0
+    {"CALL NZ, u16", 12, 24}, {"PUSH BC", 16}, {"ADD A, u8", 8}, {"RST 0x00", 16},
+    {"RET Z", 8, 20}, {"RET", 16}, {"JP Z, u16", 12, 16}, {"PREFIX CB", 4},
+    {"CALL Z, u16", 12, 24}, {"CALL u16", 24}, {"ADC A, u8", 8}, {"RST 0x08", 16},
+    {"RET NC", 8, 20}, {"POP DE", 12}, {"JP NC, u16", 12, 16}, {}, // 0xD0
+    {"CALL NC, u16", 12, 24}, {"PUSH DE", 16}, {"SUB A, u8", 8}, {"RST 0x10", 16},
+    {"RET C", 8, 20}, {"RETI", 16}, {"JP C, u16", 12, 16}, {},
+    {"CALL C, u16", 12, 24}, {}, {"SBC A, u8", 8}, {"RST 0x18", 16},
+    {"LDH (u8), A", 12}, {"POP HL", 12}, {"LD (0xFF00+C), A", 8}, {}, // 0xE0
+    {}, {"PUSH HL", 16}, {"AND A, u8", 8}, {"RST 0x20", 16},
+    {"ADD SP, i8", 16}, {"JP HL", 4}, {"LD (u16), A", 16}, {},
+    {}, {}, {"XOR A, u8", 8}, {"RST 0x28", 16},
+    {"LDH A, (u8)", 12}, {"POP AF", 12}, {"LD A, (0xFF00+C)", 8}, {"DI", 4}, // 0xF0
+    {}, {"PUSH AF", 16}, {"OR A, u8", 8}, {"RST 0x30", 16},
+    {"LD HL, SP+i8", 12}, {"LD SP, HL", 8}, {"LD A, (u16)", 16}, {"EI", 4},
+    {}, {}, {"CP A, u8", 8}, {"RST 0x38", 16}
+}};
+
+std::array<OpcodeInfo, 0x100> inline constexpr OPCODE_CB_INFO = {{
+    {"RLC B", 8}, {"RLC C", 8}, {"RLC D", 8}, {"RLC E", 8}, {"RLC H", 8}, {"RLC L", 8}, {"RLC (HL)", 16}, {"RLC A", 8}, // 0x00
+    {"RRC B", 8}, {"RRC C", 8}, {"RRC D", 8}, {"RRC E", 8}, {"RRC H", 8}, {"RRC L", 8}, {"RRC (HL)", 16}, {"RRC A", 8},
+    {"RL B", 8}, {"RL C", 8}, {"RL D", 8}, {"RL E", 8}, {"RL H", 8}, {"RL L", 8}, {"RL (HL)", 16}, {"RL A", 8}, // 0x10
+    {"RR B", 8}, {"RR C", 8}, {"RR D", 8}, {"RR E", 8}, {"RR H", 8}, {"RR L", 8}, {"RR (HL)", 16}, {"RR A", 8},
+    {"SLA B", 8}, {"SLA C", 8}, {"SLA D", 8}, {"SLA E", 8}, {"SLA H", 8}, {"SLA L", 8}, {"SLA (HL)", 16}, {"SLA A", 8}, // 0x20
+    {"SRA B", 8}, {"SRA C", 8}, {"SRA D", 8}, {"SRA E", 8}, {"SRA H", 8}, {"SRA L", 8}, {"SRA (HL)", 16}, {"SRA A", 8},
+    {"SWAP B", 8}, {"SWAP C", 8}, {"SWAP D", 8}, {"SWAP E", 8}, {"SWAP H", 8}, {"SWAP L", 8}, {"SWAP (HL)", 16}, {"SWAP A", 8}, // 0x30
+    {"SRL B", 8}, {"SRL C", 8}, {"SRL D", 8}, {"SRL E", 8}, {"SRL H", 8}, {"SRL L", 8}, {"SRL (HL)", 16}, {"SRL A", 8},
+    {"BIT 0, B", 8}, {"BIT 0, C", 8}, {"BIT 0, D", 8}, {"BIT 0, E", 8}, {"BIT 0, H", 8}, {"BIT 0, L", 8}, {"BIT 0, (HL)", 12}, {"BIT 0, A", 8}, // 0x40
+    {"BIT 1, B", 8}, {"BIT 1, C", 8}, {"BIT 1, D", 8}, {"BIT 1, E", 8}, {"BIT 1, H", 8}, {"BIT 1, L", 8}, {"BIT 1, (HL)", 12}, {"BIT 1, A", 8},
+    {"BIT 2, B", 8}, {"BIT 2, C", 8}, {"BIT 2, D", 8}, {"BIT 2, E", 8}, {"BIT 2, H", 8}, {"BIT 2, L", 8}, {"BIT 2, (HL)", 12}, {"BIT 2, A", 8}, // 0x50
+    {"BIT 3, B", 8}, {"BIT 3, C", 8}, {"BIT 3, D", 8}, {"BIT 3, E", 8}, {"BIT 3, H", 8}, {"BIT 3, L", 8}, {"BIT 3, (HL)", 12}, {"BIT 3, A", 8},
+    {"BIT 4, B", 8}, {"BIT 4, C", 8}, {"BIT 4, D", 8}, {"BIT 4, E", 8}, {"BIT 4, H", 8}, {"BIT 4, L", 8}, {"BIT 4, (HL)", 12}, {"BIT 4, A", 8}, // 0x60
+    {"BIT 5, B", 8}, {"BIT 5, C", 8}, {"BIT 5, D", 8}, {"BIT 5, E", 8}, {"BIT 5, H", 8}, {"BIT 5, L", 8}, {"BIT 5, (HL)", 12}, {"BIT 5, A", 8},
+    {"BIT 6, B", 8}, {"BIT 6, C", 8}, {"BIT 6, D", 8}, {"BIT 6, E", 8}, {"BIT 6, H", 8}, {"BIT 6, L", 8}, {"BIT 6, (HL)", 12}, {"BIT 6, A", 8}, // 0x70
+    {"BIT 7, B", 8}, {"BIT 7, C", 8}, {"BIT 7, D", 8}, {"BIT 7, E", 8}, {"BIT 7, H", 8}, {"BIT 7, L", 8}, {"BIT 7, (HL)", 12}, {"BIT 7, A", 8},
+    {"RES 0, B", 8}, {"RES 0, C", 8}, {"RES 0, D", 8}, {"RES 0, E", 8}, {"RES 0, H", 8}, {"RES 0, L", 8}, {"RES 0, (HL)", 16}, {"RES 0, A", 8}, // 0x80
+    {"RES 1, B", 8}, {"RES 1, C", 8}, {"RES 1, D", 8}, {"RES 1, E", 8}, {"RES 1, H", 8}, {"RES 1, L", 8}, {"RES 1, (HL)", 16}, {"RES 1, A", 8},
+    {"RES 2, B", 8}, {"RES 2, C", 8}, {"RES 2, D", 8}, {"RES 2, E", 8}, {"RES 2, H", 8}, {"RES 2, L", 8}, {"RES 2, (HL)", 16}, {"RES 2, A", 8}, // 0x90
+    {"RES 3, B", 8}, {"RES 3, C", 8}, {"RES 3, D", 8}, {"RES 3, E", 8}, {"RES 3, H", 8}, {"RES 3, L", 8}, {"RES 3, (HL)", 16}, {"RES 3, A", 8},
+    {"RES 4, B", 8}, {"RES 4, C", 8}, {"RES 4, D", 8}, {"RES 4, E", 8}, {"RES 4, H", 8}, {"RES 4, L", 8}, {"RES 4, (HL)", 16}, {"RES 4, A", 8}, // 0xA0
+    {"RES 5, B", 8}, {"RES 5, C", 8}, {"RES 5, D", 8}, {"RES 5, E", 8}, {"RES 5, H", 8}, {"RES 5, L", 8}, {"RES 5, (HL)", 16}, {"RES 5, A", 8},
+    {"RES 6, B", 8}, {"RES 6, C", 8}, {"RES 6, D", 8}, {"RES 6, E", 8}, {"RES 6, H", 8}, {"RES 6, L", 8}, {"RES 6, (HL)", 16}, {"RES 6, A", 8}, // 0xB0
+    {"RES 7, B", 8}, {"RES 7, C", 8}, {"RES 7, D", 8}, {"RES 7, E", 8}, {"RES 7, H", 8}, {"RES 7, L", 8}, {"RES 7, (HL)", 16}, {"RES 7, A", 8},
+    {"SET 0, B", 8}, {"SET 0, C", 8}, {"SET 0, D", 8}, {"SET 0, E", 8}, {"SET 0, H", 8}, {"SET 0, L", 8}, {"SET 0, (HL)", 16}, {"SET 0, A", 8}, // 0xC0
+    {"SET 1, B", 8}, {"SET 1, C", 8}, {"SET 1, D", 8}, {"SET 1, E", 8}, {"SET 1, H", 8}, {"SET 1, L", 8}, {"SET 1, (HL)", 16}, {"SET 1, A", 8},
+    {"SET 2, B", 8}, {"SET 2, C", 8}, {"SET 2, D", 8}, {"SET 2, E", 8}, {"SET 2, H", 8}, {"SET 2, L", 8}, {"SET 2, (HL)", 16}, {"SET 2, A", 8}, // 0xD0
+    {"SET 3, B", 8}, {"SET 3, C", 8}, {"SET 3, D", 8}, {"SET 3, E", 8}, {"SET 3, H", 8}, {"SET 3, L", 8}, {"SET 3, (HL)", 16}, {"SET 3, A", 8},
+    {"SET 4, B", 8}, {"SET 4, C", 8}, {"SET 4, D", 8}, {"SET 4, E", 8}, {"SET 4, H", 8}, {"SET 4, L", 8}, {"SET 4, (HL)", 16}, {"SET 4, A", 8}, // 0xE0
+    {"SET 5, B", 8}, {"SET 5, C", 8}, {"SET 5, D", 8}, {"SET 5, E", 8}, {"SET 5, H", 8}, {"SET 5, L", 8}, {"SET 5, (HL)", 16}, {"SET 5, A", 8},
+    {"SET 6, B", 8}, {"SET 6, C", 8}, {"SET 6, D", 8}, {"SET 6, E", 8}, {"SET 6, H", 8}, {"SET 6, L", 8}, {"SET 6, (HL)", 16}, {"SET 6, A", 8}, // 0xF0
+    {"SET 7, B", 8}, {"SET 7, C", 8}, {"SET 7, D", 8}, {"SET 7, E", 8}, {"SET 7, H", 8}, {"SET 7, L", 8}, {"SET 7, (HL)", 16}, {"SET 7, A", 8}
+}};
+
+// Selects the description of a CB-prefixed opcode from its second byte
+constexpr OpcodeInfo const& getOpcodeInfo(uint8_t opcode, uint8_t opcodeCB = 0x00){
+    return opcode == 0xCB ? OPCODE_CB_INFO[opcodeCB] : OPCODE_INFO[opcode];
+}
+
+// Checks that the tables are consistent with the instruction encoding
+constexpr bool checkOpcodeInfo(){
+    std::size_t illegalOpcodes = 0, conditionalBranches = 0;
+    for (std::size_t i = 0 ; i < 0x100 ; ++i){
+        OpcodeInfo const& info = OPCODE_INFO[i];
+        if (!info.isLegal()){
+            ++illegalOpcodes;
+            continue;
+        }
+        if (info.cycles % 4 != 0 || info.branchCycles < info.cycles){
+            return false;
+        }
+        // Instructions accessing (HL) take an extra memory cycle, or two to read and write it back
+        bool const usesHL = info.mnemonic.find("(HL)") != std::string_view::npos;
+        if (i >= 0x40 && i < 0xC0 && i != 0x76 && info.cycles != (usesHL ? 8 : 4)){
+            return false;
+        }
+        conditionalBranches += info.isConditionalBranch();
+        OpcodeInfo const& infoCB = OPCODE_CB_INFO[i];
+        bool const usesHLCB = (i & 0x07) == 0x06;
+        uint8_t const cyclesCB = !usesHLCB ? 8 : (i & 0xC0) == 0x40 ? 12 : 16;
+        if (infoCB.length != 1 || infoCB.cycles != cyclesCB || infoCB.isConditionalBranch() ||
+            (infoCB.mnemonic.find("(HL)") != std::string_view::npos) != usesHLCB){
+            return false;
+        }
+    }
+    return illegalOpcodes == 11 && conditionalBranches == 16;
+}
+
+static_assert(checkOpcodeInfo(), "Opcode tables are inconsistent");
+static_assert(OPCODE_INFO[0xCB].length == 2 && OPCODE_INFO[0x01].length == 3 && OPCODE_INFO[0x18].length == 2, "Opcode lengths are inconsistent");
+
+// Formats an instruction with its operands, e.g. "LD A, 0x12" or "JR NZ, -5" (bytes must hold the whole instruction)
+std::string disassemble(uint8_t const* bytes);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,27 @@
+#ifndef _GB_EMU_PIXEL_KERNELS_H_
+#define  _GB_EMU_PIXEL_KERNELS_H_
+
+#include <cstdint>
+#include <cstddef>
+#include <array>
+
+// SIMD kernels are only built for x86-64 hosts, where SSE2 is always available and AVX2 is detected at run time
+#if defined(__x86_64__) || defined(_M_X64)
+#define GB_EMU_SIMD_AVAILABLE
+#endif
+
+// The inner loops of the renderer, as scalar code which runs anywhere and SIMD code for hosts which support it
+struct PixelKernels{
+    char const* name;
+    // Decodes a tile row, given as its lower and upper bit planes (leftmost pixel in bit 7), to eight colour indices
+    void (*decodeRow)(uint8_t lower, uint8_t upper, uint8_t* indices);
+    // Looks up count colour indices (0-3) in a palette of four colours
+    void (*applyPalette)(uint8_t const* indices, std::size_t count, std::array<uint32_t, 4> const& palette, uint32_t* pixels);
+    // As applyPalette, for a palette of four shades (0-3) such as the DMG palette registers select
+    void (*applyShades)(uint8_t const* indices, std::size_t count, std::array<uint8_t, 4> const& shades, uint8_t* output);
+    static PixelKernels const& scalar();
+    // The fastest kernels the host supports
+    static PixelKernels const& best();
+};
+
+#endif
\ No newline at end of file
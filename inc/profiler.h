@@ -0,0 +1,110 @@
+#ifndef _GB_EMU_PROFILER_H_
+#define  _GB_EMU_PROFILER_H_
+
+#include <cstdint>
+#include <cstddef>
+#include <array>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <map>
+#include <chrono>
+
+// Opcode profiling is selected at build time:
+//  default: compiled out, every profiling operation is an empty inline function
+//  -DGB_EMU_PROFILE: every instruction interpreted is counted with the cycles it took, and one in every
+//                    sampleInterval is timed on the host
+
+// Execution counts and times for each of the 512 opcodes - base opcodes are indexed 0x000-0x0FF and
+// CB-prefixed opcodes 0x100-0x1FF
+class OpcodeProfiler final{
+public:
+    static constexpr bool enabled = true;
+    static constexpr uint32_t sampleInterval = 64; // Must be a power of two
+    using Clock = std::chrono::steady_clock;
+    struct Counters{
+        uint64_t executions = 0;
+        uint64_t cycles = 0;
+        uint64_t samples = 0; // Executions which were timed
+        uint64_t sampledNanoseconds = 0; // Host time taken by the timed executions
+    };
+    OpcodeProfiler();
+    // True once every sampleInterval instructions, when the next instruction should be timed
+    bool sampleDue(){ return (++instructions & (sampleInterval - 1)) == 0; }
+    void record(uint16_t index, uint16_t cycles){
+        counters[index].executions += 1;
+        counters[index].cycles += cycles;
+    }
+    void recordSample(uint16_t index, uint16_t cycles, Clock::duration elapsed);
+    // Native blocks are not broken down by opcode
+    void recordNativeBlock(uint16_t cycles){ ++nativeBlocks; nativeCycles += cycles; }
+    Counters const& operator[](uint16_t index) const{ return counters[index]; }
+    void printReport(std::size_t rows = reportLength) const;
+    void writeCSV(std::string const& path) const;
+    void clear();
+private:
+    std::array<Counters, 0x200> counters{};
+    uint64_t instructions = 0;
+    uint64_t nativeBlocks = 0;
+    uint64_t nativeCycles = 0;
+    Clock::duration clockOverhead{}; // Cost of reading the clock, subtracted from each sample
+    static constexpr std::size_t reportLength = 40;
+};
+
+// Profiling policy used when profiling is compiled out
+class NullProfiler final{
+public:
+    static constexpr bool enabled = false;
+    using Clock = std::chrono::steady_clock;
+    bool sampleDue(){ return false; }
+    void record(uint16_t, uint16_t){}
+    void recordSample(uint16_t, uint16_t, Clock::duration){}
+    void recordNativeBlock(uint16_t){}
+    void printReport() const{}
+    void writeCSV(std::string const&) const{}
+    void clear(){}
+};
+
+// Groups opcodes by the first word of their mnemonic, e.g. "LD" or "BIT"
+std::string_view opcodeFamily(std::string_view mnemonic);
+
+// Samples where the guest program spends its time - every sampleInterval emulated cycles, the cycles since the last
+// sample are attributed to the current PC and a shadow call stack, which is kept by CALL, RST and interrupt entry
+// (and unwound by RET, or whenever SP is above a frame, as games may discard return addresses or reset SP)
+// Code locations are identified as for cached blocks, by ROM bank and address
+class GuestProfiler final{
+public:
+    static uint32_t constexpr sampleInterval = 1024;
+    void loadSymbols(std::string const& path);
+    void call(uint32_t entry, uint16_t SP);
+    void ret(uint16_t SP);
+    void advance(uint16_t cycles, uint32_t location, uint16_t SP){
+        pendingCycles += cycles;
+        if (pendingCycles >= sampleInterval){
+            sample(location, SP);
+        }
+    }
+    uint32_t cyclesUntilSample() const{ return sampleInterval - pendingCycles; }
+    void writeFoldedStacks(std::string const& path) const;
+private:
+    void sample(uint32_t location, uint16_t SP);
+    void unwind(uint16_t SP);
+    std::string describe(uint32_t location) const;
+    struct Frame{
+        uint32_t entry; // Location called
+        uint16_t SP; // Where the return address is held
+    };
+    std::vector<Frame> stack;
+    std::map<std::vector<uint32_t>, uint64_t> samples; // Cycles spent at each stack of entries, ending with the PC
+    std::map<uint32_t, std::string> symbols;
+    uint32_t pendingCycles = 0;
+    static std::size_t constexpr maxDepth = 64;
+};
+
+#ifdef GB_EMU_PROFILE
+using ExecutionProfiler = OpcodeProfiler;
+#else
+using ExecutionProfiler = NullProfiler;
+#endif
+
+#endif
\ No newline at end of file
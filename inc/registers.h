@@ -3,39 +3,71 @@
 
 #include <iostream>
 #include <cstdint>
+#include <type_traits>
+
+// Registers are defined entirely in this header so that every operation can be inlined
+// Both types are trivial - default construction leaves them uninitialised, so use {} to zero them
 
 struct HalfRegister final{
     uint8_t byte;
-    HalfRegister();
-    HalfRegister(uint8_t byte);
-    operator uint8_t() const;
-    HalfRegister& operator^=(uint8_t rhs);
-    HalfRegister& operator|=(uint8_t rhs);
-    HalfRegister& operator&=(uint8_t rhs);
-    HalfRegister& operator+=(uint8_t rhs);
-    HalfRegister& operator-=(uint8_t rhs);
-    HalfRegister& operator--();
-    HalfRegister operator--(int);
-    HalfRegister& operator++();
-    HalfRegister operator++(int);
-    bool testBit(uint8_t bit) const;
-    void setBit(uint8_t bit);
-    void setBit(uint8_t bit, bool value);
-    void clearBit(uint8_t bit);
+    HalfRegister() = default;
+    constexpr HalfRegister(uint8_t byte) : byte{byte}{}
+    constexpr operator uint8_t() const{ return byte; }
+    constexpr HalfRegister& operator^=(uint8_t rhs){ byte ^= rhs; return *this; }
+    constexpr HalfRegister& operator|=(uint8_t rhs){ byte |= rhs; return *this; }
+    constexpr HalfRegister& operator&=(uint8_t rhs){ byte &= rhs; return *this; }
+    constexpr HalfRegister& operator+=(uint8_t rhs){ byte += rhs; return *this; }
+    constexpr HalfRegister& operator-=(uint8_t rhs){ byte -= rhs; return *this; }
+    constexpr HalfRegister& operator--(){ --byte; return *this; }
+    constexpr HalfRegister operator--(int){ HalfRegister temp{*this}; --byte; return temp; }
+    constexpr HalfRegister& operator++(){ ++byte; return *this; }
+    constexpr HalfRegister operator++(int){ HalfRegister temp{*this}; ++byte; return temp; }
+    // Test, set or clear the nth bit in the register
+    constexpr bool testBit(uint8_t bit) const{ return (0b1 << bit) & byte; }
+    constexpr void setBit(uint8_t bit){ byte |= (0b1 << bit); }
+    constexpr void setBit(uint8_t bit, bool value){ value ? setBit(bit) : clearBit(bit); }
+    constexpr void clearBit(uint8_t bit){ byte &= ~(0b1 << bit); }
 };
+
+// 16-bit register, stored little-endian so that a pair can be accessed as a single word in memory
 struct Register final{
     HalfRegister lowerByte;
     HalfRegister upperByte;
-    Register();
-    Register(uint8_t lowerByte, uint8_t upperByte);
-    Register(uint16_t val);
-    operator uint16_t() const;
-    Register& operator--();
-    Register operator--(int);
-    Register& operator++();
-    Register operator++(int);
-    Register& operator+=(uint16_t rhs);
-    Register& operator-=(uint16_t rhs);
+    Register() = default;
+    constexpr Register(uint8_t lowerByte, uint8_t upperByte) : lowerByte{lowerByte}, upperByte{upperByte}{}
+    constexpr Register(uint16_t val) : lowerByte(val & 0x00FF), upperByte(val >> 8){}
+    constexpr operator uint16_t() const{ return (upperByte << 8) + lowerByte; }
+    constexpr Register& operator--(){ return *this = uint16_t(uint16_t(*this) - 1); }
+    constexpr Register operator--(int){ Register temp{*this}; operator--(); return temp; }
+    constexpr Register& operator++(){ return *this = uint16_t(uint16_t(*this) + 1); }
+    constexpr Register operator++(int){ Register temp{*this}; operator++(); return temp; }
+    constexpr Register& operator+=(uint16_t rhs){ return *this = uint16_t(uint16_t(*this) + rhs); }
+    constexpr Register& operator-=(uint16_t rhs){ return *this = uint16_t(uint16_t(*this) - rhs); }
 };
 
+// The complete SM83 register file as a packed 12-byte POD (so it may be copied with memcpy)
+// The 8-bit registers are views of the bytes of the AF, BC, DE and HL pairs
+struct RegisterFile{
+    Register AF, BC, DE, HL, SP, PC;
+    constexpr HalfRegister& A(){ return AF.upperByte; }
+    constexpr HalfRegister& F(){ return AF.lowerByte; }
+    constexpr HalfRegister& B(){ return BC.upperByte; }
+    constexpr HalfRegister& C(){ return BC.lowerByte; }
+    constexpr HalfRegister& D(){ return DE.upperByte; }
+    constexpr HalfRegister& E(){ return DE.lowerByte; }
+    constexpr HalfRegister& H(){ return HL.upperByte; }
+    constexpr HalfRegister& L(){ return HL.lowerByte; }
+    constexpr HalfRegister A() const{ return AF.upperByte; }
+    constexpr HalfRegister F() const{ return AF.lowerByte; }
+    constexpr HalfRegister B() const{ return BC.upperByte; }
+    constexpr HalfRegister C() const{ return BC.lowerByte; }
+    constexpr HalfRegister D() const{ return DE.upperByte; }
+    constexpr HalfRegister E() const{ return DE.lowerByte; }
+    constexpr HalfRegister H() const{ return HL.upperByte; }
+    constexpr HalfRegister L() const{ return HL.lowerByte; }
+};
+
+static_assert(sizeof(RegisterFile) == 12, "Register file must be packed");
+static_assert(std::is_trivial_v<RegisterFile> && std::is_standard_layout_v<RegisterFile>, "Register file must be POD");
+
 #endif
\ No newline at end of file
@@ -0,0 +1,41 @@
+#ifndef _GB_EMU_SAVE_RAM_H_
+#define  _GB_EMU_SAVE_RAM_H_
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <string>
+
+// Cartridge RAM, which for battery-backed cartridges is a shared mapping of the save file - every write reaches the
+// OS page cache immediately (so survives the emulator being killed), and flush() only asks for it to be written to disk
+// Copies (as made by the diff engine) are plain memory, so that only the original writes to the save file
+class SaveRAM final{
+public:
+    SaveRAM() = default;
+    explicit SaveRAM(std::size_t size) : buffer(size, 0x00), ramSize{size}{}
+    SaveRAM(SaveRAM const& other);
+    SaveRAM& operator=(SaveRAM const& other);
+    ~SaveRAM();
+    // Backs the RAM with the save file at path, which is created (or extended) if needed - any other contents are kept
+    bool open(std::string const& path, std::size_t size);
+    // Starts writing changes back to the save file, without waiting for them to reach the disk
+    void flush();
+    uint8_t* data(){ return mapping ? mapping : buffer.data(); }
+    uint8_t const* data() const{ return mapping ? mapping : buffer.data(); }
+    std::size_t size() const{ return ramSize; }
+    uint8_t& operator[](std::size_t index){ return data()[index]; }
+    uint8_t operator[](std::size_t index) const{ return data()[index]; }
+    std::string const& getPath() const{ return path; }
+private:
+    bool map(std::string const& path);
+    void unmap();
+    uint8_t* mapping = nullptr;
+#ifdef _WIN32
+    void* mappingHandle = nullptr;
+#endif
+    std::vector<uint8_t> buffer; // Used when there is no save file, or it cannot be mapped
+    std::size_t ramSize = 0;
+    std::string path; // Save file, if any
+};
+
+#endif
\ No newline at end of file
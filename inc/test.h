@@ -3,10 +3,13 @@
 
 #include "..\inc\emulator.h"
 #include "..\inc\json.hpp"
+#include "..\inc\trace_file.h"
 
 #include <vector>
 #include <algorithm>
 #include <cmath>
+#include <filesystem>
+#include <optional>
 
 class TestFramework final{
 public:
@@ -24,7 +27,28 @@ private:
         {"Register arithmetic/logical operations", testRegisterOps},
         {"Half register arithmetic/logical operations", testHalfRegisterOps},
         {"Memory map byte r/w", testByteRW},
-        {"Memory map word r/w", testWordRW}
+        {"Memory map word r/w", testWordRW},
+        {"Memory map pages", testMemoryPages},
+        {"I/O registers", testIORegisters},
+        {"Tile cache", testTileCache},
+        {"Pixel kernels", testPixelKernels},
+        {"Object priority", testObjectPriority},
+        {"Memory bank controllers", testBankControllers},
+        {"Boot and cartridge images", testFileImages},
+        {"Battery-backed RAM", testSaveRAM},
+        {"Block cache invalidation", testBlockCacheInvalidation},
+        {"Dynarec matches interpreter", testDynarec},
+        {"Dynarec leaves I/O accesses to interpreter", testDynarecIO},
+        {"Dynarec takes interrupts after EI", testDynarecInterrupts},
+        {"Bank switch within a block", testBankSwitchInBlock},
+        {"Idle loop detection", testIdleLoop},
+        {"Superinstructions match interpreter", testSuperinstructions},
+        {"Trace ring buffer", testTraceBuffer},
+        {"Trace file round trip", testTraceFile},
+        {"Opcode profile", testOpcodeProfiler},
+        {"Guest profile call stack", testGuestProfiler},
+        {"Opcode table cycles", testOpcodeCycles},
+        {"Interrupt priority", testInterruptPriority}
     };
     // CPU/Register tests
     bool testReadRegister();
@@ -35,6 +59,32 @@ private:
     // MMU tests
     bool testByteRW();
     bool testWordRW();
+    bool testMemoryPages();
+    bool testIORegisters();
+    bool testTileCache();
+    bool testPixelKernels();
+    bool testObjectPriority();
+    bool testBankControllers();
+    bool testFileImages();
+    bool testSaveRAM();
+    // Block cache tests
+    bool testBlockCacheInvalidation();
+    // Dynarec tests
+    bool testDynarec();
+    bool testDynarecIO();
+    bool testDynarecInterrupts();
+    bool testBankSwitchInBlock();
+    // Idle loop tests
+    bool testIdleLoop();
+    bool testSuperinstructions();
+    // Trace tests
+    bool testTraceBuffer();
+    bool testTraceFile();
+    bool testOpcodeProfiler();
+    bool testGuestProfiler();
+    bool testOpcodeCycles();
+    // Interrupt tests
+    bool testInterruptPriority();
     // Opcode tests
     bool testOpcode(uint8_t opcode, bool CBOpcode);
 };
@@ -0,0 +1,33 @@
+#ifndef _GB_EMU_TILE_CACHE_H_
+#define  _GB_EMU_TILE_CACHE_H_
+
+#include "..\inc\memory_map.h"
+#include "..\inc\pixel_kernels.h"
+
+#include <cstdint>
+#include <array>
+
+// The 384 tiles in VRAM (0x8000-0x97FF), decoded to one colour index (0-3) per byte, both as stored and flipped in x
+// Writes to VRAM are already counted for each 64-byte line (four tiles) by the memory map, so tiles are marked dirty
+// at no extra cost to writes, and re-decoded by update() only when a line's count has changed since it was last seen
+class TileCache final{
+public:
+    static uint16_t constexpr tileCount = 384;
+    explicit TileCache(MemoryMap const& memMap);
+    void update();
+    // Every tile is decoded again by the next update
+    void setKernels(PixelKernels const& pixelKernels){ kernels = &pixelKernels; decoded = false; }
+    // The eight colour indices in row y of tile, from left to right as drawn
+    uint8_t const* getRow(uint16_t tile, uint8_t y, bool flipX = false) const{ return tiles[flipX][tile][y].data(); }
+private:
+    void decodeTile(uint16_t tile);
+    MemoryMap const& memoryMap;
+    PixelKernels const* kernels = &PixelKernels::best();
+    using Tile = std::array<std::array<uint8_t, 8>, 8>;
+    std::array<std::array<Tile, tileCount>, 2> tiles{}; // As stored, then flipped in x
+    static uint16_t constexpr tilesPerLine = MemoryMap::writeCountLineSize / 16;
+    std::array<uint32_t, tileCount / tilesPerLine> writeCounts{}; // For each line, when last decoded
+    bool decoded = false;
+};
+
+#endif
\ No newline at end of file
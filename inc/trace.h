@@ -0,0 +1,61 @@
+#ifndef _GB_EMU_TRACE_H_
+#define  _GB_EMU_TRACE_H_
+
+#include <cstdint>
+#include <cstddef>
+#include <array>
+
+// Instruction tracing is selected at build time:
+//  default: compiled out, every trace operation is an empty inline function
+//  -DGB_EMU_TRACE: the most recent instructions are kept in a ring buffer (-DGB_EMU_TRACE_LENGTH=n sets the
+//                  number kept, which must be a power of two)
+
+// One executed instruction
+struct TraceEntry final{
+    uint64_t cycle; // Cycles executed by the CPU before this instruction
+    uint16_t PC;
+    uint16_t bank; // ROM bank mapped at PC
+    uint8_t opcode;
+    uint8_t opcodeCB; // Only meaningful if opcode is 0xCB
+};
+
+// Fixed-size ring buffer of the most recent instructions - recording is a single store and increment
+template <std::size_t length>
+class TraceBuffer final{
+    static_assert(length != 0 && (length & (length - 1)) == 0, "Trace length must be a power of two");
+public:
+    static constexpr bool enabled = true;
+    void record(TraceEntry const& entry){ entries[next++ & (length - 1)] = entry; }
+    // Number of entries held, up to the buffer length
+    std::size_t size() const{ return next < length ? next : length; }
+    // Entries are indexed from the oldest held
+    TraceEntry const& operator[](std::size_t i) const{ return entries[(next - size() + i) & (length - 1)]; }
+    void clear(){ next = 0; }
+private:
+    std::array<TraceEntry, length> entries{};
+    uint64_t next = 0; // Total number of entries recorded
+};
+
+// Tracing policy used when tracing is compiled out
+class NullTrace final{
+public:
+    static constexpr bool enabled = false;
+    void record(TraceEntry const&){}
+    std::size_t size() const{ return 0; }
+    TraceEntry const& operator[](std::size_t) const{ return empty; }
+    void clear(){}
+private:
+    static constexpr TraceEntry empty{};
+};
+
+#ifndef GB_EMU_TRACE_LENGTH
+#define GB_EMU_TRACE_LENGTH 4096
+#endif
+
+#ifdef GB_EMU_TRACE
+using InstructionTrace = TraceBuffer<GB_EMU_TRACE_LENGTH>;
+#else
+using InstructionTrace = NullTrace;
+#endif
+
+#endif
\ No newline at end of file
@@ -0,0 +1,72 @@
+#ifndef _GB_EMU_TRACE_FILE_H_
+#define  _GB_EMU_TRACE_FILE_H_
+
+#include <cstdint>
+#include <array>
+#include <vector>
+#include <deque>
+#include <string>
+#include <fstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// State of the CPU as an instruction is about to execute
+struct TraceRecord final{
+    uint64_t cycle = 0; // Cycles executed by the CPU before this instruction
+    uint16_t PC = 0;
+    uint16_t SP = 0;
+    std::array<uint8_t, 8> registers{}; // A, F, B, C, D, E, H, L
+    std::array<uint8_t, 3> opcodeBytes{}; // Opcode followed by its operand (or CB opcode)
+    uint8_t length = 1; // Number of opcode bytes
+    bool operator==(TraceRecord const&) const = default;
+};
+
+// Trace files hold one delta-encoded entry per instruction, after an 8-byte header:
+//  byte 0: bit n set if registers[n] differs from the previous entry
+//  byte 1: bits 0-1 hold the instruction length, bit 2 is set if PC does not follow on from the
+//          previous instruction, and bit 3 if SP has changed
+//  varint: cycles since the previous entry (LEB128)
+//  then PC (if flagged, little-endian), the opcode bytes, the changed registers and SP (if flagged)
+// Sequential straight-line code typically takes 5 bytes per instruction
+
+// Writes trace records to a file - entries are encoded into large buffers on the calling thread,
+// which are written out by a background thread so that the emulator never waits for the disk
+class TraceWriter final{
+public:
+    TraceWriter(std::string const& path);
+    ~TraceWriter();
+    TraceWriter(TraceWriter const&) = delete;
+    TraceWriter& operator=(TraceWriter const&) = delete;
+    void record(TraceRecord const& record);
+private:
+    void submitBuffer();
+    void writeBuffers();
+    std::ofstream file;
+    std::vector<uint8_t> buffer; // Being filled by the emulator
+    std::deque<std::vector<uint8_t>> fullBuffers; // Waiting to be written
+    std::vector<std::vector<uint8_t>> spareBuffers; // Written, and ready to be reused
+    std::mutex mutex;
+    std::condition_variable buffersReady;
+    bool finished = false;
+    std::thread writer;
+    TraceRecord previous;
+    static std::size_t constexpr bufferSize = 0x100000;
+};
+
+// Reads trace records back from a file, in order
+class TraceReader final{
+public:
+    TraceReader(std::string const& path);
+    bool next(TraceRecord& record);
+    static bool diff(std::string const& pathA, std::string const& pathB);
+private:
+    bool fill(std::size_t bytes);
+    std::ifstream file;
+    std::vector<uint8_t> buffer;
+    std::size_t position = 0;
+    TraceRecord current;
+    static std::size_t constexpr bufferSize = 0x100000;
+};
+
+#endif
\ No newline at end of file
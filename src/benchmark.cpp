@@ -0,0 +1,294 @@
+#include "..\inc\benchmark.h"
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+
+bool BenchmarkFramework::start(){
+    int const n = benchmarks.size();
+    std::cout << "**BENCHMARKS**\n";
+    for (int i = 0 ; i < n ; ++i){
+        std::cout << "Benchmark " << i + 1 << " of " << n << " (" << benchmarks[i].benchmarkName << "):\n";
+        (this ->* (benchmarks[i].run))();
+    }
+    return EXIT_SUCCESS;
+}
+
+// Interpreter fetching and dispatching every opcode
+void BenchmarkFramework::benchOpcodeDispatch(){
+    std::cout << "\tDispatch strategy: " << CPU::dispatchStrategy << "\n";
+    runOpcodeLoop(false);
+}
+
+// Cached interpreter running pre-decoded blocks
+void BenchmarkFramework::benchBlockCache(){
+    runOpcodeLoop(true);
+}
+
+// Hot blocks compiled to native code
+void BenchmarkFramework::benchDynarec(){
+    if (!Dynarec::isAvailable()){
+        std::cout << "\tSkipped: dynarec is not supported on this platform\n";
+        return;
+    }
+    runOpcodeLoop(true, CPUEngine::jit);
+}
+
+// Cached interpreter running a loop of CB-prefixed opcodes, as in input handling and collision checks
+void BenchmarkFramework::benchCBOpcodes(){
+    std::vector<uint8_t> const program{
+        0x21, 0x00, 0xC0,       // LD HL, 0xC000
+        0x06, 0x00,             // LD B, 0x00
+        0xCB, 0x47,             // BIT 0, A
+        0xCB, 0x4F,             // BIT 1, A
+        0xCB, 0x71,             // BIT 6, C
+        0xCB, 0x7E,             // BIT 7, (HL)
+        0xCB, 0xC1,             // SET 0, C
+        0xCB, 0x8F,             // RES 1, A
+        0xCB, 0x11,             // RL C
+        0xCB, 0x3F,             // SRL A
+        0xCB, 0x37,             // SWAP A
+        0xCB, 0x1A,             // RR D
+        0xCB, 0x23,             // SLA E
+        0xCB, 0xD6,             // SET 2, (HL)
+        0xCB, 0x2C,             // SRA H
+        0xCB, 0x05,             // RLC L
+        0x26, 0xC0,             // LD H, 0xC0
+        0x05,                   // DEC B
+        0x20, 0xDF,             // JR NZ to 0x0005
+        0xC3, 0x00, 0x00        // JP 0x0000
+    };
+    runProgram(program, true);
+}
+
+// Copy, fill and delay loops, as run in batches between GPU mode changes, with each loop run instruction by instruction
+// and then as superinstructions
+void BenchmarkFramework::benchSuperinstructions(){
+    std::vector<uint8_t> const program{
+        0x21, 0x00, 0x40,       // LD HL, 0x4000
+        0x11, 0x00, 0x80,       // LD DE, 0x8000
+        0x01, 0x00, 0x18,       // LD BC, 0x1800
+        0x2A,                   // LD A, (HL++)
+        0x12,                   // LD (DE), A
+        0x13,                   // INC DE
+        0x0B,                   // DEC BC
+        0x78,                   // LD A, B
+        0xB1,                   // OR A, C
+        0x20, 0xF8,             // JR NZ to 0x0009
+        0x21, 0xFF, 0xDF,       // LD HL, 0xDFFF
+        0x0E, 0x20,             // LD C, 0x20
+        0x32,                   // LD (HL--), A
+        0x05,                   // DEC B
+        0x20, 0xFC,             // JR NZ to 0x0016
+        0x0D,                   // DEC C
+        0x20, 0xF9,             // JR NZ to 0x0016
+        0x05,                   // DEC B
+        0x20, 0xFD,             // JR NZ to 0x001D
+        0xC3, 0x00, 0x00        // JP 0x0000
+    };
+    std::cout << "\tInstruction by instruction:\n";
+    runBatches(program, false);
+    std::cout << "\tSuperinstructions:\n";
+    runBatches(program, true);
+}
+
+// Reads from a mix of addresses like that of a running ROM - mostly opcode fetches from ROM, then loads from WRAM, HRAM,
+// VRAM, echo RAM and the I/O registers
+void BenchmarkFramework::benchMemoryReads(){
+    MemoryMap mem;
+    CPU cpu(mem);
+    cpu.simulateBoot();
+    std::array<uint16_t, 0x1000> addresses;
+    uint32_t random = 12345;
+    for (auto& address : addresses){
+        random = random * 1103515245 + 12345;
+        uint16_t const offset = random >> 16;
+        switch((random >> 8) & 0x0F){
+        case 8: case 9: address = 0xC000 + (offset & 0x1FFF); break; // WRAM
+        case 10: address = 0x8000 + (offset & 0x1FFF); break; // VRAM
+        case 11: address = 0xFF80 + (offset & 0x7E); break; // HRAM
+        case 12: address = 0xE000 + (offset & 0x1DFF); break; // Echo RAM
+        case 13: address = 0xFF00 + (offset & 0x7F); break; // I/O registers
+        default: address = offset & 0x7FFF; break; // ROM
+        }
+    }
+
+    uint64_t const numReads = 200000000;
+    uint32_t sum = 0;
+    auto tStart = std::chrono::high_resolution_clock::now();
+    for (uint64_t i = 0 ; i < numReads ; ++i){
+        sum += mem.readByte(addresses[i & (addresses.size() - 1)]);
+    }
+    double const seconds = secondsSince(tStart);
+    uint32_t volatile const checksum = sum; // Keeps the reads from being optimised away
+    (void)checksum;
+    report("Reads per second", numReads / seconds, "reads/s");
+}
+
+// Loads an 8 MB cartridge (from the page cache, as it has just been written) by copying it through a stream, as
+// cartridges used to be loaded, and by mapping it, then times from creating the memory map to the first instruction
+// Mapped pages are only read from the file when first accessed, which the time to the first instruction includes
+void BenchmarkFramework::benchCartridgeLoading(){
+    std::string const path = (std::filesystem::temp_directory_path() / "gb_emu_benchmark.gb").string();
+    std::vector<uint8_t> rom(0x800000);
+    for (std::size_t i = 0 ; i < rom.size() ; ++i){
+        rom[i] = uint8_t(i * 0x9E3779B1 >> 24);
+    }
+    rom[0x100] = 0x00; // NOP
+    rom[0x147] = 0x19; // MBC5
+    std::ofstream(path, std::ios_base::binary).write(reinterpret_cast<char const*>(rom.data()), rom.size());
+
+    int const numLoads = 20;
+    auto tStart = std::chrono::high_resolution_clock::now();
+    for (int i = 0 ; i < numLoads ; ++i){
+        std::ifstream fileStream(path.c_str(), std::ios_base::binary);
+        std::vector<uint8_t> const data((std::istreambuf_iterator<char>(fileStream)), (std::istreambuf_iterator<char>()));
+        std::vector<uint8_t> image(data.size());
+        for (std::size_t j = 0 ; j < data.size() ; ++j){
+            image[j] = data[j];
+        }
+    }
+    report("Stream copy", 1e6 * secondsSince(tStart) / numLoads, "us");
+
+    tStart = std::chrono::high_resolution_clock::now();
+    for (int i = 0 ; i < numLoads ; ++i){
+        FileImage image;
+        image.open(path, rom.size());
+    }
+    report("Memory mapped", 1e6 * secondsSince(tStart) / numLoads, "us");
+
+    tStart = std::chrono::high_resolution_clock::now();
+    for (int i = 0 ; i < numLoads ; ++i){
+        MemoryMap mem;
+        CPU cpu(mem);
+        cpu.simulateBoot();
+        mem.loadCartridge(path);
+        cpu.executeNextOpcode();
+    }
+    report("Startup to first instruction", 1e6 * secondsSince(tStart) / numLoads, "us");
+    std::filesystem::remove(path);
+}
+
+// Draws lines of a frame with random tiles and maps, the window over the right half and all 40 objects on screen
+// Each update of one line's cycles runs through OAM scan, drawing and horizontal blank once
+// The scalar kernels are run first, for comparison with the fastest the host supports
+void BenchmarkFramework::benchScanlineRendering(){
+    runScanlines(PixelKernels::scalar());
+    if (&PixelKernels::best() != &PixelKernels::scalar()){
+        runScanlines(PixelKernels::best());
+    }
+}
+
+// Renders a screen of random tiles with a window and a full set of objects
+void BenchmarkFramework::runScanlines(PixelKernels const& kernels){
+    MemoryMap mem;
+    CPU cpu(mem);
+    GPU gpu(mem, cpu);
+    gpu.setPixelKernels(kernels);
+    cpu.simulateBoot();
+    uint32_t random = 12345;
+    for (uint16_t address = 0x8000 ; address < 0xA000 ; ++address){
+        random = random * 1103515245 + 12345;
+        mem.writeByte(address, random >> 16);
+    }
+    for (uint8_t obj = 0 ; obj < 40 ; ++obj){
+        mem.writeByte(0xFE00 + 4 * obj, 16 + (obj * 37) % 144); // Y
+        mem.writeByte(0xFE01 + 4 * obj, 8 + (obj * 53) % 160); // X
+        mem.writeByte(0xFE02 + 4 * obj, obj);
+        mem.writeByte(0xFE03 + 4 * obj, (obj & 0x07) << 4); // Palette, flips and priority
+    }
+    mem.writeByte(0xFF4A, 0x00); // WY
+    mem.writeByte(0xFF4B, 7 + 80); // WX
+    mem.writeByte(0xFF42, 0x03); // SCY
+    mem.writeByte(0xFF43, 0x05); // SCX
+    mem.writeByte(0xFF40, 0xE3); // LCD, window (0x9C00 map), signed tile data, bg (0x9800 map), objects and bg enabled
+
+    uint32_t const numLines = 200000;
+    auto tStart = std::chrono::high_resolution_clock::now();
+    for (uint32_t i = 0 ; i < numLines ; ++i){
+        gpu.update(456);
+    }
+    report(std::string("Lines per second (") + kernels.name + ")", numLines / secondsSince(tStart), "lines/s");
+}
+
+// Executes a tight loop of common load, ALU, CB and branch opcodes from flat memory
+void BenchmarkFramework::runOpcodeLoop(bool blockCache, CPUEngine engine){
+    std::vector<uint8_t> const program{
+        0x06, 0x00,             // LD B, 0x00
+        0x21, 0x00, 0xC0,       // LD HL, 0xC000
+        0x2A,                   // LD A, (HL++)
+        0x80,                   // ADD A, B
+        0xA9,                   // XOR A with C
+        0x4F,                   // LD C, A
+        0x14,                   // INC D
+        0x1D,                   // DEC E
+        0xE6, 0x3F,             // AND A, 0x3F
+        0xB2,                   // OR A, D
+        0xBB,                   // CP A, E
+        0xCB, 0x5F,             // BIT 3, A
+        0xCB, 0x11,             // RL C
+        0xCB, 0x37,             // SWAP A
+        0x77,                   // LD (HL), A
+        0x05,                   // DEC B
+        0x20, 0xEC,             // JR NZ to 0x0005
+        0xC3, 0x00, 0x00        // JP 0x0000
+    };
+    runProgram(program, blockCache, engine);
+}
+
+// Runs a program from address 0 in flat memory for a fixed number of emulated cycles
+// Native blocks run several instructions per call, so instruction counts are only reported when interpreting
+void BenchmarkFramework::runProgram(std::vector<uint8_t> const& program, bool blockCache, CPUEngine engine){
+    CPUState state{};
+    state.memory = std::vector<uint8_t>(0x10000, 0x00);
+    std::copy(program.begin(), program.end(), state.memory.begin());
+    MemoryMap mem;
+    CPU cpu(mem);
+    mem.disableMapping();
+    cpu.setState(state);
+    cpu.enableBlockCache(blockCache);
+    cpu.setEngine(engine);
+
+    uint64_t const numCycles = 100000000;
+    uint64_t cycles = 0, numInstructions = 0;
+    auto tStart = std::chrono::high_resolution_clock::now();
+    while (cycles < numCycles){
+        cycles += cpu.executeNextOpcode();
+        ++numInstructions;
+    }
+    double const seconds = secondsSince(tStart);
+    if (engine == CPUEngine::interpreter){
+        report("Instructions per second", numInstructions / seconds, "instr/s");
+    }
+    report("Emulated clock speed", cycles / seconds / 4194304.0, "x real time");
+}
+
+// Runs a program from address 0 in flat memory for a fixed number of emulated cycles, in batches of the average length of
+// a GPU mode (as superinstructions are cut short by GPU mode changes when running a ROM)
+void BenchmarkFramework::runBatches(std::vector<uint8_t> const& program, bool superinstructions){
+    CPUState state{};
+    state.memory = std::vector<uint8_t>(0x10000, 0x00);
+    std::copy(program.begin(), program.end(), state.memory.begin());
+    MemoryMap mem;
+    CPU cpu(mem);
+    mem.disableMapping();
+    cpu.setState(state);
+    cpu.enableSuperinstructions(superinstructions);
+
+    uint64_t const numCycles = 100000000;
+    uint32_t const batchCycles = 152;
+    uint64_t cycles = 0;
+    auto tStart = std::chrono::high_resolution_clock::now();
+    while (cycles < numCycles){
+        cycles += cpu.run(batchCycles, batchCycles);
+    }
+    report("Emulated clock speed", cycles / secondsSince(tStart) / 4194304.0, "x real time");
+}
+
+void BenchmarkFramework::report(std::string const& metric, double value, std::string const& unit){
+    std::cout << "\t" << metric << ": " << std::fixed << std::setprecision(1) << value << " " << unit << "\n";
+}
+
+double BenchmarkFramework::secondsSince(std::chrono::time_point<std::chrono::high_resolution_clock> tStart){
+    return std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - tStart).count();
+}
\ No newline at end of file
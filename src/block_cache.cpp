@@ -0,0 +1,71 @@
+#include "..\inc\block_cache.h"
+
+BlockCache::BlockCache(MemoryMap const& memMap) : memoryMap{memMap}, blocks(numBlocks){
+}
+
+// Returns the cached block starting at address, if it is still valid
+DecodedBlock* BlockCache::find(uint16_t address){
+    DecodedBlock& block = blocks[address & (numBlocks - 1)];
+    if (block.key == makeKey(address) && isValid(block)){
+        return &block;
+    }
+    return nullptr;
+}
+
+// Returns an empty block for address, evicting whatever previously occupied its slot
+DecodedBlock& BlockCache::allocate(uint16_t address){
+    DecodedBlock& block = blocks[address & (numBlocks - 1)];
+    block.key = makeKey(address);
+    block.startAddress = address;
+    block.endAddress = address;
+    block.inRAM = address >= 0x8000;
+    block.superinstruction = Superinstruction::none;
+    block.executionCount = 0;
+    block.native = nullptr;
+    block.nativeRefused = false;
+    block.opcodes.clear(); // Keeps capacity, so re-decoding does not allocate
+    return block;
+}
+
+// Records the write state of the decoded bytes once decoding is complete
+void BlockCache::seal(DecodedBlock& block) const{
+    block.writeCount = sumWriteCounts(block.startAddress, block.endAddress);
+}
+
+// Write counts only ever increase, so any write to the block's bytes changes the sum
+bool BlockCache::isValid(DecodedBlock const& block) const{
+    return block.writeCount == sumWriteCounts(block.startAddress, block.endAddress);
+}
+
+// Code is only cached from ROM, WRAM and HRAM
+// Returns the last address of the region containing address, or 0 if it is not cacheable
+uint16_t BlockCache::cacheableRegionEnd(uint16_t address) const{
+    if (address < 0x8000){
+        return address < 0x4000 ? 0x3FFF : 0x7FFF;
+    }
+    else if (address >= 0xC000 && address < 0xE000){
+        return 0xDFFF;
+    }
+    else if (address >= 0xFF80 && address < 0xFFFF){
+        return 0xFFFE;
+    }
+    return 0;
+}
+
+void BlockCache::clear(){
+    for (auto& block : blocks){
+        block.key = DecodedBlock::invalidKey;
+    }
+}
+
+uint32_t BlockCache::makeKey(uint16_t address) const{
+    return (uint32_t(memoryMap.getROMBank(address)) << 16) | address;
+}
+
+uint32_t BlockCache::sumWriteCounts(uint16_t startAddress, uint16_t endAddress) const{
+    uint32_t sum = 0;
+    for (uint32_t line = startAddress / MemoryMap::writeCountLineSize ; line <= endAddress / MemoryMap::writeCountLineSize ; ++line){
+        sum += memoryMap.getWriteCount(line * MemoryMap::writeCountLineSize);
+    }
+    return sum;
+}
\ No newline at end of file
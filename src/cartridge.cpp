@@ -0,0 +1,237 @@
+#include "..\inc\cartridge.h"
+
+#include <filesystem>
+#include <algorithm>
+#include <sstream>
+#include <iomanip>
+#include <stdexcept>
+
+// A blank 32 KB ROM with 8 KB of RAM, as for a cartridge without an MBC
+Cartridge::Cartridge() : rom{std::make_shared<FileImage const>(0x8000)}, ram(0x2000), ramEnabled{true}{
+}
+
+bool Cartridge::load(std::string const& path){
+    std::error_code error;
+    std::size_t const fileSize = std::filesystem::file_size(path, error);
+    if (error){
+        return false;
+    }
+    // Banks are selected by masking, so the ROM is padded to a power of two banks (and at least the 32 KB of a cartridge without an MBC)
+    romBankCount = 2;
+    while (romBankCount * std::size_t(0x4000) < fileSize){
+        romBankCount *= 2;
+    }
+    auto image = std::make_shared<FileImage>();
+    if (!image->open(path, romBankCount * std::size_t(0x4000))){
+        return false;
+    }
+
+    // Cartridge header
+    uint8_t const cartridgeType = image->data()[0x147];
+    uint8_t const ramSize = image->data()[0x149];
+    switch(cartridgeType){
+    case 0x00: case 0x08: case 0x09:
+        type = MBCType::none;
+        break;
+    case 0x01: case 0x02: case 0x03:
+        type = MBCType::MBC1;
+        break;
+    case 0x05: case 0x06:
+        type = MBCType::MBC2;
+        break;
+    case 0x0F: case 0x10: case 0x11: case 0x12: case 0x13:
+        type = MBCType::MBC3;
+        break;
+    case 0x19: case 0x1A: case 0x1B: case 0x1C: case 0x1D: case 0x1E:
+        type = MBCType::MBC5;
+        break;
+    default: {
+        std::ostringstream message;
+        message << "Unsupported cartridge type 0x" << std::hex << std::uppercase << std::setfill('0') << std::setw(2) << int(cartridgeType);
+        throw std::runtime_error(message.str());
+    }
+    }
+    std::array<uint8_t, 8> constexpr batteryTypes = {0x03, 0x06, 0x09, 0x0F, 0x10, 0x13, 0x1B, 0x1E};
+    bool const battery = std::find(batteryTypes.begin(), batteryTypes.end(), cartridgeType) != batteryTypes.end();
+    // RAM is 0, 2, 8, 32, 128 or 64 KB - 2 KB is given a whole bank, and MBC2 has 512 half-bytes built in
+    std::array<uint16_t, 6> constexpr ramBankCounts = {0, 1, 1, 4, 16, 8};
+    ramBankCount = ramSize < ramBankCounts.size() ? ramBankCounts[ramSize] : 0;
+    if (type == MBCType::none){
+        ramBankCount = 1; // Always mapped, as before MBCs were supported
+    }
+    std::size_t const ramBytes = type == MBCType::MBC2 ? 0x200 : ramBankCount * 0x2000;
+    ram = SaveRAM(ramBytes);
+    if (battery && ramBytes != 0){
+        ram.open(std::filesystem::path(path).replace_extension(".sav").string(), ramBytes);
+    }
+    rom = std::move(image);
+
+    ramEnabled = type == MBCType::none;
+    romBankRegister = 1;
+    bankRegister = 0;
+    bankingMode = false;
+    clock = {};
+    selectBanks();
+    return true;
+}
+
+void Cartridge::writeRegister(uint16_t address, uint8_t value){
+    switch(type){
+    case MBCType::none:
+        return;
+    case MBCType::MBC1:
+        if (address < 0x2000){
+            enableRAM(value);
+        }
+        else if (address < 0x4000){
+            romBankRegister = value & 0x1F;
+        }
+        else if (address < 0x6000){
+            bankRegister = value & 0x03;
+        }
+        else{
+            bankingMode = value & 0x01;
+        }
+        break;
+    case MBCType::MBC2:
+        // Address bit 8 selects between the two registers, which are only in 0x0000-0x3FFF
+        if (address < 0x4000){
+            if (address & 0x0100){
+                romBankRegister = value & 0x0F;
+            }
+            else{
+                enableRAM(value);
+            }
+        }
+        break;
+    case MBCType::MBC3:
+        if (address < 0x2000){
+            enableRAM(value);
+        }
+        else if (address < 0x4000){
+            romBankRegister = value & 0x7F;
+        }
+        else if (address < 0x6000){
+            bankRegister = value & 0x0F;
+        }
+        else{
+            if (clock.latchWrite == 0x00 && value == 0x01){
+                updateClock();
+                clock.latchedRegisters = clock.registers;
+            }
+            clock.latchWrite = value;
+        }
+        break;
+    case MBCType::MBC5:
+        if (address < 0x2000){
+            enableRAM(value);
+        }
+        else if (address < 0x3000){
+            romBankRegister = (romBankRegister & 0x100) | value;
+        }
+        else if (address < 0x4000){
+            romBankRegister = (romBankRegister & 0xFF) | ((value & 0x01) << 8);
+        }
+        else if (address < 0x6000){
+            bankRegister = value & 0x0F;
+        }
+        break;
+    }
+    selectBanks();
+}
+
+// Games disable RAM once they have finished with it, which is a good time to write the save file back
+void Cartridge::enableRAM(uint8_t value){
+    bool const enabled = (value & 0x0F) == 0x0A;
+    if (ramEnabled && !enabled){
+        ram.flush();
+    }
+    ramEnabled = enabled;
+}
+
+// Bank 0 cannot be selected in 0x4000-0x7FFF except by MBC5 - a register of 0 (in the bits the MBC checks) selects bank 1
+void Cartridge::selectBanks(){
+    uint16_t const romBankMask = romBankCount - 1;
+    uint16_t const romBank = type == MBCType::MBC5 || romBankRegister != 0 ? romBankRegister : 1;
+    lowerROMBank = 0;
+    upperROMBank = romBank;
+    ramBank = 0;
+    switch(type){
+    case MBCType::MBC1:
+        upperROMBank = (bankRegister << 5) | romBank;
+        if (bankingMode){
+            lowerROMBank = (bankRegister << 5) & romBankMask;
+            ramBank = bankRegister;
+        }
+        break;
+    case MBCType::MBC3: case MBCType::MBC5:
+        ramBank = bankRegister;
+        break;
+    default:
+        break;
+    }
+    upperROMBank &= romBankMask;
+    if (ramBankCount != 0){
+        ramBank &= ramBankCount - 1;
+    }
+}
+
+uint8_t* Cartridge::getRAMBankData(){
+    if (!ramEnabled || ramBankCount == 0 || type == MBCType::MBC2 || (type == MBCType::MBC3 && bankRegister >= 0x08)){
+        return nullptr;
+    }
+    return ram.data() + 0x2000 * ramBank;
+}
+
+// Disabled (or missing) RAM reads as 0xFF
+uint8_t Cartridge::readRAM(uint16_t address) const{
+    if (!ramEnabled){
+        return 0xFF;
+    }
+    if (type == MBCType::MBC2){
+        return 0xF0 | ram[address & 0x01FF]; // Only the lower half of each byte is stored, repeated through the window
+    }
+    if (type == MBCType::MBC3 && bankRegister >= 0x08 && bankRegister <= 0x0C){
+        return clock.latchedRegisters[bankRegister - 0x08];
+    }
+    return 0xFF;
+}
+
+void Cartridge::writeRAM(uint16_t address, uint8_t value){
+    if (!ramEnabled){
+        return;
+    }
+    if (type == MBCType::MBC2){
+        ram[address & 0x01FF] = value & 0x0F;
+    }
+    else if (type == MBCType::MBC3 && bankRegister >= 0x08 && bankRegister <= 0x0C){
+        updateClock();
+        if (bankRegister == 0x08){
+            clock.cycles = 0; // Writing the seconds restarts the current second
+        }
+        clock.registers[bankRegister - 0x08] = value;
+    }
+}
+
+// Adds the whole seconds elapsed to the clock registers, unless the clock is halted
+void Cartridge::updateClock(){
+    auto& r = clock.registers;
+    uint64_t const seconds = clock.cycles / cyclesPerSecond;
+    clock.cycles %= cyclesPerSecond;
+    if (r[4] & 0x40 || seconds == 0){
+        return;
+    }
+    uint64_t const day = r[3] | ((r[4] & 0x01) << 8);
+    uint64_t time = r[0] + 60 * (r[1] + 60 * (r[2] + 24 * day)) + seconds;
+    r[0] = time % 60;
+    time /= 60;
+    r[1] = time % 60;
+    time /= 60;
+    r[2] = time % 24;
+    time /= 24;
+    if (time > 0x1FF){
+        r[4] |= 0x80; // Day counter overflowed
+    }
+    r[3] = time & 0xFF;
+    r[4] = (r[4] & 0xFE) | ((time >> 8) & 0x01);
+}
\ No newline at end of file
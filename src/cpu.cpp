@@ -5,531 +5,68 @@ uint8_t constexpr static FLAG_SUBTRACT = 0x40;
 uint8_t constexpr static FLAG_HALFCARRY = 0x20;
 uint8_t constexpr static FLAG_CARRY = 0x10;
 
-CPU::CPU(MemoryMap& memMap) : memoryMap{memMap}, AF{}, BC{}, DE{}, HL{}, SP{}, PC{}{
-    initOpcodeInfo();
-}
-
-void CPU::initOpcodeInfo(){
-    // Opcode info for displaying recent instructions
-    opcodeInfo = std::vector<std::string>(0x100, "");
-    opcodeInfo[0x00] = "NOP";
-    opcodeInfo[0x01] = "LD BC from (PC)";
-    opcodeInfo[0x02] = "LD (BC) from A";
-    opcodeInfo[0x03] = "INC BC";
-    opcodeInfo[0x04] = "INC B";
-    opcodeInfo[0x05] = "DEC B";
-    opcodeInfo[0x06] = "LD B from (PC)";
-    opcodeInfo[0x07] = "RLCA";
-    opcodeInfo[0x08] = "LD (PC) from SP";
-    opcodeInfo[0x09] = "ADD HL, BC";
-    opcodeInfo[0x0A] = "LD A from (BC)";
-    opcodeInfo[0x0B] = "DEC BC";
-    opcodeInfo[0x0C] = "INC C";
-    opcodeInfo[0x0D] = "DEC C";
-    opcodeInfo[0x0E] = "LD C from (PC)";
-    opcodeInfo[0x0F] = "RRCA";
-    opcodeInfo[0x10] = "STOP";
-    opcodeInfo[0x11] = "LD DE from (PC)";
-    opcodeInfo[0x12] = "LD (DE) from A";
-    opcodeInfo[0x13] = "INC DE";
-    opcodeInfo[0x14] = "INC D";
-    opcodeInfo[0x15] = "DEC D";
-    opcodeInfo[0x16] = "LD D from (PC)";
-    opcodeInfo[0x17] = "RLA";
-    opcodeInfo[0x18] = "JR by i8 offset";
-    opcodeInfo[0x09] = "ADD HL, DE";
-    opcodeInfo[0x1A] = "LD A from (DE)";
-    opcodeInfo[0x1B] = "DEC DE";
-    opcodeInfo[0x1C] = "INC E";
-    opcodeInfo[0x1D] = "DEC E";
-    opcodeInfo[0x1E] = "LD E from (PC)";
-    opcodeInfo[0x1F] = "RRA";
-    opcodeInfo[0x20] = "JR by i8 offset if NZ";
-    opcodeInfo[0x21] = "LD HL from (PC)";
-    opcodeInfo[0x22] = "LD (HL++) from A";
-    opcodeInfo[0x23] = "INC HL";
-    opcodeInfo[0x24] = "INC H";
-    opcodeInfo[0x25] = "DEC H";
-    opcodeInfo[0x26] = "LD H from (PC)";
-    opcodeInfo[0x27] = "DAA";
-    opcodeInfo[0x28] = "JR by i8 offset if Z";
-    opcodeInfo[0x29] = "ADD HL, HL";
-    opcodeInfo[0x2A] = "LD A from (HL++)";
-    opcodeInfo[0x2B] = "DEC HL";
-    opcodeInfo[0x2C] = "INC L";
-    opcodeInfo[0x2D] = "DEC L";
-    opcodeInfo[0x2E] = "LD L from (PC)";
-    opcodeInfo[0x2F] = "CPL";
-    opcodeInfo[0x30] = "JR by i8 offset if NC";
-    opcodeInfo[0x31] = "LD SP from (PC)";
-    opcodeInfo[0x32] = "LD (HL--) from A";
-    opcodeInfo[0x33] = "INC SP";
-    opcodeInfo[0x34] = "INC (HL)";
-    opcodeInfo[0x35] = "DEC (HL)";
-    opcodeInfo[0x36] = "LD (HL) from (PC)";
-    opcodeInfo[0x37] = "SCF";
-    opcodeInfo[0x38] = "JR by i8 offset if C";
-    opcodeInfo[0x39] = "ADD HL, SP";
-    opcodeInfo[0x3A] = "LD A, (HL--)";
-    opcodeInfo[0x3B] = "DEC SP";
-    opcodeInfo[0x3C] = "INC A";
-    opcodeInfo[0x3D] = "DEC A";
-    opcodeInfo[0x3E] = "LD A from (PC)";
-    opcodeInfo[0x3F] = "CCF";
-    opcodeInfo[0x40] = "LD B from B";
-    opcodeInfo[0x41] = "LD B from C";
-    opcodeInfo[0x42] = "LD B from D";
-    opcodeInfo[0x43] = "LD B from E";
-    opcodeInfo[0x44] = "LD B from H";
-    opcodeInfo[0x45] = "LD B from L";
-    opcodeInfo[0x46] = "LD B from (HL)";
-    opcodeInfo[0x47] = "LD B from A";
-    opcodeInfo[0x48] = "LD C from B";
-    opcodeInfo[0x49] = "LD C from C";
-    opcodeInfo[0x4A] = "LD C from D";
-    opcodeInfo[0x4B] = "LD C from E";
-    opcodeInfo[0x4C] = "LD C from H";
-    opcodeInfo[0x4D] = "LD C from L";
-    opcodeInfo[0x4E] = "LD C from (HL)";
-    opcodeInfo[0x4F] = "LD C from A";
-    opcodeInfo[0x50] = "LD D from B";
-    opcodeInfo[0x51] = "LD D from C";
-    opcodeInfo[0x52] = "LD D from D";
-    opcodeInfo[0x53] = "LD D from E";
-    opcodeInfo[0x54] = "LD D from H";
-    opcodeInfo[0x55] = "LD D from L";
-    opcodeInfo[0x56] = "LD D from (HL)";
-    opcodeInfo[0x57] = "LD D from A";
-    opcodeInfo[0x58] = "LD E from B";
-    opcodeInfo[0x59] = "LD E from C";
-    opcodeInfo[0x5A] = "LD E from D";
-    opcodeInfo[0x5B] = "LD E from E";
-    opcodeInfo[0x5C] = "LD E from H";
-    opcodeInfo[0x5D] = "LD E from L";
-    opcodeInfo[0x5E] = "LD E from (HL)";
-    opcodeInfo[0x5F] = "LD E from A";
-    opcodeInfo[0x60] = "LD H from B";
-    opcodeInfo[0x61] = "LD H from C";
-    opcodeInfo[0x62] = "LD H from D";
-    opcodeInfo[0x63] = "LD H from E";
-    opcodeInfo[0x64] = "LD H from H";
-    opcodeInfo[0x65] = "LD H from L";
-    opcodeInfo[0x66] = "LD H from (HL)";
-    opcodeInfo[0x67] = "LD H from A";
-    opcodeInfo[0x68] = "LD L from B";
-    opcodeInfo[0x69] = "LD L from C";
-    opcodeInfo[0x6A] = "LD L from D";
-    opcodeInfo[0x6B] = "LD L from E";
-    opcodeInfo[0x6C] = "LD L from H";
-    opcodeInfo[0x6D] = "LD L from L";
-    opcodeInfo[0x6E] = "LD L from (HL)";
-    opcodeInfo[0x6F] = "LD L from A";
-    opcodeInfo[0x70] = "LD (HL) from B";
-    opcodeInfo[0x71] = "LD (HL) from C";
-    opcodeInfo[0x72] = "LD (HL) from D";
-    opcodeInfo[0x73] = "LD (HL) from E";
-    opcodeInfo[0x74] = "LD (HL) from H";
-    opcodeInfo[0x75] = "LD (HL) from L";
-    opcodeInfo[0x76] = "HALT";
-    opcodeInfo[0x77] = "LD (HL) from A";
-    opcodeInfo[0x78] = "LD A from B";
-    opcodeInfo[0x79] = "LD A from C";
-    opcodeInfo[0x7A] = "LD A from D";
-    opcodeInfo[0x7B] = "LD A from E";
-    opcodeInfo[0x7C] = "LD A from H";
-    opcodeInfo[0x7D] = "LD A from L";
-    opcodeInfo[0x7E] = "LD A from (HL)";
-    opcodeInfo[0x7F] = "LD A from A";
-    opcodeInfo[0x80] = "ADD A, B";
-    opcodeInfo[0x81] = "ADD A, C";
-    opcodeInfo[0x82] = "ADD A, D";
-    opcodeInfo[0x83] = "ADD A, E";
-    opcodeInfo[0x84] = "ADD A, H";
-    opcodeInfo[0x85] = "ADD A, L";
-    opcodeInfo[0x86] = "ADD A, (HL)";
-    opcodeInfo[0x87] = "ADD A, A";
-    opcodeInfo[0x88] = "ADC A, B";
-    opcodeInfo[0x89] = "ADC A, C";
-    opcodeInfo[0x8A] = "ADC A, D";
-    opcodeInfo[0x8B] = "ADC A, E";
-    opcodeInfo[0x8C] = "ADC A, H";
-    opcodeInfo[0x8D] = "ADC A, L";
-    opcodeInfo[0x8E] = "ADC A, (HL)";
-    opcodeInfo[0x8F] = "ADC A, A";
-    opcodeInfo[0x90] = "SUB A, B";
-    opcodeInfo[0x91] = "SUB A, C";
-    opcodeInfo[0x92] = "SUB A, D";
-    opcodeInfo[0x93] = "SUB A, E";
-    opcodeInfo[0x94] = "SUB A, H";
-    opcodeInfo[0x95] = "SUB A, L";
-    opcodeInfo[0x96] = "SUB A, (HL)";
-    opcodeInfo[0x97] = "SUB A, A";
-    opcodeInfo[0x98] = "SBC A, B";
-    opcodeInfo[0x99] = "SBC A, C";
-    opcodeInfo[0x9A] = "SBC A, D";
-    opcodeInfo[0x9B] = "SBC A, E";
-    opcodeInfo[0x9C] = "SBC A, H";
-    opcodeInfo[0x9D] = "SBC A, L";
-    opcodeInfo[0x9E] = "SBC A, (HL)";
-    opcodeInfo[0x9F] = "SBC A, A";
-    opcodeInfo[0xA0] = "AND A, B";
-    opcodeInfo[0xA1] = "AND A, C";
-    opcodeInfo[0xA2] = "AND A, D";
-    opcodeInfo[0xA3] = "AND A, E";
-    opcodeInfo[0xA4] = "AND A, H";
-    opcodeInfo[0xA5] = "AND A, L";
-    opcodeInfo[0xA6] = "AND A, (HL)";
-    opcodeInfo[0xA7] = "AND A, A";
-    opcodeInfo[0xA8] = "XOR A with B";
-    opcodeInfo[0xA9] = "XOR A with C";
-    opcodeInfo[0xAA] = "XOR A with D";
-    opcodeInfo[0xAB] = "XOR A with E";
-    opcodeInfo[0xAC] = "XOR A with H";
-    opcodeInfo[0xAD] = "XOR A with L";
-    opcodeInfo[0xAE] = "XOR A with (HL)";
-    opcodeInfo[0xAF] = "XOR A with A";
-    opcodeInfo[0xB0] = "OR A, B";
-    opcodeInfo[0xB1] = "OR A, C";
-    opcodeInfo[0xB2] = "OR A, D";
-    opcodeInfo[0xB3] = "OR A, E";
-    opcodeInfo[0xB4] = "OR A, H";
-    opcodeInfo[0xB5] = "OR A, L";
-    opcodeInfo[0xB6] = "OR A, (HL)";
-    opcodeInfo[0xB7] = "OR A, A";
-    opcodeInfo[0xB8] = "CP A, B";
-    opcodeInfo[0xB9] = "CP A, C";
-    opcodeInfo[0xBA] = "CP A, D";
-    opcodeInfo[0xBB] = "CP A, E";
-    opcodeInfo[0xBC] = "CP A, H";
-    opcodeInfo[0xBD] = "CP A, L";
-    opcodeInfo[0xBE] = "CP A, (HL)";
-    opcodeInfo[0xBF] = "CP A, A";
-    opcodeInfo[0xC0] = "RET NZ";
-    opcodeInfo[0xC1] = "POP stack to BC";
-    opcodeInfo[0xC2] = "JP NZ, u16";
-    opcodeInfo[0xC3] = "JP u16";
-    opcodeInfo[0xC4] = "CALL NZ, u16";
-    opcodeInfo[0xC5] = "PUSH BC to stack";
-    opcodeInfo[0xC6] = "ADD A, u8";
-    opcodeInfo[0xC7] = "RST 0x00";
-    opcodeInfo[0xC8] = "RET Z";
-    opcodeInfo[0xC9] = "RET";
-    opcodeInfo[0xCA] = "JP Z, u16";
-    opcodeInfo[0xCB] = "CB-prefixed opcode! See next line";
-    opcodeInfo[0xCC] = "CALL Z, u16";
-    opcodeInfo[0xCD] = "CALL (PC)";
-    opcodeInfo[0xCE] = "ADC A, u8";
-    opcodeInfo[0xCF] = "RST 0x08";
-    opcodeInfo[0xD0] = "RET NC";
-    opcodeInfo[0xD1] = "POP stack to DE";
-    opcodeInfo[0xD2] = "JP NC, u16";
-    // No 0xD3 opcode
-    opcodeInfo[0xD4] = "CALL NC, u16";
-    opcodeInfo[0xD5] = "PUSH DE to stack";
-    opcodeInfo[0xD6] = "SUB A, (PC)";
-    opcodeInfo[0xD7] = "RST 0x10";
-    opcodeInfo[0xD8] = "RET C";
-    opcodeInfo[0xD9] = "RETI";
-    opcodeInfo[0xDA] = "JP C, u16";
-    // No 0xDB opcode
-    opcodeInfo[0xDC] = "CALL C, u16";
-    // No 0xDD opcode
-    opcodeInfo[0xDE] = "SBC A, u8";
-    opcodeInfo[0xDF] = "RST 0x18";
-    opcodeInfo[0xE0] = "LD (0xFF00+u8) from A";
-    opcodeInfo[0xE1] = "POP stack to HL";
-    opcodeInfo[0xE2] = "LD (0xFF00+C) from A";
-    // No 0xE3 opcode
-    // No 0xE4 opcode
-    opcodeInfo[0xE5] = "PUSH HL to stack";
-    opcodeInfo[0xE6] = "AND A, u8";
-    opcodeInfo[0xE7] = "RST 0x20";
-    opcodeInfo[0xE8] = "ADD SP, i8";
-    opcodeInfo[0xE9] = "JP HL";
-    opcodeInfo[0xEA] = "LD (u16) from A";
-    // No 0xEB opcode
-    // No 0xEC opcode
-    // No 0xED opcode
-    opcodeInfo[0xEE] = "XOR A with u8";
-    opcodeInfo[0xEF] = "RST 0x28";
-    opcodeInfo[0xF0] = "LD A from (0xFF00+u8)";
-    opcodeInfo[0xF1] = "POP stack to AF";
-    opcodeInfo[0xF2] = "LD A from (0xFF00+C)";
-    opcodeInfo[0xF3] = "Disable interrupts";
-    // No 0xF4 opcode
-    opcodeInfo[0xF5] = "PUSH AF to stack";
-    opcodeInfo[0xF6] = "OR A, u8";
-    opcodeInfo[0xF7] = "RST 0x30";
-    opcodeInfo[0xF8] = "LD HL from SP+i8";
-    opcodeInfo[0xF9] = "LD SP from HL";
-    opcodeInfo[0xFA] = "LD A from (u16)";
-    opcodeInfo[0xFB] = "Enable interrupts";
-    // No 0xFC opcode
-    // No 0xFD opcode
-    opcodeInfo[0xFE] = "CP A, u8";
-    opcodeInfo[0xFF] = "RST 0x38";
-
-    opcodeCBInfo = std::vector<std::string>(0x100, "");
-    opcodeCBInfo[0x00] = "RLC B";
-    opcodeCBInfo[0x01] = "RLC C";
-    opcodeCBInfo[0x02] = "RLC D";
-    opcodeCBInfo[0x03] = "RLC B";
-    opcodeCBInfo[0x04] = "RLC H";
-    opcodeCBInfo[0x05] = "RLC L";
-    opcodeCBInfo[0x06] = "RLC (HL)";
-    opcodeCBInfo[0x07] = "RLC A";
-    opcodeCBInfo[0x08] = "RRC B";
-    opcodeCBInfo[0x09] = "RRC C";
-    opcodeCBInfo[0x0A] = "RRC D";
-    opcodeCBInfo[0x0B] = "RRC B";
-    opcodeCBInfo[0x0C] = "RRC H";
-    opcodeCBInfo[0x0D] = "RRC L";
-    opcodeCBInfo[0x0E] = "RRC (HL)";
-    opcodeCBInfo[0x0F] = "RRC A";
-    opcodeCBInfo[0x10] = "RL B";
-    opcodeCBInfo[0x11] = "RL C";
-    opcodeCBInfo[0x12] = "RL D";
-    opcodeCBInfo[0x13] = "RL B";
-    opcodeCBInfo[0x14] = "RL H";
-    opcodeCBInfo[0x15] = "RL L";
-    opcodeCBInfo[0x16] = "RL (HL)";
-    opcodeCBInfo[0x17] = "RL A";
-    opcodeCBInfo[0x18] = "RR B";
-    opcodeCBInfo[0x19] = "RR C";
-    opcodeCBInfo[0x1A] = "RR D";
-    opcodeCBInfo[0x1B] = "RR B";
-    opcodeCBInfo[0x1C] = "RR H";
-    opcodeCBInfo[0x1D] = "RR L";
-    opcodeCBInfo[0x1E] = "RR (HL)";
-    opcodeCBInfo[0x1F] = "RR A";
-    opcodeCBInfo[0x20] = "SLA B";
-    opcodeCBInfo[0x21] = "SLA C";
-    opcodeCBInfo[0x22] = "SLA D";
-    opcodeCBInfo[0x23] = "SLA E";
-    opcodeCBInfo[0x24] = "SLA H";
-    opcodeCBInfo[0x25] = "SLA L";
-    opcodeCBInfo[0x26] = "SLA (HL)";
-    opcodeCBInfo[0x27] = "SLA A";
-    opcodeCBInfo[0x28] = "SRA B";
-    opcodeCBInfo[0x29] = "SRA C";
-    opcodeCBInfo[0x2A] = "SRA D";
-    opcodeCBInfo[0x2B] = "SRA E";
-    opcodeCBInfo[0x2C] = "SRA H";
-    opcodeCBInfo[0x2D] = "SRA L";
-    opcodeCBInfo[0x2E] = "SRA (HL)";
-    opcodeCBInfo[0x2F] = "SRA A";
-    opcodeCBInfo[0x30] = "SWAP B";
-    opcodeCBInfo[0x31] = "SWAP C";
-    opcodeCBInfo[0x32] = "SWAP D";
-    opcodeCBInfo[0x33] = "SWAP E";
-    opcodeCBInfo[0x34] = "SWAP H";
-    opcodeCBInfo[0x35] = "SWAP L";
-    opcodeCBInfo[0x36] = "SWAP HL";
-    opcodeCBInfo[0x37] = "SWAP A";
-    opcodeCBInfo[0x38] = "SRL B";
-    opcodeCBInfo[0x39] = "SRL C";
-    opcodeCBInfo[0x3A] = "SRL D";
-    opcodeCBInfo[0x3B] = "SRL E";
-    opcodeCBInfo[0x3C] = "SRL H";
-    opcodeCBInfo[0x3D] = "SRL L";
-    opcodeCBInfo[0x3E] = "SRL (HL)";
-    opcodeCBInfo[0x3F] = "SRL A";
-    opcodeCBInfo[0x40] = "BIT 0, B";
-    opcodeCBInfo[0x41] = "BIT 0, C";
-    opcodeCBInfo[0x42] = "BIT 0, D";
-    opcodeCBInfo[0x43] = "BIT 0, E";
-    opcodeCBInfo[0x44] = "BIT 0, H";
-    opcodeCBInfo[0x45] = "BIT 0, L";
-    opcodeCBInfo[0x46] = "BIT 0, (HL)";
-    opcodeCBInfo[0x47] = "BIT 0, A";
-    opcodeCBInfo[0x48] = "BIT 1, B";
-    opcodeCBInfo[0x49] = "BIT 1, C";
-    opcodeCBInfo[0x4A] = "BIT 1, D";
-    opcodeCBInfo[0x4B] = "BIT 1, E";
-    opcodeCBInfo[0x4C] = "BIT 1, H";
-    opcodeCBInfo[0x4D] = "BIT 1, L";
-    opcodeCBInfo[0x4E] = "BIT 1, (HL)";
-    opcodeCBInfo[0x4F] = "BIT 1, A";
-    opcodeCBInfo[0x50] = "BIT 2, B";
-    opcodeCBInfo[0x51] = "BIT 2, C";
-    opcodeCBInfo[0x52] = "BIT 2, D";
-    opcodeCBInfo[0x53] = "BIT 2, E";
-    opcodeCBInfo[0x54] = "BIT 2, H";
-    opcodeCBInfo[0x55] = "BIT 2, L";
-    opcodeCBInfo[0x56] = "BIT 2, (HL)";
-    opcodeCBInfo[0x57] = "BIT 2, A";
-    opcodeCBInfo[0x58] = "BIT 3, B";
-    opcodeCBInfo[0x59] = "BIT 3, C";
-    opcodeCBInfo[0x5A] = "BIT 3, D";
-    opcodeCBInfo[0x5B] = "BIT 3, E";
-    opcodeCBInfo[0x5C] = "BIT 3, H";
-    opcodeCBInfo[0x5D] = "BIT 3, L";
-    opcodeCBInfo[0x5E] = "BIT 3, (HL)";
-    opcodeCBInfo[0x5F] = "BIT 3, A";
-    opcodeCBInfo[0x60] = "BIT 4, B";
-    opcodeCBInfo[0x61] = "BIT 4, C";
-    opcodeCBInfo[0x62] = "BIT 4, D";
-    opcodeCBInfo[0x63] = "BIT 4, E";
-    opcodeCBInfo[0x64] = "BIT 4, H";
-    opcodeCBInfo[0x65] = "BIT 4, L";
-    opcodeCBInfo[0x66] = "BIT 4, (HL)";
-    opcodeCBInfo[0x67] = "BIT 4, A";
-    opcodeCBInfo[0x68] = "BIT 5, B";
-    opcodeCBInfo[0x69] = "BIT 5, C";
-    opcodeCBInfo[0x6A] = "BIT 5, D";
-    opcodeCBInfo[0x6B] = "BIT 5, E";
-    opcodeCBInfo[0x6C] = "BIT 5, H";
-    opcodeCBInfo[0x6D] = "BIT 5, L";
-    opcodeCBInfo[0x6E] = "BIT 5, (HL)";
-    opcodeCBInfo[0x6F] = "BIT 5, A";
-    opcodeCBInfo[0x70] = "BIT 6, B";
-    opcodeCBInfo[0x71] = "BIT 6, C";
-    opcodeCBInfo[0x72] = "BIT 6, D";
-    opcodeCBInfo[0x73] = "BIT 6, E";
-    opcodeCBInfo[0x74] = "BIT 6, H";
-    opcodeCBInfo[0x75] = "BIT 6, L";
-    opcodeCBInfo[0x76] = "BIT 6, (HL)";
-    opcodeCBInfo[0x77] = "BIT 6, A";
-    opcodeCBInfo[0x78] = "BIT 7, B";
-    opcodeCBInfo[0x79] = "BIT 7, C";
-    opcodeCBInfo[0x7A] = "BIT 7, D";
-    opcodeCBInfo[0x7B] = "BIT 7, E";
-    opcodeCBInfo[0x7C] = "BIT 7, H";
-    opcodeCBInfo[0x7D] = "BIT 7, L";
-    opcodeCBInfo[0x7E] = "BIT 7, (HL)";
-    opcodeCBInfo[0x7F] = "BIT 7, A";
-    opcodeCBInfo[0x80] = "RES 0, B";
-    opcodeCBInfo[0x81] = "RES 0, C";
-    opcodeCBInfo[0x82] = "RES 0, D";
-    opcodeCBInfo[0x83] = "RES 0, E";
-    opcodeCBInfo[0x84] = "RES 0, H";
-    opcodeCBInfo[0x85] = "RES 0, L";
-    opcodeCBInfo[0x86] = "RES 0, (HL)";
-    opcodeCBInfo[0x87] = "RES 0, A";
-    opcodeCBInfo[0x88] = "RES 1, B";
-    opcodeCBInfo[0x89] = "RES 1, C";
-    opcodeCBInfo[0x8A] = "RES 1, D";
-    opcodeCBInfo[0x8B] = "RES 1, E";
-    opcodeCBInfo[0x8C] = "RES 1, H";
-    opcodeCBInfo[0x8D] = "RES 1, L";
-    opcodeCBInfo[0x8E] = "RES 1, (HL)";
-    opcodeCBInfo[0x8F] = "RES 1, A";
-    opcodeCBInfo[0x90] = "RES 2, B";
-    opcodeCBInfo[0x91] = "RES 2, C";
-    opcodeCBInfo[0x92] = "RES 2, D";
-    opcodeCBInfo[0x93] = "RES 2, E";
-    opcodeCBInfo[0x94] = "RES 2, H";
-    opcodeCBInfo[0x95] = "RES 2, L";
-    opcodeCBInfo[0x96] = "RES 2, (HL)";
-    opcodeCBInfo[0x97] = "RES 2, A";
-    opcodeCBInfo[0x98] = "RES 3, B";
-    opcodeCBInfo[0x99] = "RES 3, C";
-    opcodeCBInfo[0x9A] = "RES 3, D";
-    opcodeCBInfo[0x9B] = "RES 3, E";
-    opcodeCBInfo[0x9C] = "RES 3, H";
-    opcodeCBInfo[0x9D] = "RES 3, L";
-    opcodeCBInfo[0x9E] = "RES 3, (HL)";
-    opcodeCBInfo[0x9F] = "RES 3, A";
-    opcodeCBInfo[0xA0] = "RES 4, B";
-    opcodeCBInfo[0xA1] = "RES 4, C";
-    opcodeCBInfo[0xA2] = "RES 4, D";
-    opcodeCBInfo[0xA3] = "RES 4, E";
-    opcodeCBInfo[0xA4] = "RES 4, H";
-    opcodeCBInfo[0xA5] = "RES 4, L";
-    opcodeCBInfo[0xA6] = "RES 4, (HL)";
-    opcodeCBInfo[0xA7] = "RES 4, A";
-    opcodeCBInfo[0xA8] = "RES 5, B";
-    opcodeCBInfo[0xA9] = "RES 5, C";
-    opcodeCBInfo[0xAA] = "RES 5, D";
-    opcodeCBInfo[0xAB] = "RES 5, E";
-    opcodeCBInfo[0xAC] = "RES 5, H";
-    opcodeCBInfo[0xAD] = "RES 5, L";
-    opcodeCBInfo[0xAE] = "RES 5, (HL)";
-    opcodeCBInfo[0xAF] = "RES 5, A";
-    opcodeCBInfo[0xB0] = "RES 6, B";
-    opcodeCBInfo[0xB1] = "RES 6, C";
-    opcodeCBInfo[0xB2] = "RES 6, D";
-    opcodeCBInfo[0xB3] = "RES 6, E";
-    opcodeCBInfo[0xB4] = "RES 6, H";
-    opcodeCBInfo[0xB5] = "RES 6, L";
-    opcodeCBInfo[0xB6] = "RES 6, (HL)";
-    opcodeCBInfo[0xB7] = "RES 6, A";
-    opcodeCBInfo[0xB8] = "RES 7, B";
-    opcodeCBInfo[0xB9] = "RES 7, C";
-    opcodeCBInfo[0xBA] = "RES 7, D";
-    opcodeCBInfo[0xBB] = "RES 7, E";
-    opcodeCBInfo[0xBC] = "RES 7, H";
-    opcodeCBInfo[0xBD] = "RES 7, L";
-    opcodeCBInfo[0xBE] = "RES 7, (HL)";
-    opcodeCBInfo[0xBF] = "RES 7, A";
-    opcodeCBInfo[0xC0] = "SET 0, B";
-    opcodeCBInfo[0xC1] = "SET 0, C";
-    opcodeCBInfo[0xC2] = "SET 0, D";
-    opcodeCBInfo[0xC3] = "SET 0, E";
-    opcodeCBInfo[0xC4] = "SET 0, H";
-    opcodeCBInfo[0xC5] = "SET 0, L";
-    opcodeCBInfo[0xC6] = "SET 0, (HL)";
-    opcodeCBInfo[0xC7] = "SET 0, A";
-    opcodeCBInfo[0xC8] = "SET 1, B";
-    opcodeCBInfo[0xC9] = "SET 1, C";
-    opcodeCBInfo[0xCA] = "SET 1, D";
-    opcodeCBInfo[0xCB] = "SET 1, E";
-    opcodeCBInfo[0xCC] = "SET 1, H";
-    opcodeCBInfo[0xCD] = "SET 1, L";
-    opcodeCBInfo[0xCE] = "SET 1, (HL)";
-    opcodeCBInfo[0xCF] = "SET 1, A";
-    opcodeCBInfo[0xD0] = "SET 2, B";
-    opcodeCBInfo[0xD1] = "SET 2, C";
-    opcodeCBInfo[0xD2] = "SET 2, D";
-    opcodeCBInfo[0xD3] = "SET 2, E";
-    opcodeCBInfo[0xD4] = "SET 2, H";
-    opcodeCBInfo[0xD5] = "SET 2, L";
-    opcodeCBInfo[0xD6] = "SET 2, (HL)";
-    opcodeCBInfo[0xD7] = "SET 2, A";
-    opcodeCBInfo[0xD8] = "SET 3, B";
-    opcodeCBInfo[0xD9] = "SET 3, C";
-    opcodeCBInfo[0xDA] = "SET 3, D";
-    opcodeCBInfo[0xDB] = "SET 3, E";
-    opcodeCBInfo[0xDC] = "SET 3, H";
-    opcodeCBInfo[0xDD] = "SET 3, L";
-    opcodeCBInfo[0xDE] = "SET 3, (HL)";
-    opcodeCBInfo[0xDF] = "SET 3, A";
-    opcodeCBInfo[0xE0] = "SET 4, B";
-    opcodeCBInfo[0xE1] = "SET 4, C";
-    opcodeCBInfo[0xE2] = "SET 4, D";
-    opcodeCBInfo[0xE3] = "SET 4, E";
-    opcodeCBInfo[0xE4] = "SET 4, H";
-    opcodeCBInfo[0xE5] = "SET 4, L";
-    opcodeCBInfo[0xE6] = "SET 4, (HL)";
-    opcodeCBInfo[0xE7] = "SET 4, A";
-    opcodeCBInfo[0xE8] = "SET 5, B";
-    opcodeCBInfo[0xE9] = "SET 5, C";
-    opcodeCBInfo[0xEA] = "SET 5, D";
-    opcodeCBInfo[0xEB] = "SET 5, E";
-    opcodeCBInfo[0xEC] = "SET 5, H";
-    opcodeCBInfo[0xED] = "SET 5, L";
-    opcodeCBInfo[0xEE] = "SET 5, (HL)";
-    opcodeCBInfo[0xEF] = "SET 5, A";
-    opcodeCBInfo[0xF0] = "SET 6, B";
-    opcodeCBInfo[0xF1] = "SET 6, C";
-    opcodeCBInfo[0xF2] = "SET 6, D";
-    opcodeCBInfo[0xF3] = "SET 6, E";
-    opcodeCBInfo[0xF4] = "SET 6, H";
-    opcodeCBInfo[0xF5] = "SET 6, L";
-    opcodeCBInfo[0xF6] = "SET 6, (HL)";
-    opcodeCBInfo[0xF7] = "SET 6, A";
-    opcodeCBInfo[0xF8] = "SET 7, B";
-    opcodeCBInfo[0xF9] = "SET 7, C";
-    opcodeCBInfo[0xFA] = "SET 7, D";
-    opcodeCBInfo[0xFB] = "SET 7, E";
-    opcodeCBInfo[0xFC] = "SET 7, H";
-    opcodeCBInfo[0xFD] = "SET 7, L";
-    opcodeCBInfo[0xFE] = "SET 7, (HL)";
-    opcodeCBInfo[0xFF] = "SET 7, A";
+#ifdef GB_EMU_USE_COMPUTED_GOTO
+// Expands X once for every opcode 0x00-0xFF, used to generate the computed-goto labels
+#define GB_EMU_OPCODE_ROW(X, row) X(row##0) X(row##1) X(row##2) X(row##3) X(row##4) X(row##5) X(row##6) X(row##7) \
+                                  X(row##8) X(row##9) X(row##A) X(row##B) X(row##C) X(row##D) X(row##E) X(row##F)
+#define GB_EMU_FOR_EACH_OPCODE(X) GB_EMU_OPCODE_ROW(X, 0x0) GB_EMU_OPCODE_ROW(X, 0x1) GB_EMU_OPCODE_ROW(X, 0x2) GB_EMU_OPCODE_ROW(X, 0x3) \
+                                  GB_EMU_OPCODE_ROW(X, 0x4) GB_EMU_OPCODE_ROW(X, 0x5) GB_EMU_OPCODE_ROW(X, 0x6) GB_EMU_OPCODE_ROW(X, 0x7) \
+                                  GB_EMU_OPCODE_ROW(X, 0x8) GB_EMU_OPCODE_ROW(X, 0x9) GB_EMU_OPCODE_ROW(X, 0xA) GB_EMU_OPCODE_ROW(X, 0xB) \
+                                  GB_EMU_OPCODE_ROW(X, 0xC) GB_EMU_OPCODE_ROW(X, 0xD) GB_EMU_OPCODE_ROW(X, 0xE) GB_EMU_OPCODE_ROW(X, 0xF)
+#define GB_EMU_OPCODE_LABEL_ADDRESS(opcode) &&label_##opcode,
+#define GB_EMU_OPCODE_LABEL(opcode) label_##opcode: return executeOpcode<opcode>();
+#endif
+
+// Opcodes which may change PC non-sequentially, stop execution or change whether interrupts are dispatched, ending a
+// decoded block - a native block runs to its end before any interrupt is taken, so must end at EI
+bool static endsBlock(uint8_t opcode){
+    switch(opcode){
+    case 0x10: case 0x76:                                           // STOP, HALT
+    case 0xF3: case 0xFB:                                           // DI, EI
+    case 0x18: case 0x20: case 0x28: case 0x30: case 0x38:          // JR
+    case 0xC2: case 0xC3: case 0xCA: case 0xD2: case 0xDA: case 0xE9: // JP
+    case 0xC4: case 0xCC: case 0xCD: case 0xD4: case 0xDC:          // CALL
+    case 0xC0: case 0xC8: case 0xC9: case 0xD0: case 0xD8: case 0xD9: // RET
+    case 0xC7: case 0xCF: case 0xD7: case 0xDF: case 0xE7: case 0xEF: case 0xF7: case 0xFF: // RST
+        return true;
+    default:
+        return false;
+    }
+}
+
+// I/O registers (and IE) - accessing these depends on (or changes) the state of the timers, GPU and interrupts
+bool static isIOAddress(uint16_t address){
+    return (address >= 0xFF00 && address < 0xFF80) || address == 0xFFFF;
+}
+
+// Memory which can only change while the CPU is idle through an interrupt, a GPU mode change,
+// a timer event or new input - DIV and TIMA are excluded as they count up between timer events
+bool static isPollableAddress(uint16_t address){
+    if (address < 0xFF00 || address >= 0xFF80){
+        return true;
+    }
+    switch(address){
+    case 0xFF00: case 0xFF0F: case 0xFF41: case 0xFF44: // P1, IF, STAT, LY
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool static isIllegalOpcode(uint8_t opcode){
+    switch(opcode){
+    case 0xD3: case 0xDB: case 0xDD: case 0xE3: case 0xE4: case 0xEB: case 0xEC: case 0xED: case 0xF4: case 0xFC: case 0xFD:
+        return true;
+    default:
+        return false;
+    }
+}
+
+CPU::CPU(MemoryMap& memMap) : RegisterFile{}, memoryMap{memMap}, blockCache{memMap}{
 }
 
 void CPU::finish(){
-    printRecentOpcodes();
+    printTrace();
     std::cout << "\n\nPC at exit: 0x" << std::hex << PC << "\n";
 }
 
@@ -537,9 +74,88 @@ void CPU::toggleHalt(){
     halted = !halted;
 }
 
+bool CPU::isHalted() const{
+    return halted;
+}
+
+// Returns the cycles taken by one iteration if the CPU has just completed an iteration of an idle loop
+// (which would repeat unchanged until the memory it polls changes), otherwise 0
+uint16_t CPU::getIdleLoopCycles() const{
+    return idleLoopRepeated ? idleLoop.cycles : 0;
+}
+
+// Called after a branch is taken backwards to PC
+void CPU::checkIdleLoop(uint16_t branchAddress){
+    if (branchAddress >= 0x8000){
+        return; // Code in RAM may change, so only loops in ROM are considered
+    }
+    uint32_t const key = (uint32_t(memoryMap.getROMBank(PC)) << 16) | PC;
+    std::array<uint16_t, 3> const pointers = {BC, DE, HL};
+    if (key != idleLoop.key || branchAddress != idleLoop.branchAddress || pointers != idleLoop.pointers){
+        idleLoop = {key, branchAddress, analyseIdleLoop(PC, branchAddress), pointers};
+    }
+    idleLoopRepeated = idleLoop.cycles != 0;
+}
+
+// Recognises short loops which only poll memory, such as LDH A,(0x44) ; CP 0x90 ; JR NZ,loop
+// Every instruction either reloads A from memory or gives the same result when repeated, so after one
+// iteration the loop only changes state once the polled memory does
+// Returns the cycles taken by one iteration, or 0 if the loop is not idle
+uint16_t CPU::analyseIdleLoop(uint16_t start, uint16_t branchAddress) const{
+    if (branchAddress - start > maxIdleLoopLength){
+        return 0;
+    }
+    uint16_t cycles = 0;
+    uint16_t address = start;
+    while (address < branchAddress){
+        uint8_t const opcode = memoryMap.readByte(address);
+        switch(opcode){
+        case 0xF0: // LD A,(FF00+u8)
+            if (!isPollableAddress(0xFF00 + memoryMap.readByte(address + 1))) return 0;
+            break;
+        case 0xFA: // LD A,(u16)
+            if (!isPollableAddress(memoryMap.readWord(address + 1))) return 0;
+            break;
+        case 0xF2: // LD A,(FF00+C)
+            if (!isPollableAddress(0xFF00 + C())) return 0;
+            break;
+        case 0x0A: case 0x1A: case 0x7E: // LD A,(BC) / (DE) / (HL)
+            if (!isPollableAddress(opcode == 0x0A ? BC : opcode == 0x1A ? DE : HL)) return 0;
+            break;
+        case 0xE6: case 0xF6: case 0xFE: // AND / OR / CP u8
+            break;
+        case 0xBE: // CP (HL)
+            if (!isPollableAddress(HL)) return 0;
+            break;
+        case 0xA7: case 0xB7: // AND A, OR A
+        case 0xB8: case 0xB9: case 0xBA: case 0xBB: case 0xBC: case 0xBD: case 0xBF: // CP r
+            break;
+        case 0xCB: // BIT b,A
+            if ((memoryMap.readByte(address + 1) & 0xC7) != 0x47) return 0;
+            break;
+        default:
+            return 0;
+        }
+        cycles += getOpcodeInfo(opcode, memoryMap.readByte(address + 1)).cycles;
+        address += OPCODE_INFO[opcode].length;
+    }
+    if (address != branchAddress){
+        return 0;
+    }
+    uint8_t const branchOpcode = memoryMap.readByte(branchAddress);
+    switch(branchOpcode){
+    case 0x18: case 0x20: case 0x28: case 0x30: case 0x38: // JR
+    case 0xC2: case 0xC3: case 0xCA: case 0xD2: case 0xDA: // JP
+        return cycles + OPCODE_INFO[branchOpcode].branchCycles; // Taken
+    default:
+        return 0;
+    }
+}
+
 void CPU::simulateBoot(){
     // Register states
     AF = 0x01B0;
+    discardPendingFlags();
     BC = 0x0013;
     DE = 0x00D8;
     HL = 0x014D;
@@ -604,14 +220,15 @@ void CPU::simulateBoot(){
 }
 
 void CPU::getState(CPUState& state){
-    state.A = A;
-    state.F = F;
-    state.B = B;
-    state.C = C;
-    state.D = D;
-    state.E = E;
-    state.H = H;
-    state.L = L;
+    resolveFlags();
+    state.A = A();
+    state.F = F();
+    state.B = B();
+    state.C = C();
+    state.D = D();
+    state.E = E();
+    state.H = H();
+    state.L = L();
     state.SP = SP;
     state.PC = PC;
     state.interrupts = interruptsEnabled;
@@ -620,14 +237,15 @@ void CPU::getState(CPUState& state){
 }
 
 void CPU::setState(CPUState const& state){
-    A = state.A;
-    F = state.F;
-    B = state.B;
-    C = state.C;
-    D = state.D;
-    E = state.E;
-    H = state.H;
-    L = state.L;
+    A() = state.A;
+    F() = state.F;
+    discardPendingFlags();
+    B() = state.B;
+    C() = state.C;
+    D() = state.D;
+    E() = state.E;
+    H() = state.H;
+    L() = state.L;
     SP = state.SP;
     PC = state.PC;
     interruptsEnabled = state.interrupts;
@@ -635,73 +253,548 @@ void CPU::setState(CPUState const& state){
     memoryMap.setState(state.memory);
 }
 
+// Runs instructions until cycleBudget cycles have elapsed or the instruction reaching nextEventCycle (the earliest
+// cycle at which a GPU mode change or timer event may happen) has run, without updating the timers or GPU in between
+// Stops early before any instruction which must see the timers and GPU up to date (and when halted or in an idle loop),
+// so the result is the same as updating after every instruction. Returns the cycles taken, which may be 0
+uint32_t CPU::run(uint32_t cycleBudget, uint32_t nextEventCycle){
+    uint32_t const cycleLimit = std::min(cycleBudget, nextEventCycle);
+    uint32_t cycles = 0;
+    while (cycles < cycleLimit && !halted && !idleLoopRepeated){
+        uint32_t const fusedCycles = executeSuperinstruction(cycleLimit - cycles, cycles == 0);
+        if (fusedCycles != 0){
+            cycles += fusedCycles;
+            continue;
+        }
+        if (nextOpcodeNeedsSync()){
+            break;
+        }
+        cycles += executeNextOpcode();
+        if (engine != CPUEngine::interpreter){
+            break; // Native blocks are already batched, and end before any instruction accessing an I/O register
+        }
+    }
+    return cycles;
+}
+
+// True if the instruction at PC may access an I/O register, or change whether interrupts are dispatched
+bool CPU::nextOpcodeNeedsSync() const{
+    uint8_t const opcode = memoryMap.readByte(PC);
+    switch(opcode){
+    case 0x02: case 0x0A:
+        return isIOAddress(BC);
+    case 0x12: case 0x1A:
+        return isIOAddress(DE);
+    case 0x22: case 0x2A: case 0x32: case 0x3A: case 0x34: case 0x35: case 0x36:
+    case 0x46: case 0x4E: case 0x56: case 0x5E: case 0x66: case 0x6E: case 0x7E:
+    case 0x70: case 0x71: case 0x72: case 0x73: case 0x74: case 0x75: case 0x77:
+    case 0x86: case 0x8E: case 0x96: case 0x9E: case 0xA6: case 0xAE: case 0xB6: case 0xBE:
+        return isIOAddress(HL);
+    case 0xCB:
+        return (memoryMap.readByte(PC + 1) & 0x07) == 0x06 && isIOAddress(HL);
+    case 0xE0: case 0xF0:
+        return isIOAddress(0xFF00 + memoryMap.readByte(PC + 1));
+    case 0xE2: case 0xF2:
+        return isIOAddress(0xFF00 + C());
+    case 0x08: case 0xEA: case 0xFA: {
+        uint16_t const address = memoryMap.readWord(PC + 1);
+        return isIOAddress(address) || isIOAddress(address + 1);
+    }
+    case 0xC4: case 0xC5: case 0xC7: case 0xCC: case 0xCD: case 0xCF: case 0xD4: case 0xD5: case 0xD7: case 0xDC: // PUSH, CALL, RST
+    case 0xDF: case 0xE5: case 0xE7: case 0xEF: case 0xF5: case 0xF7: case 0xFF:
+        return isIOAddress(SP - 1) || isIOAddress(SP - 2);
+    case 0xC0: case 0xC1: case 0xC8: case 0xC9: case 0xD0: case 0xD1: case 0xD8: case 0xE1: case 0xF1: // POP, RET
+        return isIOAddress(SP) || isIOAddress(SP + 1);
+    case 0x10: case 0x76: case 0xD9: case 0xFB: // STOP, HALT, RETI, EI
+        return true;
+    default:
+        return isIllegalOpcode(opcode);
+    }
+}
+
+// Counts an instruction run by execute, timing one in every sampleInterval (a plain call unless profiling is compiled in)
+template <typename Execute>
+uint16_t CPU::profileOpcode(uint16_t address, uint8_t opcode, Execute execute){
+    if constexpr (ExecutionProfiler::enabled){
+        uint16_t const index = opcode == 0xCB ? 0x100 | memoryMap.readByte(address + 1) : opcode;
+        if (profiler.sampleDue()){
+            auto const start = ExecutionProfiler::Clock::now();
+            uint16_t const cycles = execute();
+            profiler.recordSample(index, cycles, ExecutionProfiler::Clock::now() - start);
+            return cycles;
+        }
+        uint16_t const cycles = execute();
+        profiler.record(index, cycles);
+        return cycles;
+    }
+    else{
+        return execute();
+    }
+}
+
 uint16_t CPU::executeNextOpcode(){
     if (memoryMap.getBootStatus() && PC == 0x100){
         memoryMap.finishBooting();
+        idleLoop = {}; // The boot program is no longer mapped
     }
+    idleLoopRepeated = false;
+    uint16_t cycles;
     if (halted){
-        return NOP();
+        cycles = NOP();
+    }
+    else if (blockCacheEnabled){
+        cycles = executeCachedOpcode();
+    }
+    else{
+        uint8_t opcode = memoryMap.readByte(PC);
+        traceOpcode(PC, opcode);
+        cycles = profileOpcode(PC++, opcode, [&]{ return executeOpcode(opcode); });
+    }
+    if constexpr (InstructionTrace::enabled){
+        traceCycles += cycles;
+    }
+    return cycles;
+}
+
+// Runs the next instruction from its pre-decoded block, only decoding when
+// entering a block which is not cached (or whose code has since been written)
+// Blocks in RAM are revalidated between instructions, and blocks in ROM whenever the banks mapped have changed
+uint16_t CPU::executeCachedOpcode(){
+    if (atBlockBoundary()){
+        DecodedBlock* const block = enterBlock();
+        if (!block){
+            // Not cacheable, so fetch and decode as usual
+            uint8_t opcode = memoryMap.readByte(PC);
+            traceOpcode(PC, opcode);
+            return profileOpcode(PC++, opcode, [&]{ return executeOpcode(opcode); });
+        }
+        // Native code runs whole blocks, so is not used while booting (the boot program is unmapped at 0x100)
+        if (engine != CPUEngine::interpreter && !memoryMap.getBootStatus() && dynarec.getNativeBlock(*block, *this)){
+            uint16_t const cycles = executeNativeBlock(*block);
+            if (cycles != 0){
+                currentBlock = nullptr;
+                return cycles;
+            }
+            // The first instruction accesses an I/O register, so the block is interpreted instead
+        }
+    }
+    DecodedOpcode const& decodedOpcode = currentBlock->opcodes[nextOpcodeIndex++];
+    traceOpcode(PC, decodedOpcode.opcode);
+    if (decodedOpcode.CBPrefixed){
+        PC += 2;
+    }
+    else{
+        PC += 1;
+    }
+    return profileOpcode(decodedOpcode.address, decodedOpcode.opcode, [&]{ return decodedOpcode.handler(*this); });
+}
+
+// True if the next instruction is not the next one in the current block (or the block's code has since been written,
+// or switched out by the MBC)
+bool CPU::atBlockBoundary() const{
+    return !currentBlock || nextOpcodeIndex == currentBlock->opcodes.size() || currentBlock->opcodes[nextOpcodeIndex].address != PC ||
+           (currentBlock->inRAM ? !blockCache.isValid(*currentBlock) : currentBlockGeneration != memoryMap.getROMBankGeneration());
+}
+
+// Makes the block at PC current, decoding it if it is not cached - returns nullptr if it cannot be cached
+DecodedBlock* CPU::enterBlock(){
+    DecodedBlock* block = blockCache.find(PC);
+    if (!block){
+        block = decodeBlock(PC);
+    }
+    currentBlock = block;
+    currentBlockGeneration = memoryMap.getROMBankGeneration();
+    nextOpcodeIndex = 0;
+    return block;
+}
+
+// Decodes instructions from address until the first branch, returning nullptr if there is nothing to cache
+DecodedBlock* CPU::decodeBlock(uint16_t address){
+    uint16_t const regionEnd = blockCache.cacheableRegionEnd(address);
+    if (regionEnd == 0){
+        return nullptr;
+    }
+    DecodedBlock& block = blockCache.allocate(address);
+    uint32_t opcodeAddress = address;
+    while (block.opcodes.size() < maxBlockLength){
+        uint8_t const opcode = memoryMap.readByte(opcodeAddress);
+        uint32_t const lastByte = opcodeAddress + OPCODE_INFO[opcode].length - 1;
+        if (isIllegalOpcode(opcode) || lastByte > regionEnd){
+            break;
+        }
+        DecodedOpcode decodedOpcode{opcodeTable[opcode], uint16_t(opcodeAddress), opcode, 0x00, false};
+        if (opcode == 0xCB){
+            decodedOpcode.CBPrefixed = true;
+            decodedOpcode.opcodeCB = memoryMap.readByte(opcodeAddress + 1);
+            decodedOpcode.handler = opcodeCBTable[decodedOpcode.opcodeCB];
+        }
+        block.opcodes.push_back(decodedOpcode);
+        block.endAddress = lastByte;
+        opcodeAddress = lastByte + 1;
+        if (endsBlock(opcode)){
+            break;
+        }
+    }
+    if (block.opcodes.empty()){
+        block.key = DecodedBlock::invalidKey;
+        return nullptr;
+    }
+    recogniseSuperinstruction(block);
+    blockCache.seal(block);
+    return &block;
+}
+
+// DEC r, for any register but (HL)
+bool static isDecrement(uint8_t opcode){
+    return (opcode & 0xC7) == 0x05 && opcode != 0x35;
+}
+
+// DEC rr ; LD A,r ; OR r, testing whether BC, DE or HL has reached zero (with either of its bytes loaded into A)
+bool static isWideCounter(uint8_t const* code){
+    uint8_t const upper = (code[0] >> 4) * 2; // Index of the upper byte, as in opcodes (B = 0, C = 1, ...)
+    if ((code[0] & 0xCF) != 0x0B || upper > 4){
+        return false;
+    }
+    return (code[1] == (0x78 | upper) && code[2] == (0xB0 | (upper + 1))) || (code[1] == (0x78 | (upper + 1)) && code[2] == (0xB0 | upper));
+}
+
+// Recognises a block which branches back to its own start as one of the superinstructions (see block_cache.h)
+void CPU::recogniseSuperinstruction(DecodedBlock& block) const{
+    std::array<uint8_t, 8> code;
+    std::size_t const length = block.endAddress - block.startAddress + 1;
+    if (length > code.size()){
+        return;
+    }
+    for (std::size_t i = 0 ; i < length ; ++i){
+        code[i] = memoryMap.readByte(block.startAddress + i);
+    }
+    uint8_t const branch = code[length - 2];
+    if ((branch != 0x20 && branch != 0x28) || int8_t(code[length - 1]) != -int(length)){
+        return; // Not a loop of JR NZ/Z back to the start
+    }
+    std::size_t const bodyLength = length - 2;
+    bool const copying = (code[0] == 0x2A && code[1] == 0x12 && code[2] == 0x13) || (code[0] == 0x1A && code[1] == 0x22 && code[2] == 0x13);
+    if (code[0] == 0xF0 && ((bodyLength == 3 && (code[2] == 0xA7 || code[2] == 0xB7)) ||
+                            (bodyLength == 4 && (code[2] == 0xFE || code[2] == 0xE6 || (code[2] == 0xCB && (code[3] & 0xC7) == 0x47))))){
+        block.superinstruction = Superinstruction::poll;
+    }
+    else if (branch != 0x20){
+        return;
+    }
+    else if ((bodyLength == 1 && isDecrement(code[0])) || (bodyLength == 3 && isWideCounter(&code[0]))){
+        block.superinstruction = Superinstruction::delay;
+        block.counterOpcode = code[0];
+    }
+    else if (bodyLength == 2 && (code[0] == 0x22 || code[0] == 0x32) && isDecrement(code[1]) && code[1] < 0x25){
+        block.superinstruction = Superinstruction::fill; // Counted by B, C, D or E
+        block.counterOpcode = code[1];
+    }
+    else if (copying && ((bodyLength == 4 && (code[3] == 0x05 || code[3] == 0x0D)) || (bodyLength == 6 && code[3] == 0x0B && isWideCounter(&code[3])))){
+        block.superinstruction = Superinstruction::copy; // Counted by B, C or BC
+        block.counterOpcode = code[3];
+    }
+    else{
+        return;
+    }
+    block.iterationCycles = OPCODE_INFO[branch].branchCycles;
+    for (std::size_t i = 0 ; i + 1 < block.opcodes.size() ; ++i){
+        block.iterationCycles += getOpcodeInfo(block.opcodes[i].opcode, block.opcodes[i].opcodeCB).cycles;
+    }
+}
+
+bool static overlaps(uint32_t address, uint32_t length, DecodedBlock const& block){
+    return address <= block.endAddress && block.startAddress < address + length;
+}
+
+// Runs the superinstruction at PC as a single step if it fits within cycleBudget, returning the cycles taken (or 0 if it
+// cannot, so the next instruction must be run as usual)
+// A loop runs as many iterations as fit, all but the last of which only count down and move the pointers (copying or
+// filling memory in bulk) - the last is run by the usual handlers, so the flags, cycles and exit from the loop are exactly
+// as if every instruction were run in turn. Only plain memory may be accessed, so no iteration depends on the timers or GPU
+// A poll reads memory once per step, so if it reads an I/O register it must be the first step of the batch, while the
+// timers and GPU are up to date (synced)
+uint32_t CPU::executeSuperinstruction(uint32_t cycleBudget, bool synced){
+    if constexpr (InstructionTrace::enabled || ExecutionProfiler::enabled){
+        return 0; // Every instruction is traced and profiled individually
+    }
+    if (!superinstructionsEnabled || !blockCacheEnabled || engine != CPUEngine::interpreter || memoryMap.getBootStatus() || !atBlockBoundary()){
+        return 0;
+    }
+    DecodedBlock const* const block = enterBlock();
+    if (!block || block->superinstruction == Superinstruction::none || block->iterationCycles > cycleBudget){
+        return 0;
+    }
+    uint32_t iterations = 1;
+    if (block->superinstruction == Superinstruction::poll){
+        if (!synced && isIOAddress(0xFF00 + memoryMap.readByte(PC + 1))){
+            return 0;
+        }
+    }
+    else{
+        iterations = std::min(loopIterations(block->counterOpcode), cycleBudget / block->iterationCycles);
+    }
+    uint16_t const bulkIterations = iterations - 1;
+    if (block->superinstruction == Superinstruction::fill){
+        bool const increment = memoryMap.readByte(PC) == 0x22;
+        if (!increment && HL < bulkIterations){
+            return 0;
+        }
+        uint16_t const first = increment ? uint16_t(HL) : HL - bulkIterations; // Lowest address filled
+        if (!memoryMap.isPlainMemory(first, iterations, true) || overlaps(first, iterations, *block)){
+            return 0;
+        }
+        memoryMap.fillBlock(increment ? first : first + 1, A(), bulkIterations);
+        if (increment){
+            HL += bulkIterations;
+        }
+        else{
+            HL -= bulkIterations;
+        }
+    }
+    else if (block->superinstruction == Superinstruction::copy){
+        bool const fromHL = memoryMap.readByte(PC) == 0x2A;
+        uint16_t const source = fromHL ? HL : DE;
+        uint16_t const target = fromHL ? DE : HL;
+        if (!memoryMap.isPlainMemory(source, iterations, false) || !memoryMap.isPlainMemory(target, iterations, true) ||
+            overlaps(target, iterations, *block) || (source < target + iterations && target < source + iterations)){
+            return 0;
+        }
+        memoryMap.copyBlock(target, source, bulkIterations);
+        HL += bulkIterations;
+        DE += bulkIterations;
+    }
+    countDownLoop(block->counterOpcode, bulkIterations);
+    idleLoopRepeated = false;
+    uint32_t cycles = bulkIterations * block->iterationCycles;
+    for (auto const& decodedOpcode : block->opcodes){
+        PC += decodedOpcode.CBPrefixed ? 2 : 1;
+        cycles += decodedOpcode.handler(*this);
+    }
+    nextOpcodeIndex = block->opcodes.size();
+    return cycles;
+}
+
+// Iterations left in a loop counted down by counterOpcode (DEC r or DEC rr) - a counter of zero wraps, so runs the most
+uint32_t CPU::loopIterations(uint8_t counterOpcode){
+    switch(counterOpcode){
+    case 0x0B:
+        return BC != 0 ? uint32_t(BC) : 0x10000;
+    case 0x1B:
+        return DE != 0 ? uint32_t(DE) : 0x10000;
+    case 0x2B:
+        return HL != 0 ? uint32_t(HL) : 0x10000;
+    default: {
+        uint8_t const counter = registerByIndex(counterOpcode >> 3);
+        return counter != 0 ? counter : 0x100;
+    }
+    }
+}
+
+// Counts the loop down by the given number of iterations, without changing the flags
+void CPU::countDownLoop(uint8_t counterOpcode, uint16_t iterations){
+    switch(counterOpcode){
+    case 0x0B:
+        BC -= iterations;
+        break;
+    case 0x1B:
+        DE -= iterations;
+        break;
+    case 0x2B:
+        HL -= iterations;
+        break;
+    default:
+        registerByIndex(counterOpcode >> 3) -= iterations;
+        break;
+    }
+}
+
+// The register encoded by a 3-bit field of an opcode (B, C, D, E, H, L, (HL), A) - (HL) is not a register, so is not allowed
+HalfRegister& CPU::registerByIndex(uint8_t index){
+    switch(index & 0x07){
+    case 0: return B();
+    case 1: return C();
+    case 2: return D();
+    case 3: return E();
+    case 4: return H();
+    case 5: return L();
+    default: return A();
+    }
+}
+
+void CPU::enableBlockCache(bool enabled){
+    blockCacheEnabled = enabled;
+    currentBlock = nullptr;
+    blockCache.clear();
+}
+
+// Superinstructions are only run by the cached interpreter, within batches (see run)
+void CPU::enableSuperinstructions(bool enabled){
+    superinstructionsEnabled = enabled;
+}
+
+// Native blocks are found through the block cache, so the JIT engines re-enable it
+void CPU::setEngine(CPUEngine newEngine){
+    if (newEngine != CPUEngine::interpreter && !Dynarec::isAvailable()){
+        std::cout << "Dynarec is not supported on this platform, using the interpreter\n";
+        newEngine = CPUEngine::interpreter;
+    }
+    if (newEngine != CPUEngine::interpreter && traceWriter){
+        throw std::runtime_error("Trace files require the interpreter (--cpu=interp)");
+    }
+    engine = newEngine;
+    enableBlockCache(blockCacheEnabled || engine != CPUEngine::interpreter);
+}
+
+// Runs a block as native code, returning the total cycles taken by its instructions
+// Native code stops early before an instruction accessing an I/O register through a pointer, leaving PC there (and
+// returns 0 if that is the first instruction)
+uint16_t CPU::executeNativeBlock(DecodedBlock const& block){
+    resolveFlags(); // Native code reads and writes F directly
+    nativeOpcodesRun = block.opcodes.size();
+    uint16_t const cycles = engine == CPUEngine::differential ? verifyNativeBlock(block) : block.native(this);
+    // Instructions within the block are all traced at the cycle the block starts (only to the ring buffer, see startTraceFile)
+    for (std::size_t i = 0 ; i < nativeOpcodesRun ; ++i){
+        traceOpcode(block.opcodes[i].address, block.opcodes[i].opcode);
+    }
+    if (cycles != 0){
+        profiler.recordNativeBlock(cycles);
+    }
+    return cycles;
+}
+
+// Runs the same instructions on a copy of the machine using the (uncached) interpreter,
+// and throws if the resulting state or cycle count differs from that of the native code
+uint16_t CPU::verifyNativeBlock(DecodedBlock const& block){
+    if (!shadowCPU){
+        shadowMemoryMap = std::make_unique<MemoryMap>(memoryMap);
+        shadowCPU = std::make_unique<CPU>(*shadowMemoryMap);
+        shadowCPU->enableBlockCache(false);
+    }
+    CPUState initialState;
+    getState(initialState);
+    *shadowMemoryMap = memoryMap;
+    shadowCPU->setState(initialState);
+
+    uint16_t const cycles = block.native(this);
+    uint16_t expectedCycles = 0;
+    for (std::size_t i = 0 ; i < nativeOpcodesRun ; ++i){
+        expectedCycles += shadowCPU->executeNextOpcode();
+    }
+
+    CPUState state, expectedState;
+    getState(state);
+    shadowCPU->getState(expectedState);
+    if (!(state == expectedState) || cycles != expectedCycles){
+        std::cout << "Native block at 0x" << std::hex << std::setfill('0') << std::setw(4) << block.startAddress
+                  << " diverged from the interpreter\n";
+        std::cout << "\tNative: PC 0x" << std::setw(4) << uint16_t(state.PC) << " AF 0x" << std::setw(2) << +state.A << std::setw(2) << +state.F
+                  << " cycles " << std::dec << cycles << "\n";
+        std::cout << "\tInterpreter: PC 0x" << std::hex << std::setw(4) << uint16_t(expectedState.PC) << " AF 0x" << std::setw(2) << +expectedState.A
+                  << std::setw(2) << +expectedState.F << " cycles " << std::dec << expectedCycles << "\n";
+        throw std::runtime_error("Dynarec differential check failed");
+    }
+    return cycles;
+}
+
+// Dispatch tables hold one handler per opcode, generated at compile time from
+// the templated executeOpcode/executeCBOpcode below
+template <bool CBPrefixed, std::size_t... opcodes>
+constexpr CPU::OpcodeTable CPU::makeOpcodeTable(std::index_sequence<opcodes...>){
+    if constexpr (CBPrefixed){
+        return {&CPU::dispatchCBOpcode<uint8_t(opcodes)>...};
     }
     else{
-        uint8_t opcode = memoryMap.readByte(PC++);
-        addOpcodeToLog(opcode);
-        return executeOpcode(opcode);
+        return {&CPU::dispatchOpcode<uint8_t(opcodes)>...};
     }
 }
 
+template <uint8_t opcode>
+uint16_t CPU::dispatchOpcode(CPU& cpu){
+    return cpu.executeOpcode<opcode>();
+}
+
+template <uint8_t opcode>
+uint16_t CPU::dispatchCBOpcode(CPU& cpu){
+    return cpu.executeCBOpcode<opcode>();
+}
+
+CPU::OpcodeTable const constinit CPU::opcodeTable = makeOpcodeTable<false>(std::make_index_sequence<0x100>{});
+CPU::OpcodeTable const constinit CPU::opcodeCBTable = makeOpcodeTable<true>(std::make_index_sequence<0x100>{});
+
 uint16_t CPU::executeOpcode(uint8_t opcode){
+#ifdef GB_EMU_USE_COMPUTED_GOTO
+    // Jump straight into the inlined handler for this opcode
+    #pragma GCC diagnostic push
+    #pragma GCC diagnostic ignored "-Wpedantic"
+    static void* const dispatchLabels[0x100] = {GB_EMU_FOR_EACH_OPCODE(GB_EMU_OPCODE_LABEL_ADDRESS)};
+    goto *dispatchLabels[opcode];
+    GB_EMU_FOR_EACH_OPCODE(GB_EMU_OPCODE_LABEL)
+    #pragma GCC diagnostic pop
+#else
+    return opcodeTable[opcode](*this);
+#endif
+}
+
+uint16_t CPU::executeCBOpcode(uint8_t opcode){
+    return opcodeCBTable[opcode](*this);
+}
+
+// Opcode is a template parameter, so the switch below collapses to a single
+// case and each instantiation becomes a dedicated handler for the dispatch tables
+template <uint8_t opcode>
+uint16_t CPU::executeOpcode(){
     switch(opcode){
     case 0x00: return NOP();
     case 0x01: return LDrru16(BC);
-    case 0x02: return LDnnr(BC, A);
+    case 0x02: return LDnnr(BC, A());
     case 0x03: return INCrr(BC);
-    case 0x04: return INCr(B);
-    case 0x05: return DECr(B);
-    case 0x06: return LDru8(B);
+    case 0x04: return INCr(B());
+    case 0x05: return DECr(B());
+    case 0x06: return LDru8(B());
     case 0x07: return RLCA();
     case 0x08: return LDu16rr(SP);
     case 0x09: return ADDrrrr(HL, BC);
-    case 0x0A: return LDrnn(A, BC);
+    case 0x0A: return LDrnn(A(), BC);
     case 0x0B: return DECrr(BC);
-    case 0x0C: return INCr(C);
-    case 0x0D: return DECr(C);
-    case 0x0E: return LDru8(C);
+    case 0x0C: return INCr(C());
+    case 0x0D: return DECr(C());
+    case 0x0E: return LDru8(C());
     case 0x0F: return RRCA();
     case 0x10: return STOP();
     case 0x11: return LDrru16(DE);
-    case 0x12: return LDnnr(DE, A);
+    case 0x12: return LDnnr(DE, A());
     case 0x13: return INCrr(DE);
-    case 0x14: return INCr(D);
-    case 0x15: return DECr(D);
-    case 0x16: return LDru8(D);
+    case 0x14: return INCr(D());
+    case 0x15: return DECr(D());
+    case 0x16: return LDru8(D());
     case 0x17: return RLA();
     case 0x18: return JRe();
     case 0x19: return ADDrrrr(HL, DE);
-    case 0x1A: return LDrnn(A, DE);
+    case 0x1A: return LDrnn(A(), DE);
     case 0x1B: return DECrr(DE);
-    case 0x1C: return INCr(E);
-    case 0x1D: return DECr(E);
-    case 0x1E: return LDru8(E);
+    case 0x1C: return INCr(E());
+    case 0x1D: return DECr(E());
+    case 0x1E: return LDru8(E());
     case 0x1F: return RRA();
     case 0x20: return JRcce(FLAG_ZERO, false);
     case 0x21: return LDrru16(HL);
-    case 0x22: return LDnnr(HL++, A);
+    case 0x22: return LDnnr(HL++, A());
     case 0x23: return INCrr(HL);
-    case 0x24: return INCr(H);
-    case 0x25: return DECr(H);
-    case 0x26: return LDru8(H);
+    case 0x24: return INCr(H());
+    case 0x25: return DECr(H());
+    case 0x26: return LDru8(H());
     case 0x27: return DAA();
     case 0x28: return JRcce(FLAG_ZERO, true);
     case 0x29: return ADDrrrr(HL, HL);
-    case 0x2A: return LDrnn(A, HL++);
+    case 0x2A: return LDrnn(A(), HL++);
     case 0x2B: return DECrr(HL);
-    case 0x2C: return INCr(L);
-    case 0x2D: return DECr(L);
-    case 0x2E: return LDru8(L);
+    case 0x2C: return INCr(L());
+    case 0x2D: return DECr(L());
+    case 0x2E: return LDru8(L());
     case 0x2F: return CPL();
     case 0x30: return JRcce(FLAG_CARRY, false);
     case 0x31: return LDrru16(SP);
-    case 0x32: return LDnnr(HL--, A);
+    case 0x32: return LDnnr(HL--, A());
     case 0x33: return INCrr(SP);
     case 0x34: return INCnn(HL);
     case 0x35: return DECnn(HL);
@@ -709,147 +802,147 @@ uint16_t CPU::executeOpcode(uint8_t opcode){
     case 0x37: return SCF();
     case 0x38: return JRcce(FLAG_CARRY, true);
     case 0x39: return ADDrrrr(HL, SP);
-    case 0x3A: return LDrnn(A, HL--);
+    case 0x3A: return LDrnn(A(), HL--);
     case 0x3B: return DECrr(SP);
-    case 0x3C: return INCr(A);
-    case 0x3D: return DECr(A);
-    case 0x3E: return LDru8(A);
+    case 0x3C: return INCr(A());
+    case 0x3D: return DECr(A());
+    case 0x3E: return LDru8(A());
     case 0x3F: return CCF();
-    case 0x40: return LDrr(B, B);
-    case 0x41: return LDrr(B, C);
-    case 0x42: return LDrr(B, D);
-    case 0x43: return LDrr(B, E);
-    case 0x44: return LDrr(B, H);
-    case 0x45: return LDrr(B, L);
-    case 0x46: return LDrnn(B, HL);
-    case 0x47: return LDrr(B, A);
-    case 0x48: return LDrr(C, B);
-    case 0x49: return LDrr(C, C);
-    case 0x4A: return LDrr(C, D);
-    case 0x4B: return LDrr(C, E);
-    case 0x4C: return LDrr(C, H);
-    case 0x4D: return LDrr(C, L);
-    case 0x4E: return LDrnn(C, HL);
-    case 0x4F: return LDrr(C, A);
-    case 0x50: return LDrr(D, B);
-    case 0x51: return LDrr(D, C);
-    case 0x52: return LDrr(D, D);
-    case 0x53: return LDrr(D, E);
-    case 0x54: return LDrr(D, H);
-    case 0x55: return LDrr(D, L);
-    case 0x56: return LDrnn(D, HL);
-    case 0x57: return LDrr(D, A);
-    case 0x58: return LDrr(E, B);
-    case 0x59: return LDrr(E, C);
-    case 0x5A: return LDrr(E, D);
-    case 0x5B: return LDrr(E, E);
-    case 0x5C: return LDrr(E, H);
-    case 0x5D: return LDrr(E, L);
-    case 0x5E: return LDrnn(E, HL);
-    case 0x5F: return LDrr(E, A);
-    case 0x60: return LDrr(H, B);
-    case 0x61: return LDrr(H, C);
-    case 0x62: return LDrr(H, D);
-    case 0x63: return LDrr(H, E);
-    case 0x64: return LDrr(H, H);
-    case 0x65: return LDrr(H, L);
-    case 0x66: return LDrnn(H, HL);
-    case 0x67: return LDrr(H, A);
-    case 0x68: return LDrr(L, B);
-    case 0x69: return LDrr(L, C);
-    case 0x6A: return LDrr(L, D);
-    case 0x6B: return LDrr(L, E);
-    case 0x6C: return LDrr(L, H);
-    case 0x6D: return LDrr(L, L);
-    case 0x6E: return LDrnn(L, HL);
-    case 0x6F: return LDrr(L, A);
-    case 0x70: return LDnnr(HL, B);
-    case 0x71: return LDnnr(HL, C);
-    case 0x72: return LDnnr(HL, D);
-    case 0x73: return LDnnr(HL, E);
-    case 0x74: return LDnnr(HL, H);
-    case 0x75: return LDnnr(HL, L);
+    case 0x40: return LDrr(B(), B());
+    case 0x41: return LDrr(B(), C());
+    case 0x42: return LDrr(B(), D());
+    case 0x43: return LDrr(B(), E());
+    case 0x44: return LDrr(B(), H());
+    case 0x45: return LDrr(B(), L());
+    case 0x46: return LDrnn(B(), HL);
+    case 0x47: return LDrr(B(), A());
+    case 0x48: return LDrr(C(), B());
+    case 0x49: return LDrr(C(), C());
+    case 0x4A: return LDrr(C(), D());
+    case 0x4B: return LDrr(C(), E());
+    case 0x4C: return LDrr(C(), H());
+    case 0x4D: return LDrr(C(), L());
+    case 0x4E: return LDrnn(C(), HL);
+    case 0x4F: return LDrr(C(), A());
+    case 0x50: return LDrr(D(), B());
+    case 0x51: return LDrr(D(), C());
+    case 0x52: return LDrr(D(), D());
+    case 0x53: return LDrr(D(), E());
+    case 0x54: return LDrr(D(), H());
+    case 0x55: return LDrr(D(), L());
+    case 0x56: return LDrnn(D(), HL);
+    case 0x57: return LDrr(D(), A());
+    case 0x58: return LDrr(E(), B());
+    case 0x59: return LDrr(E(), C());
+    case 0x5A: return LDrr(E(), D());
+    case 0x5B: return LDrr(E(), E());
+    case 0x5C: return LDrr(E(), H());
+    case 0x5D: return LDrr(E(), L());
+    case 0x5E: return LDrnn(E(), HL);
+    case 0x5F: return LDrr(E(), A());
+    case 0x60: return LDrr(H(), B());
+    case 0x61: return LDrr(H(), C());
+    case 0x62: return LDrr(H(), D());
+    case 0x63: return LDrr(H(), E());
+    case 0x64: return LDrr(H(), H());
+    case 0x65: return LDrr(H(), L());
+    case 0x66: return LDrnn(H(), HL);
+    case 0x67: return LDrr(H(), A());
+    case 0x68: return LDrr(L(), B());
+    case 0x69: return LDrr(L(), C());
+    case 0x6A: return LDrr(L(), D());
+    case 0x6B: return LDrr(L(), E());
+    case 0x6C: return LDrr(L(), H());
+    case 0x6D: return LDrr(L(), L());
+    case 0x6E: return LDrnn(L(), HL);
+    case 0x6F: return LDrr(L(), A());
+    case 0x70: return LDnnr(HL, B());
+    case 0x71: return LDnnr(HL, C());
+    case 0x72: return LDnnr(HL, D());
+    case 0x73: return LDnnr(HL, E());
+    case 0x74: return LDnnr(HL, H());
+    case 0x75: return LDnnr(HL, L());
     case 0x76: return HALT();
-    case 0x77: return LDnnr(HL, A);
-    case 0x78: return LDrr(A, B);
-    case 0x79: return LDrr(A, C);
-    case 0x7A: return LDrr(A, D);
-    case 0x7B: return LDrr(A, E);
-    case 0x7C: return LDrr(A, H);
-    case 0x7D: return LDrr(A, L);
-    case 0x7E: return LDrnn(A, HL);
-    case 0x7F: return LDrr(A, A);
-    case 0x80: return ADDrr(A, B);
-    case 0x81: return ADDrr(A, C);
-    case 0x82: return ADDrr(A, D);
-    case 0x83: return ADDrr(A, E);
-    case 0x84: return ADDrr(A, H);
-    case 0x85: return ADDrr(A, L);
-    case 0x86: return ADDrnn(A, HL);
-    case 0x87: return ADDrr(A, A);
-    case 0x88: return ADCAr(B);
-    case 0x89: return ADCAr(C);
-    case 0x8A: return ADCAr(D);
-    case 0x8B: return ADCAr(E);
-    case 0x8C: return ADCAr(H);
-    case 0x8D: return ADCAr(L);
+    case 0x77: return LDnnr(HL, A());
+    case 0x78: return LDrr(A(), B());
+    case 0x79: return LDrr(A(), C());
+    case 0x7A: return LDrr(A(), D());
+    case 0x7B: return LDrr(A(), E());
+    case 0x7C: return LDrr(A(), H());
+    case 0x7D: return LDrr(A(), L());
+    case 0x7E: return LDrnn(A(), HL);
+    case 0x7F: return LDrr(A(), A());
+    case 0x80: return ADDrr(A(), B());
+    case 0x81: return ADDrr(A(), C());
+    case 0x82: return ADDrr(A(), D());
+    case 0x83: return ADDrr(A(), E());
+    case 0x84: return ADDrr(A(), H());
+    case 0x85: return ADDrr(A(), L());
+    case 0x86: return ADDrnn(A(), HL);
+    case 0x87: return ADDrr(A(), A());
+    case 0x88: return ADCAr(B());
+    case 0x89: return ADCAr(C());
+    case 0x8A: return ADCAr(D());
+    case 0x8B: return ADCAr(E());
+    case 0x8C: return ADCAr(H());
+    case 0x8D: return ADCAr(L());
     case 0x8E: return ADCAHL();
-    case 0x8F: return ADCAr(A); 
-    case 0x90: return SUBrr(A, B);
-    case 0x91: return SUBrr(A, C);
-    case 0x92: return SUBrr(A, D);
-    case 0x93: return SUBrr(A, E);
-    case 0x94: return SUBrr(A, H);
-    case 0x95: return SUBrr(A, L);
-    case 0x96: return SUBrnn(A, HL);
-    case 0x97: return SUBrr(A, A); 
-    case 0x98: return SBCAr(B);
-    case 0x99: return SBCAr(C);
-    case 0x9A: return SBCAr(D);
-    case 0x9B: return SBCAr(E);
-    case 0x9C: return SBCAr(H);
-    case 0x9D: return SBCAr(L);
+    case 0x8F: return ADCAr(A()); 
+    case 0x90: return SUBrr(A(), B());
+    case 0x91: return SUBrr(A(), C());
+    case 0x92: return SUBrr(A(), D());
+    case 0x93: return SUBrr(A(), E());
+    case 0x94: return SUBrr(A(), H());
+    case 0x95: return SUBrr(A(), L());
+    case 0x96: return SUBrnn(A(), HL);
+    case 0x97: return SUBrr(A(), A()); 
+    case 0x98: return SBCAr(B());
+    case 0x99: return SBCAr(C());
+    case 0x9A: return SBCAr(D());
+    case 0x9B: return SBCAr(E());
+    case 0x9C: return SBCAr(H());
+    case 0x9D: return SBCAr(L());
     case 0x9E: return SBCAHL();
-    case 0x9F: return SBCAr(A); 
-    case 0xA0: return ANDAr(B);
-    case 0xA1: return ANDAr(C);
-    case 0xA2: return ANDAr(D);
-    case 0xA3: return ANDAr(E);
-    case 0xA4: return ANDAr(H);
-    case 0xA5: return ANDAr(L);
+    case 0x9F: return SBCAr(A()); 
+    case 0xA0: return ANDAr(B());
+    case 0xA1: return ANDAr(C());
+    case 0xA2: return ANDAr(D());
+    case 0xA3: return ANDAr(E());
+    case 0xA4: return ANDAr(H());
+    case 0xA5: return ANDAr(L());
     case 0xA6: return ANDAnn(HL);
-    case 0xA7: return ANDAr(A); 
-    case 0xA8: return XORAr(B);
-    case 0xA9: return XORAr(C);
-    case 0xAA: return XORAr(D);
-    case 0xAB: return XORAr(E);
-    case 0xAC: return XORAr(H);
-    case 0xAD: return XORAr(L);
+    case 0xA7: return ANDAr(A()); 
+    case 0xA8: return XORAr(B());
+    case 0xA9: return XORAr(C());
+    case 0xAA: return XORAr(D());
+    case 0xAB: return XORAr(E());
+    case 0xAC: return XORAr(H());
+    case 0xAD: return XORAr(L());
     case 0xAE: return XORAnn(HL);
-    case 0xAF: return XORAr(A);
-    case 0xB0: return ORAr(B);
-    case 0xB1: return ORAr(C);
-    case 0xB2: return ORAr(D);
-    case 0xB3: return ORAr(E);
-    case 0xB4: return ORAr(H);
-    case 0xB5: return ORAr(L);
+    case 0xAF: return XORAr(A());
+    case 0xB0: return ORAr(B());
+    case 0xB1: return ORAr(C());
+    case 0xB2: return ORAr(D());
+    case 0xB3: return ORAr(E());
+    case 0xB4: return ORAr(H());
+    case 0xB5: return ORAr(L());
     case 0xB6: return ORAnn(HL);
-    case 0xB7: return ORAr(A);
-    case 0xB8: return CPrr(A, B);
-    case 0xB9: return CPrr(A, C);
-    case 0xBA: return CPrr(A, D);
-    case 0xBB: return CPrr(A, E);
-    case 0xBC: return CPrr(A, H);
-    case 0xBD: return CPrr(A, L);
-    case 0xBE: return CPrnn(A, HL);
-    case 0xBF: return CPrr(A, A);
+    case 0xB7: return ORAr(A());
+    case 0xB8: return CPrr(A(), B());
+    case 0xB9: return CPrr(A(), C());
+    case 0xBA: return CPrr(A(), D());
+    case 0xBB: return CPrr(A(), E());
+    case 0xBC: return CPrr(A(), H());
+    case 0xBD: return CPrr(A(), L());
+    case 0xBE: return CPrnn(A(), HL);
+    case 0xBF: return CPrr(A(), A());
     case 0xC0: return RETcc(FLAG_ZERO, false);
     case 0xC1: return POPrr(BC);
     case 0xC2: return JPccu16(FLAG_ZERO, false);
     case 0xC3: return JPu16();
     case 0xC4: return CALLccu16(FLAG_ZERO, false);
     case 0xC5: return PUSHrr(BC);
-    case 0xC6: return ADDru8(A);
+    case 0xC6: return ADDru8(A());
     case 0xC7: return RST(0x00);
     case 0xC8: return RETcc(FLAG_ZERO, true);
     case 0xC9: return RET();
@@ -865,7 +958,7 @@ uint16_t CPU::executeOpcode(uint8_t opcode){
     // No 0xD3 opcode
     case 0xD4: return CALLccu16(FLAG_CARRY, false);
     case 0xD5: return PUSHrr(DE);
-    case 0xD6: return SUBru8(A);
+    case 0xD6: return SUBru8(A());
     case 0xD7: return RST(0x10);
     case 0xD8: return RETcc(FLAG_CARRY, true);
     case 0xD9: return RETI();
@@ -875,9 +968,9 @@ uint16_t CPU::executeOpcode(uint8_t opcode){
     // No 0xDD opcode
     case 0xDE: return SBCAu8();
     case 0xDF: return RST(0x18);
-    case 0xE0: return LDFFu8r(A);
+    case 0xE0: return LDFFu8r(A());
     case 0xE1: return POPrr(HL);
-    case 0xE2: return LDnnr(0xFF00 + C, A);
+    case 0xE2: return LDnnr(0xFF00 + C(), A());
     // No 0xE3 opcode
     // No 0xE4 opcode
     case 0xE5: return PUSHrr(HL);
@@ -885,15 +978,15 @@ uint16_t CPU::executeOpcode(uint8_t opcode){
     case 0xE7: return RST(0x20);
     case 0xE8: return ADDSPi8();
     case 0xE9: return JPnn(HL);
-    case 0xEA: return LDu16r(A);
+    case 0xEA: return LDu16r(A());
     // No 0xEB opcode
     // No 0xEC opcode
     // No 0xED opcode
     case 0xEE: return XORAu8();
     case 0xEF: return RST(0x28);
-    case 0xF0: return LDrFFu8(A);
+    case 0xF0: return LDrFFu8(A());
     case 0xF1: return POPAF();
-    case 0xF2: return LDrnn(A, 0xFF00 + C);
+    case 0xF2: return LDrnn(A(), 0xFF00 + C());
     case 0xF3: return DI();
     // No 0xF4 opcode
     case 0xF5: return PUSHAF();
@@ -901,285 +994,123 @@ uint16_t CPU::executeOpcode(uint8_t opcode){
     case 0xF7: return RST(0x30);
     case 0xF8: return LDHLSPi8();
     case 0xF9: return LDrrrr(SP, HL);
-    case 0xFA: return LDru16(A);
+    case 0xFA: return LDru16(A());
     case 0xFB: return EI();
     // No 0xFC opcode
     // No 0xFD opcode
-    case 0xFE: return CPru8(A);
+    case 0xFE: return CPru8(A());
     case 0xFF: return RST(0x38);
     default:     
-        printRecentOpcodes();   
         std::cout << "unimplemented!\n";
         std::cout << "PC at exit: 0x" << std::hex << PC << "\n";
         throw std::runtime_error("Encountered unimplemented opcode");
     }    
 }
 
-uint16_t CPU::executeCBOpcode(uint8_t opcode){
-    addOpcodeToLog(opcode);
-    switch(opcode){
-    case 0x00: return RLCr(B);
-    case 0x01: return RLCr(C);
-    case 0x02: return RLCr(D);
-    case 0x03: return RLCr(E);
-    case 0x04: return RLCr(H);
-    case 0x05: return RLCr(L);
-    case 0x06: return RLCHL();
-    case 0x07: return RLCr(A);
-    case 0x08: return RRCr(B);
-    case 0x09: return RRCr(C);
-    case 0x0A: return RRCr(D);
-    case 0x0B: return RRCr(E);
-    case 0x0C: return RRCr(H);
-    case 0x0D: return RRCr(L);
-    case 0x0E: return RRCHL();
-    case 0x0F: return RRCr(A);
-    case 0x10: return RLr(B);
-    case 0x11: return RLr(C);
-    case 0x12: return RLr(D);
-    case 0x13: return RLr(E);
-    case 0x14: return RLr(H);
-    case 0x15: return RLr(L);
-    case 0x16: return RLHL();
-    case 0x17: return RLr(A);
-    case 0x18: return RRr(B);
-    case 0x19: return RRr(C);
-    case 0x1A: return RRr(D);
-    case 0x1B: return RRr(E);
-    case 0x1C: return RRr(H);
-    case 0x1D: return RRr(L);
-    case 0x1E: return RRHL();
-    case 0x1F: return RRr(A);
-    case 0x20: return SLAr(B);
-    case 0x21: return SLAr(C);
-    case 0x22: return SLAr(D);
-    case 0x23: return SLAr(E);
-    case 0x24: return SLAr(H);
-    case 0x25: return SLAr(L);
-    case 0x26: return SLAHL();
-    case 0x27: return SLAr(A);
-    case 0x28: return SRAr(B);
-    case 0x29: return SRAr(C);
-    case 0x2A: return SRAr(D);
-    case 0x2B: return SRAr(E);
-    case 0x2C: return SRAr(H);
-    case 0x2D: return SRAr(L);
-    case 0x2E: return SRAHL();
-    case 0x2F: return SRAr(A);
-    case 0x30: return SWAPr(B);
-    case 0x31: return SWAPr(C);
-    case 0x32: return SWAPr(D);
-    case 0x33: return SWAPr(E);
-    case 0x34: return SWAPr(H);
-    case 0x35: return SWAPr(L);
-    case 0x36: return SWAPHL();
-    case 0x37: return SWAPr(A);
-    case 0x38: return SRLr(B);
-    case 0x39: return SRLr(C);
-    case 0x3A: return SRLr(D);
-    case 0x3B: return SRLr(E);
-    case 0x3C: return SRLr(H);
-    case 0x3D: return SRLr(L);
-    case 0x3E: return SRLHL();
-    case 0x3F: return SRLr(A);
-    case 0x40: return BITbr(0, B);
-    case 0x41: return BITbr(0, C);
-    case 0x42: return BITbr(0, D);
-    case 0x43: return BITbr(0, E);
-    case 0x44: return BITbr(0, H);
-    case 0x45: return BITbr(0, L);
-    case 0x46: return BITbnn(0, HL);
-    case 0x47: return BITbr(0, A);
-    case 0x48: return BITbr(1, B);
-    case 0x49: return BITbr(1, C);
-    case 0x4A: return BITbr(1, D);
-    case 0x4B: return BITbr(1, E);
-    case 0x4C: return BITbr(1, H);
-    case 0x4D: return BITbr(1, L);
-    case 0x4E: return BITbnn(1, HL);
-    case 0x4F: return BITbr(1, A);
-    case 0x50: return BITbr(2, B);
-    case 0x51: return BITbr(2, C);
-    case 0x52: return BITbr(2, D);
-    case 0x53: return BITbr(2, E);
-    case 0x54: return BITbr(2, H);
-    case 0x55: return BITbr(2, L);
-    case 0x56: return BITbnn(2, HL);
-    case 0x57: return BITbr(2, A);
-    case 0x58: return BITbr(3, B);
-    case 0x59: return BITbr(3, C);
-    case 0x5A: return BITbr(3, D);
-    case 0x5B: return BITbr(3, E);
-    case 0x5C: return BITbr(3, H);
-    case 0x5D: return BITbr(3, L);
-    case 0x5E: return BITbnn(3, HL);
-    case 0x5F: return BITbr(3, A);
-    case 0x60: return BITbr(4, B);
-    case 0x61: return BITbr(4, C);
-    case 0x62: return BITbr(4, D);
-    case 0x63: return BITbr(4, E);
-    case 0x64: return BITbr(4, H);
-    case 0x65: return BITbr(4, L);
-    case 0x66: return BITbnn(4, HL);
-    case 0x67: return BITbr(4, A);
-    case 0x68: return BITbr(5, B);
-    case 0x69: return BITbr(5, C);
-    case 0x6A: return BITbr(5, D);
-    case 0x6B: return BITbr(5, E);
-    case 0x6C: return BITbr(5, H);
-    case 0x6D: return BITbr(5, L);
-    case 0x6E: return BITbnn(5, HL);
-    case 0x6F: return BITbr(5, A);
-    case 0x70: return BITbr(6, B);
-    case 0x71: return BITbr(6, C);
-    case 0x72: return BITbr(6, D);
-    case 0x73: return BITbr(6, E);
-    case 0x74: return BITbr(6, H);
-    case 0x75: return BITbr(6, L);
-    case 0x76: return BITbnn(6, HL);
-    case 0x77: return BITbr(6, A);
-    case 0x78: return BITbr(7, B);
-    case 0x79: return BITbr(7, C);
-    case 0x7A: return BITbr(7, D);
-    case 0x7B: return BITbr(7, E);
-    case 0x7C: return BITbr(7, H);
-    case 0x7D: return BITbr(7, L);
-    case 0x7E: return BITbnn(7, HL);
-    case 0x7F: return BITbr(7, A);
-    case 0x80: return RESbr(0,B);
-    case 0x81: return RESbr(0,C);
-    case 0x82: return RESbr(0,D);
-    case 0x83: return RESbr(0,E);
-    case 0x84: return RESbr(0,H);
-    case 0x85: return RESbr(0,L);
-    case 0x86: return RESbnn(0,HL);
-    case 0x87: return RESbr(0,A);
-    case 0x88: return RESbr(1,B);
-    case 0x89: return RESbr(1,C);
-    case 0x8A: return RESbr(1,D);
-    case 0x8B: return RESbr(1,E);
-    case 0x8C: return RESbr(1,H);
-    case 0x8D: return RESbr(1,L);
-    case 0x8E: return RESbnn(1,HL);
-    case 0x8F: return RESbr(1,A);
-    case 0x90: return RESbr(2,B);
-    case 0x91: return RESbr(2,C);
-    case 0x92: return RESbr(2,D);
-    case 0x93: return RESbr(2,E);
-    case 0x94: return RESbr(2,H);
-    case 0x95: return RESbr(2,L);
-    case 0x96: return RESbnn(2,HL);
-    case 0x97: return RESbr(2,A);
-    case 0x98: return RESbr(3,B);
-    case 0x99: return RESbr(3,C);
-    case 0x9A: return RESbr(3,D);
-    case 0x9B: return RESbr(3,E);
-    case 0x9C: return RESbr(3,H);
-    case 0x9D: return RESbr(3,L);
-    case 0x9E: return RESbnn(3,HL);
-    case 0x9F: return RESbr(3,A);
-    case 0xA0: return RESbr(4,B);
-    case 0xA1: return RESbr(4,C);
-    case 0xA2: return RESbr(4,D);
-    case 0xA3: return RESbr(4,E);
-    case 0xA4: return RESbr(4,H);
-    case 0xA5: return RESbr(4,L);
-    case 0xA6: return RESbnn(4,HL);
-    case 0xA7: return RESbr(4,A);
-    case 0xA8: return RESbr(5,B);
-    case 0xA9: return RESbr(5,C);
-    case 0xAA: return RESbr(5,D);
-    case 0xAB: return RESbr(5,E);
-    case 0xAC: return RESbr(5,H);
-    case 0xAD: return RESbr(5,L);
-    case 0xAE: return RESbnn(5,HL);
-    case 0xAF: return RESbr(5,A);
-    case 0xB0: return RESbr(6,B);
-    case 0xB1: return RESbr(6,C);
-    case 0xB2: return RESbr(6,D);
-    case 0xB3: return RESbr(6,E);
-    case 0xB4: return RESbr(6,H);
-    case 0xB5: return RESbr(6,L);
-    case 0xB6: return RESbnn(6,HL);
-    case 0xB7: return RESbr(6,A);
-    case 0xB8: return RESbr(7,B);
-    case 0xB9: return RESbr(7,C);
-    case 0xBA: return RESbr(7,D);
-    case 0xBB: return RESbr(7,E);
-    case 0xBC: return RESbr(7,H);
-    case 0xBD: return RESbr(7,L);
-    case 0xBE: return RESbnn(7,HL);
-    case 0xBF: return RESbr(7,A);
-    case 0xC0: return SETbr(0,B);
-    case 0xC1: return SETbr(0,C);
-    case 0xC2: return SETbr(0,D);
-    case 0xC3: return SETbr(0,E);
-    case 0xC4: return SETbr(0,H);
-    case 0xC5: return SETbr(0,L);
-    case 0xC6: return SETbnn(0,HL);
-    case 0xC7: return SETbr(0,A);
-    case 0xC8: return SETbr(1,B);
-    case 0xC9: return SETbr(1,C);
-    case 0xCA: return SETbr(1,D);
-    case 0xCB: return SETbr(1,E);
-    case 0xCC: return SETbr(1,H);
-    case 0xCD: return SETbr(1,L);
-    case 0xCE: return SETbnn(1,HL);
-    case 0xCF: return SETbr(1,A);
-    case 0xD0: return SETbr(2,B);
-    case 0xD1: return SETbr(2,C);
-    case 0xD2: return SETbr(2,D);
-    case 0xD3: return SETbr(2,E);
-    case 0xD4: return SETbr(2,H);
-    case 0xD5: return SETbr(2,L);
-    case 0xD6: return SETbnn(2,HL);
-    case 0xD7: return SETbr(2,A);
-    case 0xD8: return SETbr(3,B);
-    case 0xD9: return SETbr(3,C);
-    case 0xDA: return SETbr(3,D);
-    case 0xDB: return SETbr(3,E);
-    case 0xDC: return SETbr(3,H);
-    case 0xDD: return SETbr(3,L);
-    case 0xDE: return SETbnn(3,HL);
-    case 0xDF: return SETbr(3,A);
-    case 0xE0: return SETbr(4,B);
-    case 0xE1: return SETbr(4,C);
-    case 0xE2: return SETbr(4,D);
-    case 0xE3: return SETbr(4,E);
-    case 0xE4: return SETbr(4,H);
-    case 0xE5: return SETbr(4,L);
-    case 0xE6: return SETbnn(4,HL);
-    case 0xE7: return SETbr(4,A);
-    case 0xE8: return SETbr(5,B);
-    case 0xE9: return SETbr(5,C);
-    case 0xEA: return SETbr(5,D);
-    case 0xEB: return SETbr(5,E);
-    case 0xEC: return SETbr(5,H);
-    case 0xED: return SETbr(5,L);
-    case 0xEE: return SETbnn(5,HL);
-    case 0xEF: return SETbr(5,A);
-    case 0xF0: return SETbr(6,B);
-    case 0xF1: return SETbr(6,C);
-    case 0xF2: return SETbr(6,D);
-    case 0xF3: return SETbr(6,E);
-    case 0xF4: return SETbr(6,H);
-    case 0xF5: return SETbr(6,L);
-    case 0xF6: return SETbnn(6,HL);
-    case 0xF7: return SETbr(6,A);
-    case 0xF8: return SETbr(7,B);
-    case 0xF9: return SETbr(7,C);
-    case 0xFA: return SETbr(7,D);
-    case 0xFB: return SETbr(7,E);
-    case 0xFC: return SETbr(7,H);
-    case 0xFD: return SETbr(7,L);
-    case 0xFE: return SETbnn(7,HL);
-    case 0xFF: return SETbr(7,A);
-    default:
-        printRecentOpcodes();
-        std::cout << "unimplemented!\n";
-        std::cout << "PC at exit: 0x" << std::hex << PC << "\n";
-        throw std::runtime_error("Encountered unimplemented CB opcode");
-    }  
+// CB-prefixed opcodes are regular, so each handler is generated from the fields of its opcode: bits 0-2 select
+// the operand (B, C, D, E, H, L, (HL) or A), bits 3-5 the bit or the rotate/shift operation, and bits 6-7 the
+// group (rotate/shift, BIT, RES or SET)
+template <uint8_t operand>
+HalfRegister& CPU::registerCB(){
+    static_assert(operand < 8 && operand != 0x06, "Not a register operand");
+    if constexpr (operand == 0x00) return B();
+    else if constexpr (operand == 0x01) return C();
+    else if constexpr (operand == 0x02) return D();
+    else if constexpr (operand == 0x03) return E();
+    else if constexpr (operand == 0x04) return H();
+    else if constexpr (operand == 0x05) return L();
+    else return A();
+}
+
+// RLC, RRC, RL, RR, SLA, SRA, SWAP or SRL - all four flags are set
+template <uint8_t operation>
+uint8_t CPU::shiftCB(uint8_t value){
+    uint8_t result;
+    bool carry;
+    if constexpr (operation == 0){ // RLC
+        result = (value << 1) | (value >> 7);
+        carry = value & 0x80;
+    }
+    else if constexpr (operation == 1){ // RRC
+        result = (value >> 1) | (value << 7);
+        carry = value & 0x01;
+    }
+    else if constexpr (operation == 2){ // RL
+        result = (value << 1) | (isFlagSet(FLAG_CARRY) ? 0x01 : 0x00);
+        carry = value & 0x80;
+    }
+    else if constexpr (operation == 3){ // RR
+        result = (value >> 1) | (isFlagSet(FLAG_CARRY) ? 0x80 : 0x00);
+        carry = value & 0x01;
+    }
+    else if constexpr (operation == 4){ // SLA
+        result = value << 1;
+        carry = value & 0x80;
+    }
+    else if constexpr (operation == 5){ // SRA
+        result = (value >> 1) | (value & 0x80);
+        carry = value & 0x01;
+    }
+    else if constexpr (operation == 6){ // SWAP
+        result = (value << 4) | (value >> 4);
+        carry = false;
+    }
+    else{ // SRL
+        result = value >> 1;
+        carry = value & 0x01;
+    }
+    F() = (result == 0x00 ? FLAG_ZERO : 0x00) | (carry ? FLAG_CARRY : 0x00);
+    discardPendingFlags();
+    return result;
+}
+
+// BIT - the carry flag is unchanged
+template <uint8_t bit>
+void CPU::testBitCB(uint8_t value){
+    resolveFlags();
+    F() = (F() & FLAG_CARRY) | FLAG_HALFCARRY | ((value >> bit) & 0x01 ? 0x00 : FLAG_ZERO);
+    discardPendingFlags();
+}
+
+// Rotate/shift, RES or SET
+template <uint8_t group, uint8_t bit>
+uint8_t CPU::operateCB(uint8_t value){
+    if constexpr (group == 0){
+        return shiftCB<bit>(value);
+    }
+    else if constexpr (group == 2){
+        return value & ~(0x01 << bit);
+    }
+    else{
+        static_assert(group == 3, "BIT does not write its operand");
+        return value | (0x01 << bit);
+    }
+}
+
+template <uint8_t opcode>
+uint16_t CPU::executeCBOpcode(){
+    constexpr uint8_t operand = opcode & 0x07;
+    constexpr uint8_t bit = (opcode >> 3) & 0x07;
+    constexpr uint8_t group = opcode >> 6;
+    if constexpr (operand == 0x06){
+        uint8_t const value = memoryMap.readByte(HL);
+        if constexpr (group == 1){
+            testBitCB<bit>(value);
+        }
+        else{
+            memoryMap.writeByte(HL, operateCB<group, bit>(value));
+        }
+    }
+    else{
+        HalfRegister& reg = registerCB<operand>();
+        if constexpr (group == 1){
+            testBitCB<bit>(reg);
+        }
+        else{
+            reg = operateCB<group, bit>(reg);
+        }
+    }
+    return OPCODE_CB_INFO[opcode].cycles;
 }
 
 // NOP (0x00)
@@ -1217,23 +1148,23 @@ uint16_t CPU::HALT(){
 uint16_t CPU::DAA(){
     if (isFlagSet(FLAG_SUBTRACT)){
         if (isFlagSet(FLAG_CARRY)){
-            A -= 0x60;
+            A() -= 0x60;
         }
         if (isFlagSet(FLAG_HALFCARRY)){
-            A -= 0x6;
+            A() -= 0x6;
         }
     }
     else{
-        if (isFlagSet(FLAG_CARRY) || A > 0x99){
-            A += 0x60;
+        if (isFlagSet(FLAG_CARRY) || A() > 0x99){
+            A() += 0x60;
             setFlag(FLAG_CARRY);
         }
-        if (isFlagSet(FLAG_HALFCARRY) || (A & 0x0F) > 0x9){
-            A += 0x6;
+        if (isFlagSet(FLAG_HALFCARRY) || (A() & 0x0F) > 0x9){
+            A() += 0x6;
         }
     }
 
-    setFlag(FLAG_ZERO, A == 0);
+    setFlag(FLAG_ZERO, A() == 0);
     clearFlag(FLAG_HALFCARRY);
     return 4;
 }
@@ -1322,7 +1253,8 @@ uint16_t CPU::POPrr(Register& targetReg){
 
 uint16_t CPU::POPAF(){
     POPrr(AF);
-    F &= 0xF0; // Non-flag bits in F must remain zero
+    discardPendingFlags();
+    F() &= 0xF0; // Non-flag bits in F must remain zero
     return 12;
 }
 
@@ -1333,6 +1265,7 @@ uint16_t CPU::PUSHrr(Register& dataReg){
 }
 
 uint16_t CPU::PUSHAF(){
+    resolveFlags();
     SP -= 2;
     memoryMap.writeWord(SP, AF);
     return 16;
@@ -1341,17 +1274,21 @@ uint16_t CPU::PUSHAF(){
 // XORAr (0xA8 - 0xAD, 0xAF)
 // XORs A with given half register and stores result in A
 uint16_t CPU::XORAr(HalfRegister reg){
-    A ^= reg;
-    setFlag(FLAG_ZERO, A == 0);
+    A() ^= reg;
+#ifdef GB_EMU_LAZY_FLAGS
+    deferFlags(FlagOperation::logicOr, A());
+#else
+    setFlag(FLAG_ZERO, A() == 0);
     clearFlag(FLAG_SUBTRACT);
     clearFlag(FLAG_HALFCARRY);
     clearFlag(FLAG_CARRY);
+#endif
     return 4;
 }
 
 uint16_t CPU::XORAnn(uint16_t dataAddress){
-    A ^= memoryMap.readByte(dataAddress);
-    setFlag(FLAG_ZERO, A == 0);
+    A() ^= memoryMap.readByte(dataAddress);
+    setFlag(FLAG_ZERO, A() == 0);
     clearFlag(FLAG_SUBTRACT);
     clearFlag(FLAG_HALFCARRY);
     clearFlag(FLAG_CARRY);
@@ -1359,8 +1296,8 @@ uint16_t CPU::XORAnn(uint16_t dataAddress){
 }
 
 uint16_t CPU::XORAu8(){
-    A ^= readByteAtPC();
-    setFlag(FLAG_ZERO, A == 0);
+    A() ^= readByteAtPC();
+    setFlag(FLAG_ZERO, A() == 0);
     clearFlag(FLAG_SUBTRACT);
     clearFlag(FLAG_HALFCARRY);
     clearFlag(FLAG_CARRY);
@@ -1370,17 +1307,21 @@ uint16_t CPU::XORAu8(){
 // ORAr
 // ORs A with given half register and stores result in A
 uint16_t CPU::ORAr(HalfRegister reg){
-    A |= reg;
-    setFlag(FLAG_ZERO, A == 0);
+    A() |= reg;
+#ifdef GB_EMU_LAZY_FLAGS
+    deferFlags(FlagOperation::logicOr, A());
+#else
+    setFlag(FLAG_ZERO, A() == 0);
     clearFlag(FLAG_SUBTRACT);
     clearFlag(FLAG_HALFCARRY);
     clearFlag(FLAG_CARRY);
+#endif
     return 4;
 }
 
 uint16_t CPU::ORAnn(uint16_t dataAddress){
-    A |= memoryMap.readByte(dataAddress);
-    setFlag(FLAG_ZERO, A == 0);
+    A() |= memoryMap.readByte(dataAddress);
+    setFlag(FLAG_ZERO, A() == 0);
     clearFlag(FLAG_SUBTRACT);
     clearFlag(FLAG_HALFCARRY);
     clearFlag(FLAG_CARRY);
@@ -1388,8 +1329,8 @@ uint16_t CPU::ORAnn(uint16_t dataAddress){
 }
 
 uint16_t CPU::ORAu8(){
-    A |= readByteAtPC();
-    setFlag(FLAG_ZERO, A == 0);
+    A() |= readByteAtPC();
+    setFlag(FLAG_ZERO, A() == 0);
     clearFlag(FLAG_SUBTRACT);
     clearFlag(FLAG_HALFCARRY);
     clearFlag(FLAG_CARRY);
@@ -1400,17 +1341,21 @@ uint16_t CPU::ORAu8(){
 // ANDAr
 // ANDs A with given half register and stores result in A
 uint16_t CPU::ANDAr(HalfRegister reg){
-    A &= reg;
-    setFlag(FLAG_ZERO, A == 0);
+    A() &= reg;
+#ifdef GB_EMU_LAZY_FLAGS
+    deferFlags(FlagOperation::logicAnd, A());
+#else
+    setFlag(FLAG_ZERO, A() == 0);
     clearFlag(FLAG_SUBTRACT);
     setFlag(FLAG_HALFCARRY);
     clearFlag(FLAG_CARRY);
+#endif
     return 4;
 }
 
 uint16_t CPU::ANDAnn(uint16_t dataAddress){
-    A &= memoryMap.readByte(dataAddress);
-    setFlag(FLAG_ZERO, A == 0);
+    A() &= memoryMap.readByte(dataAddress);
+    setFlag(FLAG_ZERO, A() == 0);
     clearFlag(FLAG_SUBTRACT);
     setFlag(FLAG_HALFCARRY);
     clearFlag(FLAG_CARRY);
@@ -1418,8 +1363,8 @@ uint16_t CPU::ANDAnn(uint16_t dataAddress){
 }
 
 uint16_t CPU::ANDAu8(){
-    A &= readByteAtPC();
-    setFlag(FLAG_ZERO, A == 0);
+    A() &= readByteAtPC();
+    setFlag(FLAG_ZERO, A() == 0);
     clearFlag(FLAG_SUBTRACT);
     setFlag(FLAG_HALFCARRY);
     clearFlag(FLAG_CARRY);
@@ -1431,10 +1376,15 @@ uint16_t CPU::INCrr(Register& reg){
 }
 
 uint16_t CPU::INCr(HalfRegister& reg){
+#ifdef GB_EMU_LAZY_FLAGS
+    deferFlags(FlagOperation::inc, reg, 0, carryFlag());
+    ++reg;
+#else
     setFlag(FLAG_HALFCARRY, (((reg & 0x0F) + 1) > 0x0F));
     ++reg;
     setFlag(FLAG_ZERO, reg == 0);
     clearFlag(FLAG_SUBTRACT);
+#endif
     return 4;
 }
 
@@ -1452,10 +1402,15 @@ uint16_t CPU::DECrr(Register& reg){
 }
 
 uint16_t CPU::DECr(HalfRegister& reg){
+#ifdef GB_EMU_LAZY_FLAGS
+    deferFlags(FlagOperation::dec, reg, 0, carryFlag());
+    --reg;
+#else
     setFlag(FLAG_HALFCARRY, ((reg & 0xF) - 1) & 0x10);
     --reg;
     setFlag(FLAG_ZERO, reg == 0);
     setFlag(FLAG_SUBTRACT);
+#endif
     return 4;
 }
 
@@ -1475,11 +1430,16 @@ uint16_t CPU::ADDrrrr(Register& x, Register y){
 }
 
 uint16_t CPU::ADDrr(HalfRegister& x, HalfRegister y){
+#ifdef GB_EMU_LAZY_FLAGS
+    deferFlags(FlagOperation::add, x, y);
+    x += y;
+#else
     setFlag(FLAG_CARRY, ((x & 0xFF) + (y & 0xFF)) & 0x100);
     setFlag(FLAG_HALFCARRY, ((x & 0xF) + (y & 0xF)) & 0x10);
     x += y;
     setFlag(FLAG_ZERO, x == 0);
     clearFlag(FLAG_SUBTRACT);
+#endif
     return 4;
 }
 
@@ -1506,11 +1466,16 @@ uint16_t CPU::ADDSPi8(){
 }
 
 uint16_t CPU::SUBrr(HalfRegister& x, HalfRegister& y){
+#ifdef GB_EMU_LAZY_FLAGS
+    deferFlags(FlagOperation::sub, x, y);
+    x -= y;
+#else
     setFlag(FLAG_CARRY, ((x & 0xFF) - (y & 0xFF)) & 0x100);
     setFlag(FLAG_HALFCARRY, ((x & 0xF) - (y & 0xF)) & 0x10);
     x -= y;
     setFlag(FLAG_ZERO, x == 0);
     setFlag(FLAG_SUBTRACT);
+#endif
     return 4;
 }
 
@@ -1527,12 +1492,18 @@ uint16_t CPU::SUBru8(HalfRegister& reg){
 }
 
 uint16_t CPU::ADCAr(HalfRegister reg){
+#ifdef GB_EMU_LAZY_FLAGS
+    uint8_t carry = carryFlag();
+    deferFlags(FlagOperation::add, A(), reg, carry);
+    A() += reg + carry;
+#else
     uint8_t carry = isFlagSet(FLAG_CARRY);
-    setFlag(FLAG_CARRY, ((A & 0xFF) + (reg & 0xFF) + (carry & 0xFF)) & 0x100);
-    setFlag(FLAG_HALFCARRY, ((A & 0xF) + (reg & 0xF) + (carry & 0xF)) & 0x10);
-    A += reg + carry;
-    setFlag(FLAG_ZERO, A == 0);
+    setFlag(FLAG_CARRY, ((A() & 0xFF) + (reg & 0xFF) + (carry & 0xFF)) & 0x100);
+    setFlag(FLAG_HALFCARRY, ((A() & 0xF) + (reg & 0xF) + (carry & 0xF)) & 0x10);
+    A() += reg + carry;
+    setFlag(FLAG_ZERO, A() == 0);
     clearFlag(FLAG_SUBTRACT);
+#endif
     return 4;
 }
 
@@ -1557,12 +1528,18 @@ uint16_t CPU::SBCAr(HalfRegister reg){
     setFlag(FLAG_HALFCARRY, ((Aprev & 0xF) - (subValue & 0xF)) & 0x10);
     return 4; */
 
+#ifdef GB_EMU_LAZY_FLAGS
+    uint8_t carry = carryFlag();
+    deferFlags(FlagOperation::sub, A(), reg, carry);
+    A() -= reg + carry;
+#else
     uint8_t carry = isFlagSet(FLAG_CARRY);
-    setFlag(FLAG_CARRY, ((A & 0xFF) - (reg & 0xFF) - (carry & 0xFF)) & 0x100);
-    setFlag(FLAG_HALFCARRY, ((A & 0xF) - (reg & 0xF) - (carry & 0xF)) & 0x10);
-    A -= reg + carry;
-    setFlag(FLAG_ZERO, A == 0);
+    setFlag(FLAG_CARRY, ((A() & 0xFF) - (reg & 0xFF) - (carry & 0xFF)) & 0x100);
+    setFlag(FLAG_HALFCARRY, ((A() & 0xF) - (reg & 0xF) - (carry & 0xF)) & 0x10);
+    A() -= reg + carry;
+    setFlag(FLAG_ZERO, A() == 0);
     setFlag(FLAG_SUBTRACT);
+#endif
     return 4;
 }
 
@@ -1579,10 +1556,14 @@ uint16_t CPU::SBCAu8(){
 uint16_t CPU::CPrr(HalfRegister& x, HalfRegister& y){
     /* setFlag(FLAG_CARRY, ((x & 0xFF) - (y & 0xFF)) & 0x100);
     setFlag(FLAG_HALFCARRY, ((x & 0xF) - (y & 0xF)) & 0x10); */
+#ifdef GB_EMU_LAZY_FLAGS
+    deferFlags(FlagOperation::sub, x, y);
+#else
     setFlag(FLAG_CARRY, (x & 0xFF) < (y & 0xFF));
     setFlag(FLAG_HALFCARRY, (x & 0xF) < (y & 0xF));
     setFlag(FLAG_ZERO, x - y == 0);
     setFlag(FLAG_SUBTRACT);
+#endif
     return 4;
 }
 
@@ -1599,48 +1580,12 @@ uint16_t CPU::CPru8(HalfRegister& reg){
 }
 
 uint16_t CPU::CPL(){
-    A = ~A;
+    A() = ~A();
     setFlag(FLAG_SUBTRACT);
     setFlag(FLAG_HALFCARRY);
     return 4;
 }
 
-uint16_t CPU::BITbr(uint8_t bit, HalfRegister const& reg){
-    setFlag(FLAG_ZERO, !reg.testBit(bit));
-    setFlag(FLAG_HALFCARRY);
-    clearFlag(FLAG_SUBTRACT);
-    return 8;
-}
-
-uint16_t CPU::BITbnn(uint8_t bit, uint16_t address){
-    BITbr(bit, memoryMap.readByte(address));
-    return 12;
-}
-
-uint16_t CPU::SETbr(uint8_t bit, HalfRegister& reg){
-    reg.setBit(bit);
-    return 8;
-}
-
-uint16_t CPU::SETbnn(uint8_t bit, uint16_t address){
-    HalfRegister tempReg = memoryMap.readByte(address);
-    tempReg.setBit(bit);
-    memoryMap.writeByte(address, tempReg);
-    return 16;
-}
-
-uint16_t CPU::RESbr(uint8_t bit, HalfRegister& reg){
-    reg.clearBit(bit);
-    return 8;
-}
-
-uint16_t CPU::RESbnn(uint8_t bit, uint16_t address){
-    HalfRegister tempReg = memoryMap.readByte(address);
-    tempReg.clearBit(bit);
-    memoryMap.writeByte(address, tempReg);
-    return 16;
-}
-
 uint16_t CPU::EI(){
     interruptsEnabled = true;
     return 4;
@@ -1651,182 +1596,46 @@ uint16_t CPU::DI(){
     return 4;
 }
 
-uint16_t CPU::RLr(HalfRegister& reg){
-    bool oldCarryState = isFlagSet(FLAG_CARRY);
-    setFlag(FLAG_CARRY, reg.testBit(7));
-    reg = reg << 1;
-    reg.setBit(0, oldCarryState);
-    setFlag(FLAG_ZERO, reg == 0x00);
-    clearFlag(FLAG_HALFCARRY);
-    clearFlag(FLAG_SUBTRACT);
-    return 8;
-}
-
-uint16_t CPU::RRr(HalfRegister& reg){
-    bool oldCarryState = isFlagSet(FLAG_CARRY);
-    setFlag(FLAG_CARRY, reg.testBit(0));
-    reg = reg >> 1;
-    reg.setBit(7, oldCarryState);
-    setFlag(FLAG_ZERO, reg == 0x00);
-    clearFlag(FLAG_HALFCARRY);
-    clearFlag(FLAG_SUBTRACT);
-    return 8;
-}
-
-uint16_t CPU::RLHL(){
-    HalfRegister tempReg = memoryMap.readByte(HL);
-    RLr(tempReg);
-    memoryMap.writeByte(HL, tempReg);
-    return 16;
-}
-
-uint16_t CPU::RRHL(){
-    HalfRegister tempReg = memoryMap.readByte(HL);
-    RRr(tempReg);
-    memoryMap.writeByte(HL, tempReg);
-    return 16;
-}
-
-uint16_t CPU::RLCr(HalfRegister& reg){
-    bool newCarryState = reg.testBit(7);
-    setFlag(FLAG_CARRY, newCarryState);
-    reg = reg << 1;
-    reg.setBit(0, newCarryState);
-    setFlag(FLAG_ZERO, reg == 0x00);
-    clearFlag(FLAG_HALFCARRY);
-    clearFlag(FLAG_SUBTRACT);
-    return 8;
-}
-
-uint16_t CPU::RRCr(HalfRegister& reg){
-    bool newCarryState = reg.testBit(0);
-    setFlag(FLAG_CARRY, newCarryState);
-    reg = reg >> 1;
-    reg.setBit(7, newCarryState);
-    setFlag(FLAG_ZERO, reg == 0x00);
-    clearFlag(FLAG_HALFCARRY);
-    clearFlag(FLAG_SUBTRACT);
-    return 8;
-}
-
-uint16_t CPU::RLCHL(){
-    HalfRegister tempReg = memoryMap.readByte(HL);
-    RLCr(tempReg);
-    memoryMap.writeByte(HL, tempReg);
-    return 16;
-}
-
-uint16_t CPU::RRCHL(){
-    HalfRegister tempReg = memoryMap.readByte(HL);
-    RRCr(tempReg);
-    memoryMap.writeByte(HL, tempReg);
-    return 16;
-}
-
 uint16_t CPU::RLCA(){
-    RLCr(A);
+    A() = shiftCB<0>(A());
     clearFlag(FLAG_ZERO);
     return 4;
 }
 
 uint16_t CPU::RLA(){
-    RLr(A);
+    A() = shiftCB<2>(A());
     clearFlag(FLAG_ZERO);
     return 4;
 }
 
 uint16_t CPU::RRCA(){
-    RRCr(A);
+    A() = shiftCB<1>(A());
     clearFlag(FLAG_ZERO);
     return 4;
 }
 
 uint16_t CPU::RRA(){
-    RRr(A);
+    A() = shiftCB<3>(A());
     clearFlag(FLAG_ZERO);
     return 4;
 }
 
-uint16_t CPU::SLAr(HalfRegister& reg){
-    setFlag(FLAG_CARRY, reg.testBit(7));
-    reg = reg << 1;
-    setFlag(FLAG_ZERO, reg == 0x00);
-    clearFlag(FLAG_HALFCARRY);
-    clearFlag(FLAG_SUBTRACT);
-    return 8;
-}
-
-uint16_t CPU::SLAHL(){
-    HalfRegister tempReg = memoryMap.readByte(HL);
-    SLAr(tempReg);
-    memoryMap.writeByte(HL, tempReg);
-    return 16;
-}
-
-uint16_t CPU::SRAr(HalfRegister& reg){
-    setFlag(FLAG_CARRY, reg.testBit(0));
-    bool bit7 = reg.testBit(7);
-    reg = reg >> 1;
-    reg.setBit(7, bit7);
-    setFlag(FLAG_ZERO, reg == 0x00);
-    clearFlag(FLAG_HALFCARRY);
-    clearFlag(FLAG_SUBTRACT);
-    return 8;
-}
-
-uint16_t CPU::SRAHL(){
-    HalfRegister tempReg = memoryMap.readByte(HL);
-    SRAr(tempReg);
-    memoryMap.writeByte(HL, tempReg);
-    return 16;
-    return 16;
-}
-
-uint16_t CPU::SRLr(HalfRegister& reg){
-    setFlag(FLAG_CARRY, reg.testBit(0));
-    reg = reg >> 1;
-    setFlag(FLAG_ZERO, reg == 0x00);
-    clearFlag(FLAG_HALFCARRY);
-    clearFlag(FLAG_SUBTRACT);
-    return 8;
-}
-
-uint16_t CPU::SRLHL(){
-    HalfRegister tempReg = memoryMap.readByte(HL);
-    SRLr(tempReg);
-    memoryMap.writeByte(HL, tempReg);
-    return 16;
-}
-
-uint16_t CPU::SWAPr(HalfRegister& reg){
-    reg = ((reg & 0x0F) << 4) | ((reg & 0xF0) >> 4);
-    setFlag(FLAG_ZERO, reg == 0x00);
-    clearFlag(FLAG_CARRY);
-    clearFlag(FLAG_HALFCARRY);
-    clearFlag(FLAG_SUBTRACT);
-    return 8;
-}
-
-uint16_t CPU::SWAPHL(){
-    HalfRegister tempReg = memoryMap.readByte(HL);
-    SWAPr(tempReg);
-    memoryMap.writeByte(HL, tempReg);
-    return 16;
-}
-
-
 uint16_t CPU::JPnn(uint16_t address){
     PC = address;
     return 4;
 }
  
 uint16_t CPU::JPu16(){
+    uint16_t const branchAddress = PC - 1;
     PC = readWordAtPC();
+    if (PC <= branchAddress){
+        checkIdleLoop(branchAddress);
+    }
     return 16;
 }
 
 uint16_t CPU::JPccu16(uint8_t condition, bool positiveCondition){
-    bool res = condition & F;
+    bool res = isFlagSet(condition);
     if (res == positiveCondition){
         return JPu16();
     }
@@ -1837,12 +1646,16 @@ uint16_t CPU::JPccu16(uint8_t condition, bool positiveCondition){
 }
 
 uint16_t CPU::JRe(){
+    uint16_t const branchAddress = PC - 1;
     PC += static_cast<int8_t>(readByteAtPC());
+    if (PC <= branchAddress){
+        checkIdleLoop(branchAddress);
+    }
     return 12;
 }
 
 uint16_t CPU::JRcce(uint8_t condition, bool positiveCondition){
-    bool res = condition & F;
+    bool res = isFlagSet(condition);
     if (res == positiveCondition){
         return JRe();
     }
@@ -1857,6 +1670,9 @@ uint16_t CPU::CALLu16(){
     SP -= 2;
     memoryMap.writeWord(SP, PC);
     PC = nn;
+    if (guestProfiler){
+        guestProfiler->call(codeLocation(PC), SP);
+    }
     return 24;
 /* 
     SP -= 2;
@@ -1866,7 +1682,7 @@ uint16_t CPU::CALLu16(){
 }
 
 uint16_t CPU::CALLccu16(uint8_t condition, bool positiveCondition){
-    bool res = condition & F;
+    bool res = isFlagSet(condition);
     if (res == positiveCondition){
         return CALLu16();
     }
@@ -1879,11 +1695,14 @@ uint16_t CPU::CALLccu16(uint8_t condition, bool positiveCondition){
 uint16_t CPU::RET(){
     PC = memoryMap.readWord(SP);
     SP += 2;
+    if (guestProfiler){
+        guestProfiler->ret(SP);
+    }
     return 16;
 }
 
 uint16_t CPU::RETcc(uint8_t condition, bool positiveCondition){
-    bool res = condition & F;
+    bool res = isFlagSet(condition);
     if (res == positiveCondition){
         RET();
         return 20;
@@ -1902,6 +1721,9 @@ uint16_t CPU::RST(uint8_t address){
     SP -= 2;
     memoryMap.writeWord(SP, PC);
     PC = address;
+    if (guestProfiler){
+        guestProfiler->call(codeLocation(PC), SP);
+    }
     return 16;
 }
 
@@ -1916,7 +1738,8 @@ uint16_t CPU::readWordAtPC(){
 }
 
 void CPU::setFlag(uint8_t flag){
-    F |= flag;
+    resolveFlags();
+    F() |= flag;
 }
 
 void CPU::setFlag(uint8_t flag, bool val){
@@ -1924,26 +1747,108 @@ void CPU::setFlag(uint8_t flag, bool val){
 }
 
 void CPU::clearFlag(uint8_t flag){
-    F &= ~flag;
+    resolveFlags();
+    F() &= ~flag;
 }
 
 bool CPU::isFlagSet(uint8_t flag){
-    return flag & F;
+    resolveFlags();
+    return flag & F();
+}
+
+#ifdef GB_EMU_LAZY_FLAGS
+// Builds Z, N, H and C from the last deferred operation (the lower nibble of F is kept)
+void CPU::resolveFlags(){
+    PendingFlags const& pending = pendingFlags;
+    uint8_t flags = 0x00;
+    switch (pending.operation){
+        case FlagOperation::none:
+            return;
+        case FlagOperation::add:{
+            int const result = pending.x + pending.y + pending.carry;
+            flags |= (result & 0xFF) == 0 ? FLAG_ZERO : 0x00;
+            flags |= ((pending.x & 0xF) + (pending.y & 0xF) + pending.carry) > 0xF ? FLAG_HALFCARRY : 0x00;
+            flags |= result > 0xFF ? FLAG_CARRY : 0x00;
+            break;
+        }
+        case FlagOperation::sub:{
+            int const result = pending.x - pending.y - pending.carry;
+            flags = FLAG_SUBTRACT;
+            flags |= (result & 0xFF) == 0 ? FLAG_ZERO : 0x00;
+            flags |= ((pending.x & 0xF) - (pending.y & 0xF) - pending.carry) < 0 ? FLAG_HALFCARRY : 0x00;
+            flags |= result < 0 ? FLAG_CARRY : 0x00;
+            break;
+        }
+        case FlagOperation::inc:
+            flags |= pending.x == 0xFF ? FLAG_ZERO : 0x00;
+            flags |= (pending.x & 0xF) == 0xF ? FLAG_HALFCARRY : 0x00;
+            flags |= pending.carry ? FLAG_CARRY : 0x00;
+            break;
+        case FlagOperation::dec:
+            flags = FLAG_SUBTRACT;
+            flags |= pending.x == 0x01 ? FLAG_ZERO : 0x00;
+            flags |= (pending.x & 0xF) == 0x0 ? FLAG_HALFCARRY : 0x00;
+            flags |= pending.carry ? FLAG_CARRY : 0x00;
+            break;
+        case FlagOperation::logicAnd:
+            flags = FLAG_HALFCARRY | (pending.x == 0 ? FLAG_ZERO : 0x00);
+            break;
+        case FlagOperation::logicOr:
+            flags = pending.x == 0 ? FLAG_ZERO : 0x00;
+            break;
+    }
+    F() = (F() & 0x0F) | flags;
+    pendingFlags.operation = FlagOperation::none;
+}
+
+void CPU::discardPendingFlags(){
+    pendingFlags.operation = FlagOperation::none;
+}
+
+// Replaces any pending operation, as every deferred operation sets all four flags
+void CPU::deferFlags(FlagOperation operation, uint8_t x, uint8_t y, uint8_t carry){
+    pendingFlags = {operation, x, y, carry};
+}
+
+// Current carry flag, without building the others (INC/DEC keep the carry, and ADC/SBC take it as input)
+uint8_t CPU::carryFlag(){
+    PendingFlags const& pending = pendingFlags;
+    switch (pending.operation){
+        case FlagOperation::add:
+            return (pending.x + pending.y + pending.carry) > 0xFF;
+        case FlagOperation::sub:
+            return (pending.x - pending.y - pending.carry) < 0;
+        case FlagOperation::inc:
+        case FlagOperation::dec:
+            return pending.carry;
+        case FlagOperation::logicAnd:
+        case FlagOperation::logicOr:
+            return 0;
+        default:
+            return (F() & FLAG_CARRY) ? 1 : 0;
+    }
+}
+#else
+void CPU::resolveFlags(){
+}
+
+void CPU::discardPendingFlags(){
 }
+#endif
 
+// Services the highest priority interrupt (the lowest bit) which is both requested and enabled - any others
+// remain pending until the handler re-enables interrupts
 void CPU::handleInterrupts(){
-    if(interruptsEnabled){
-        HalfRegister regIntEnabled = memoryMap.readByte(0xFFFF);
-        HalfRegister regIntFlag = memoryMap.readByte(0xFF0F);
-        for (int i = 0 ; i < 5 ; ++i){
-            if (regIntEnabled.testBit(i) && regIntFlag.testBit(i)){
-                interruptsEnabled = false;
-                regIntFlag.clearBit(i);
-                memoryMap.writeByte(0xFF0F, regIntFlag);
-                PUSHrr(PC);
-                uint16_t const interruptRoutines[5] = {0x40, 0x48, 0x50, 0x58, 0x60};
-                PC = interruptRoutines[i];
-            }
+    uint8_t const pending = memoryMap.getPendingInterrupts();
+    if (interruptsEnabled && pending){
+        int const interrupt = std::countr_zero(pending);
+        interruptsEnabled = false;
+        memoryMap.acknowledgeInterrupt(interrupt);
+        PUSHrr(PC);
+        uint16_t const interruptRoutines[5] = {0x40, 0x48, 0x50, 0x58, 0x60};
+        PC = interruptRoutines[interrupt];
+        if (guestProfiler){
+            guestProfiler->call(codeLocation(PC), SP);
         }
     }
 }
@@ -1958,10 +1863,8 @@ void CPU::requestInterrupt(uint8_t interrupt){
     if (interrupt > 4){
         throw std::runtime_error("Interrupt out of range");
     }
-    HalfRegister regIntFlag = memoryMap.readByte(0xFF0F);
-    regIntFlag.setBit(interrupt);
     halted = false; // Wake up CPU if halted
-    memoryMap.writeByte(0xFF0F, regIntFlag);
+    memoryMap.requestInterrupt(interrupt);
 }
 
 void CPU::printOpcode(uint8_t opcode){
@@ -1969,36 +1872,95 @@ void CPU::printOpcode(uint8_t opcode){
                       << std::hex << int(opcode);
 }
 
-void CPU::printOpcodeInfo(uint8_t opcode){
-    std::cout << opcodeInfo[opcode];
+
+// Records an instruction about to be executed (a no-op unless tracing is compiled in)
+void CPU::traceOpcode(uint16_t address, uint8_t opcode){
+    if constexpr (InstructionTrace::enabled){
+        uint8_t const opcodeCB = opcode == 0xCB ? memoryMap.readByte(address + 1) : 0x00;
+        trace.record({traceCycles, address, memoryMap.getROMBank(address), opcode, opcodeCB});
+        if (traceWriter){
+            resolveFlags();
+            TraceRecord record{traceCycles, address, SP, {A(), F(), B(), C(), D(), E(), H(), L()}, {opcode}, OPCODE_INFO[opcode].length};
+            for (uint8_t i = 1 ; i < record.length ; ++i){
+                record.opcodeBytes[i] = memoryMap.readByte(address + i);
+            }
+            traceWriter->record(record);
+        }
+    }
 }
 
-void CPU::printOpcodeCBInfo(uint8_t opcode){
-    std::cout << opcodeCBInfo[opcode];
+// Prints the opcode profile, or writes it to a CSV file if a path is given
+void CPU::reportProfile(std::string const& csvPath) const{
+    if (csvPath.length() != 0){
+        profiler.writeCSV(csvPath);
+    }
+    else{
+        profiler.printReport();
+    }
+}
+
+// ROM bank and address, identifying code as for cached blocks
+uint32_t CPU::codeLocation(uint16_t address) const{
+    return (uint32_t(memoryMap.getROMBank(address)) << 16) | address;
+}
+
+// Starts sampling the guest program (see profiler.h), naming code after the symbols in an RGBDS .sym file if given
+void CPU::startGuestProfile(std::string const& symbolPath){
+    guestProfiler = std::make_unique<GuestProfiler>();
+    if (symbolPath.length() != 0){
+        guestProfiler->loadSymbols(symbolPath);
+    }
+}
+
+// Cycles which may run before sampleGuest must be called, so batches of instructions stop at each sample
+uint32_t CPU::cyclesUntilGuestSample() const{
+    return guestProfiler ? guestProfiler->cyclesUntilSample() : UINT32_MAX;
 }
 
-void CPU::addOpcodeToLog(uint8_t opcode){
-    recentOpcodes.push_back(opcode);
-    while (recentOpcodes.size() > maxOpcodeLookback){
-        recentOpcodes.pop_front();
+// Called after every step with the cycles taken, which are attributed to the current PC and call stack
+void CPU::sampleGuest(uint16_t cycles){
+    if (guestProfiler){
+        guestProfiler->advance(cycles, codeLocation(PC), SP);
     }
 }
 
-void CPU::printRecentOpcodes(){
-    bool lastOpcodeIsCBPrefix = false;
+void CPU::writeGuestProfile(std::string const& path) const{
+    if (guestProfiler){
+        guestProfiler->writeFoldedStacks(path);
+    }
+}
+
+// Writes every instruction executed from now on to a trace file (see trace_file.h)
+// Native blocks run as a whole, so have no registers to record between their instructions, and
+// a trace would diverge from the interpreter's - only the interpreter can write trace files
+void CPU::startTraceFile(std::string const& path){
+    if (!InstructionTrace::enabled){
+        throw std::runtime_error("Trace files require a build with -DGB_EMU_TRACE");
+    }
+    if (engine != CPUEngine::interpreter){
+        throw std::runtime_error("Trace files require the interpreter (--cpu=interp)");
+    }
+    traceWriter = std::make_unique<TraceWriter>(path);
+}
+
+// Prints the last count instructions traced, oldest first, as: cycle bank:PC opcode: description
+void CPU::printTrace(std::size_t count){
+    if (!InstructionTrace::enabled){
+        std::cout << "\tInstruction trace unavailable (build with -DGB_EMU_TRACE)";
+        return;
+    }
+    std::size_t const first = trace.size() > count ? trace.size() - count : 0;
     std::cout << "\t...";
-    for (auto op : recentOpcodes){
-        std::cout << "\n\t";
-        printOpcode(op);
-        std::cout << ": ";
-        if(lastOpcodeIsCBPrefix){
-            std::cout << opcodeCBInfo[op];
-            lastOpcodeIsCBPrefix = false;
-        }
-        else{
-            std::cout << opcodeInfo[op];
-            lastOpcodeIsCBPrefix = op == 0xCB;
+    for (std::size_t i = first ; i < trace.size() ; ++i){
+        TraceEntry const& entry = trace[i];
+        std::cout << "\n\t" << std::dec << entry.cycle << " " << std::hex << std::setfill('0') << std::setw(2) << entry.bank
+                  << ":" << std::setw(4) << entry.PC << " ";
+        printOpcode(entry.opcode);
+        if (entry.opcode == 0xCB){
+            std::cout << " ";
+            printOpcode(entry.opcodeCB);
         }
+        std::cout << ": " << getOpcodeInfo(entry.opcode, entry.opcodeCB).mnemonic;
     }
 }
 
@@ -0,0 +1,621 @@
+#include "..\inc\dynarec.h"
+#include "..\inc\cpu.h"
+
+#include <cstring>
+#include <optional>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+// x86-64 register numbers
+uint8_t constexpr static RAX = 0;
+uint8_t constexpr static RCX = 1;
+uint8_t constexpr static RDX = 2;
+uint8_t constexpr static RBX = 3;
+uint8_t constexpr static RSI = 6;
+uint8_t constexpr static RDI = 7;
+uint8_t constexpr static R8 = 8;
+
+// Integer argument registers and stack space reserved around calls (keeps rsp 16-byte aligned)
+#ifdef _WIN32
+std::array<uint8_t, 3> constexpr static ARG_REGISTERS = {RCX, RDX, R8};
+uint8_t constexpr static FRAME_SIZE = 0x28; // Includes 32 bytes of shadow space
+#else
+std::array<uint8_t, 3> constexpr static ARG_REGISTERS = {RDI, RSI, RDX};
+uint8_t constexpr static FRAME_SIZE = 0x08;
+#endif
+
+// x86 encodings of the SM83 ALU operations (ADD, ADC, SUB, SBC, AND, XOR, OR, CP) as
+// op al, r/m8 and op al, imm8 respectively
+std::array<uint8_t, 8> constexpr static ALU_MEMORY_OPCODES = {0x02, 0x12, 0x2A, 0x1A, 0x22, 0x32, 0x0A, 0x3A};
+std::array<uint8_t, 8> constexpr static ALU_IMMEDIATE_OPCODES = {0x04, 0x14, 0x2C, 0x1C, 0x24, 0x34, 0x0C, 0x3C};
+
+// Positions of the zero, half carry and carry bits in RFLAGS
+uint8_t constexpr static X86_ZERO = 0x40;
+uint8_t constexpr static X86_HALFCARRY = 0x10;
+
+static_assert(sizeof(Register) == 2, "Native code accesses register pairs as 16-bit words");
+
+// Memory an instruction accesses through a register pair (indexed as in LD rr,u16: BC, DE, HL, SP), as the
+// offsets from the pair's value of the first and last bytes accessed
+struct PointerAccess{
+    uint8_t pair;
+    int8_t first, last;
+    bool write;
+};
+
+std::optional<PointerAccess> static pointerAccess(DecodedOpcode const& decodedOpcode){
+    uint8_t const opcode = decodedOpcode.opcode;
+    if (decodedOpcode.CBPrefixed){
+        uint8_t const opcodeCB = decodedOpcode.opcodeCB;
+        bool const write = opcodeCB < 0x40 || opcodeCB >= 0x80; // All but BIT
+        return (opcodeCB & 0x07) == 0x06 ? std::optional<PointerAccess>{{2, 0, 0, write}} : std::nullopt;
+    }
+    switch(opcode){
+    case 0x02: case 0x0A: // LD (BC),A / LD A,(BC)
+        return PointerAccess{0, 0, 0, opcode == 0x02};
+    case 0x12: case 0x1A: // LD (DE),A / LD A,(DE)
+        return PointerAccess{1, 0, 0, opcode == 0x12};
+    case 0x22: case 0x2A: case 0x32: case 0x3A: // LD (HL+/-)
+        return PointerAccess{2, 0, 0, opcode == 0x22 || opcode == 0x32};
+    case 0x34: case 0x35: case 0x36: // INC/DEC (HL), LD (HL),u8
+        return PointerAccess{2, 0, 0, true};
+    case 0xC5: case 0xD5: case 0xE5: case 0xF5: // PUSH
+    case 0xC4: case 0xCC: case 0xCD: case 0xD4: case 0xDC: // CALL
+    case 0xC7: case 0xCF: case 0xD7: case 0xDF: case 0xE7: case 0xEF: case 0xF7: case 0xFF: // RST
+        return PointerAccess{3, -2, -1, true};
+    case 0xC1: case 0xD1: case 0xE1: case 0xF1: // POP
+    case 0xC0: case 0xC8: case 0xC9: case 0xD0: case 0xD8: case 0xD9: // RET, RETI
+        return PointerAccess{3, 0, 1, false};
+    default:
+        break;
+    }
+    // LD r,(HL) / LD (HL),r / ALU A,(HL)
+    bool const write = opcode >= 0x70 && opcode < 0x78;
+    if (opcode >= 0x40 && opcode < 0xC0 && opcode != 0x76 && ((opcode & 0x07) == 0x06 || write)){
+        return PointerAccess{2, 0, 0, write};
+    }
+    return std::nullopt;
+}
+
+Dynarec::~Dynarec(){
+    if (codeBuffer){
+#ifdef _WIN32
+        VirtualFree(codeBuffer, 0, MEM_RELEASE);
+#else
+        munmap(codeBuffer, codeBufferSize);
+#endif
+    }
+}
+
+bool Dynarec::isAvailable(){
+#ifdef GB_EMU_DYNAREC_AVAILABLE
+    return true;
+#else
+    return false;
+#endif
+}
+
+// Returns native code for block, compiling it once it has been run enough times to be worthwhile
+NativeBlock Dynarec::getNativeBlock(DecodedBlock& block, CPU& cpu){
+    if (block.inRAM || block.nativeRefused){
+        return nullptr;
+    }
+    if (block.native && block.nativeGeneration == generation){
+        return block.native;
+    }
+    if (++block.executionCount < hotThreshold){
+        return nullptr;
+    }
+    block.native = compile(block, cpu);
+    block.nativeGeneration = generation;
+    block.nativeRefused = !block.native;
+    return block.native;
+}
+
+// Native blocks have the signature uint32_t block(CPU*), returning the number of cycles taken
+// Only the final instruction of a block may branch, so everything else is straight-line code
+NativeBlock Dynarec::compile(DecodedBlock const& block, CPU& cpu){
+#ifdef GB_EMU_DYNAREC_AVAILABLE
+    if (needsInterpreter(block, cpu) || (!codeBuffer && !allocateCodeBuffer())){
+        return nullptr;
+    }
+    auto const offsetOf = [&cpu](void const* field){
+        return int32_t(static_cast<uint8_t const*>(field) - reinterpret_cast<uint8_t const*>(&cpu));
+    };
+    // Indexed as in the opcode encoding: B, C, D, E, H, L, (HL), A
+    std::array<int32_t, 8> const registerOffsets = {offsetOf(&cpu.B()), offsetOf(&cpu.C()), offsetOf(&cpu.D()), offsetOf(&cpu.E()),
+        offsetOf(&cpu.H()), offsetOf(&cpu.L()), 0, offsetOf(&cpu.A())};
+    std::array<int32_t, 4> const pairOffsets = {offsetOf(&cpu.BC), offsetOf(&cpu.DE), offsetOf(&cpu.HL), offsetOf(&cpu.SP)};
+    int32_t const offsetA = registerOffsets[7];
+    int32_t const offsetF = offsetOf(&cpu.F());
+    int32_t const offsetHL = pairOffsets[2];
+    int32_t const offsetPC = offsetOf(&cpu.PC);
+    int32_t const offsetOpcodesRun = offsetOf(&cpu.nativeOpcodesRun);
+
+    code.clear();
+    // Prologue - push rbx, push r12, sub rsp, FRAME_SIZE, mov rbx, arg0, xor r12d, r12d
+    emit({0x53, 0x41, 0x54, 0x48, 0x83, 0xEC, FRAME_SIZE});
+    emit({0x48, 0x89, uint8_t(0xC0 | (ARG_REGISTERS[0] << 3) | RBX)});
+    emit({0x45, 0x31, 0xE4});
+
+    uint32_t cycles = 0; // Cycles taken by inline instructions, added once at the end
+    bool endsWithBranch = false;
+    std::vector<Exit> exits;
+    for (auto const& decodedOpcode : block.opcodes){
+        uint8_t const opcode = decodedOpcode.opcode;
+        uint16_t const address = decodedOpcode.address;
+        uint8_t const operand = cpu.memoryMap.readByte(address + 1);
+        uint16_t const operandWord = operand | (cpu.memoryMap.readByte(address + 2) << 8);
+        bool const isLast = &decodedOpcode == &block.opcodes.back();
+        uint8_t const r = (opcode >> 3) & 0x07;
+        uint8_t const s = opcode & 0x07;
+
+        // Leave native code before accessing an I/O register through a pointer, so that the interpreter makes
+        // the access with the timers and GPU up to date, or writing to an MBC register, which may switch out the block
+        if (auto const access = pointerAccess(decodedOpcode)){
+            Exit exit{address, uint32_t(&decodedOpcode - block.opcodes.data()), cycles, {}};
+            for (int8_t offset = access->first ; offset <= access->last ; ++offset){
+                emitAccessGuard(pairOffsets[access->pair], offset, access->write, exit.jumps);
+            }
+            exits.push_back(std::move(exit));
+        }
+
+        if (decodedOpcode.CBPrefixed){
+            // Handled by the interpreter below
+        }
+        else if (opcode == 0x00){
+            cycles += 4;
+            continue;
+        }
+        // LD rr,u16
+        else if ((opcode & 0xCF) == 0x01){
+            emit({0x66, 0xC7});
+            emitCPUOperand(0, pairOffsets[opcode >> 4]);
+            emit16(operandWord);
+            cycles += 12;
+            continue;
+        }
+        // LD (BC),A / LD (DE),A / LD (HL+),A / LD (HL-),A
+        else if ((opcode & 0xCF) == 0x02){
+            int32_t const pairOffset = opcode < 0x20 ? pairOffsets[opcode >> 4] : offsetHL;
+            emitArgCPU();
+            emitArgWord(1, pairOffset);
+            emitArgByte(2, offsetA);
+            emitCall(reinterpret_cast<uintptr_t>(&Dynarec::writeByte));
+            if (opcode >= 0x20){
+                // inc/dec word [HL]
+                emit({0x66, 0xFF});
+                emitCPUOperand(opcode == 0x22 ? 0 : 1, offsetHL);
+            }
+            cycles += 8;
+            continue;
+        }
+        // INC rr / DEC rr
+        else if ((opcode & 0xC7) == 0x03){
+            emit({0x66, 0xFF});
+            emitCPUOperand((opcode & 0x08) ? 1 : 0, pairOffsets[opcode >> 4]);
+            cycles += 8;
+            continue;
+        }
+        // INC r / DEC r (carry is unaffected)
+        else if ((opcode & 0xC6) == 0x04 && r != 6){
+            bool const decrement = opcode & 0x01;
+            emit({0xFE});
+            emitCPUOperand(decrement ? 1 : 0, registerOffsets[r]);
+            emitFlags(true, true, false, decrement ? 0x40 : 0x00, true, offsetF);
+            cycles += 4;
+            continue;
+        }
+        // LD r,u8
+        else if ((opcode & 0xC7) == 0x06 && r != 6){
+            emit({0xC6});
+            emitCPUOperand(0, registerOffsets[r]);
+            emit({operand});
+            cycles += 8;
+            continue;
+        }
+        // LD A,(BC) / LD A,(DE) / LD A,(HL+) / LD A,(HL-)
+        else if ((opcode & 0xCF) == 0x0A){
+            int32_t const pairOffset = opcode < 0x20 ? pairOffsets[opcode >> 4] : offsetHL;
+            emitArgCPU();
+            emitArgWord(1, pairOffset);
+            emitCall(reinterpret_cast<uintptr_t>(&Dynarec::readByte));
+            emitStoreByte(offsetA, RAX);
+            if (opcode >= 0x20){
+                emit({0x66, 0xFF});
+                emitCPUOperand(opcode == 0x2A ? 0 : 1, offsetHL);
+            }
+            cycles += 8;
+            continue;
+        }
+        // CPL - not byte [A], or byte [F], 0x60
+        else if (opcode == 0x2F){
+            emit({0xF6});
+            emitCPUOperand(2, offsetA);
+            emit({0x80});
+            emitCPUOperand(1, offsetF);
+            emit({0x60});
+            cycles += 4;
+            continue;
+        }
+        // LD r,r / LD r,(HL) / LD (HL),r
+        else if (opcode >= 0x40 && opcode < 0x80 && opcode != 0x76){
+            if (s == 6){
+                emitArgCPU();
+                emitArgWord(1, offsetHL);
+                emitCall(reinterpret_cast<uintptr_t>(&Dynarec::readByte));
+                emitStoreByte(registerOffsets[r], RAX);
+                cycles += 8;
+            }
+            else if (r == 6){
+                emitArgCPU();
+                emitArgWord(1, offsetHL);
+                emitArgByte(2, registerOffsets[s]);
+                emitCall(reinterpret_cast<uintptr_t>(&Dynarec::writeByte));
+                cycles += 8;
+            }
+            else{
+                if (r != s){
+                    emitLoadByte(RAX, registerOffsets[s]);
+                    emitStoreByte(registerOffsets[r], RAX);
+                }
+                cycles += 4;
+            }
+            continue;
+        }
+        // ALU A,r / ALU A,(HL) / ALU A,u8
+        else if ((opcode >= 0x80 && opcode < 0xC0) || (opcode & 0xC7) == 0xC6){
+            bool const immediate = opcode >= 0xC0;
+            if (!immediate && s == 6){
+                // Read into cl before the carry flag is loaded, as the call clobbers flags
+                emitArgCPU();
+                emitArgWord(1, offsetHL);
+                emitCall(reinterpret_cast<uintptr_t>(&Dynarec::readByte));
+                emit({0x88, 0xC1}); // mov cl, al
+            }
+            if (r == 1 || r == 3){
+                // ADC/SBC - mov dl, [F], shr dl, 5 moves the SM83 carry into the x86 carry
+                emitLoadByte(RDX, offsetF);
+                emit({0xC0, 0xEA, 0x05});
+            }
+            emitLoadByte(RAX, offsetA);
+            if (immediate){
+                emit({ALU_IMMEDIATE_OPCODES[r], operand});
+            }
+            else if (s == 6){
+                emit({uint8_t(ALU_MEMORY_OPCODES[r] - 0x02), 0xC8}); // op al, cl
+            }
+            else{
+                emit({ALU_MEMORY_OPCODES[r]});
+                emitCPUOperand(RAX, registerOffsets[s]);
+            }
+            if (r != 7){
+                emitStoreByte(offsetA, RAX); // mov leaves the x86 flags intact
+            }
+            if (r < 2){
+                emitFlags(true, true, true, 0x00, false, offsetF);
+            }
+            else if (r < 4 || r == 7){
+                emitFlags(true, true, true, 0x40, false, offsetF);
+            }
+            else{
+                emitFlags(true, false, false, r == 4 ? 0x20 : 0x00, false, offsetF);
+            }
+            cycles += (immediate || s == 6) ? 8 : 4;
+            continue;
+        }
+        // JR e / JP u16
+        else if (opcode == 0x18 || opcode == 0xC3){
+            uint16_t const target = opcode == 0x18 ? uint16_t(address + 2 + int8_t(operand)) : operandWord;
+            emit({0x66, 0xC7});
+            emitCPUOperand(0, offsetPC);
+            emit16(target);
+            cycles += opcode == 0x18 ? 12 : 16;
+            endsWithBranch = true;
+            continue;
+        }
+        // JR cc,e / JP cc,u16
+        else if ((opcode & 0xE7) == 0x20 || (opcode & 0xE7) == 0xC2){
+            bool const relative = opcode < 0x40;
+            uint16_t const next = address + (relative ? 2 : 3);
+            uint16_t const target = relative ? uint16_t(next + int8_t(operand)) : operandWord;
+            bool const positiveCondition = opcode & 0x08;
+            uint8_t const flag = (opcode & 0x10) ? 0x10 : 0x80;
+            // test byte [F], flag, then skip to the not-taken path
+            emit({0xF6});
+            emitCPUOperand(0, offsetF);
+            emit({flag});
+            std::size_t const notTaken = emitJump(positiveCondition ? 0x84 : 0x85);
+            emit({0x66, 0xC7});
+            emitCPUOperand(0, offsetPC);
+            emit16(target);
+            emit({0x41, 0x81, 0xC4});
+            emit32(relative ? 12 : 16);
+            std::size_t const done = emitJump(0);
+            patchJump(notTaken);
+            emit({0x66, 0xC7});
+            emitCPUOperand(0, offsetPC);
+            emit16(next);
+            emit({0x41, 0x81, 0xC4});
+            emit32(relative ? 8 : 12);
+            patchJump(done);
+            endsWithBranch = true;
+            continue;
+        }
+
+        // Anything else runs its interpreter handler, with PC just past the opcode as it would be when interpreting
+        emit({0x66, 0xC7});
+        emitCPUOperand(0, offsetPC);
+        emit16(address + (decodedOpcode.CBPrefixed ? 2 : 1));
+        emitArgCPU();
+        emitCall(reinterpret_cast<uintptr_t>(decodedOpcode.handler));
+        emit({0x0F, 0xB7, 0xC0}); // movzx eax, ax
+        emit({0x41, 0x01, 0xC4}); // add r12d, eax
+#ifdef GB_EMU_LAZY_FLAGS
+        // Following instructions read F directly
+        emitArgCPU();
+        emitCall(reinterpret_cast<uintptr_t>(&Dynarec::resolveFlags));
+#endif
+        if (isLast){
+            endsWithBranch = true; // The handler has already set PC
+        }
+    }
+    if (!endsWithBranch){
+        emit({0x66, 0xC7});
+        emitCPUOperand(0, offsetPC);
+        emit16(block.endAddress + 1);
+    }
+    // Epilogue - add r12d, cycles, mov eax, r12d, add rsp, FRAME_SIZE, pop r12, pop rbx, ret
+    emit({0x41, 0x81, 0xC4});
+    emit32(cycles);
+    std::size_t const epilogue = code.size();
+    emit({0x44, 0x89, 0xE0, 0x48, 0x83, 0xC4, FRAME_SIZE, 0x41, 0x5C, 0x5B, 0xC3});
+    // Early exits - set PC to the instruction left to the interpreter, count the cycles and instructions run before it,
+    // then join the epilogue
+    for (auto const& exit : exits){
+        for (std::size_t const jump : exit.jumps){
+            patchJump(jump);
+        }
+        emit({0x66, 0xC7});
+        emitCPUOperand(0, offsetPC);
+        emit16(exit.address);
+        emit({0xC7});
+        emitCPUOperand(0, offsetOpcodesRun);
+        emit32(exit.opcodesRun);
+        emit({0x41, 0x81, 0xC4});
+        emit32(exit.cycles);
+        patchJump(emitJump(0), epilogue);
+    }
+
+    if (codeBufferUsed + code.size() > codeBufferSize){
+        flush();
+    }
+    uint8_t* const nativeCode = codeBuffer + codeBufferUsed;
+    std::memcpy(nativeCode, code.data(), code.size());
+    codeBufferUsed += code.size();
+    return reinterpret_cast<NativeBlock>(reinterpret_cast<uintptr_t>(nativeCode));
+#else
+    (void)block;
+    (void)cpu;
+    return nullptr;
+#endif
+}
+
+// Accesses to I/O registers are timing sensitive (e.g. polling LY), so blocks making them at a fixed address
+// stay in the interpreter, where the GPU and timers are updated between instructions - as do blocks writing to
+// the MBC's registers at a fixed address, which may switch out the block's own code (accesses through a pointer
+// are checked as the block runs - see emitAccessGuard)
+bool Dynarec::needsInterpreter(DecodedBlock const& block, CPU& cpu) const{
+    for (auto const& decodedOpcode : block.opcodes){
+        switch (decodedOpcode.opcode){
+            case 0x10: // STOP
+            case 0xE0: // LD (FF00+u8),A
+            case 0xE2: // LD (FF00+C),A
+            case 0xF0: // LD A,(FF00+u8)
+            case 0xF2: // LD A,(FF00+C)
+                return true;
+            case 0xEA: // LD (u16),A
+            case 0xFA: { // LD A,(u16)
+                uint16_t const target = cpu.memoryMap.readWord(decodedOpcode.address + 1);
+                if ((target >> 8) == 0xFF || (decodedOpcode.opcode == 0xEA && target < 0x8000)){
+                    return true;
+                }
+                break;
+            }
+            case 0x08: { // LD (u16),SP
+                uint16_t const target = cpu.memoryMap.readWord(decodedOpcode.address + 1);
+                uint16_t const last = target + 1;
+                if ((target >> 8) == 0xFF || (last >> 8) == 0xFF || target < 0x8000 || last < 0x8000){
+                    return true;
+                }
+                break;
+            }
+            default:
+                break;
+        }
+    }
+    return false;
+}
+
+bool Dynarec::allocateCodeBuffer(){
+#ifdef _WIN32
+    void* const buffer = VirtualAlloc(nullptr, codeBufferSize, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE);
+    if (!buffer){
+        return false;
+    }
+#else
+    void* const buffer = mmap(nullptr, codeBufferSize, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (buffer == MAP_FAILED){
+        return false;
+    }
+#endif
+    codeBuffer = static_cast<uint8_t*>(buffer);
+    codeBufferUsed = 0;
+    return true;
+}
+
+// Discards all native code once the buffer is full - blocks still in use are recompiled when next hot
+void Dynarec::flush(){
+    codeBufferUsed = 0;
+    ++generation;
+}
+
+uint8_t Dynarec::readByte(CPU* cpu, uint16_t address){
+    return cpu->memoryMap.readByte(address);
+}
+
+void Dynarec::writeByte(CPU* cpu, uint16_t address, uint8_t value){
+    cpu->memoryMap.writeByte(address, value);
+}
+
+void Dynarec::resolveFlags(CPU* cpu){
+    cpu->resolveFlags();
+}
+
+void Dynarec::emit(std::initializer_list<uint8_t> bytes){
+    for (uint8_t const byte : bytes){
+        code.push_back(byte);
+    }
+}
+
+void Dynarec::emit16(uint16_t value){
+    emit({uint8_t(value), uint8_t(value >> 8)});
+}
+
+void Dynarec::emit32(uint32_t value){
+    emit16(uint16_t(value));
+    emit16(uint16_t(value >> 16));
+}
+
+void Dynarec::emit64(uint64_t value){
+    emit32(uint32_t(value));
+    emit32(uint32_t(value >> 32));
+}
+
+// ModRM (and displacement) for [rbx + offset], with reg as the register (or opcode extension) operand
+void Dynarec::emitCPUOperand(uint8_t reg, int32_t offset){
+    emit({uint8_t(0x80 | ((reg & 0x07) << 3) | RBX)});
+    emit32(uint32_t(offset));
+}
+
+// mov reg8, [rbx + offset] (al, cl, dl only)
+void Dynarec::emitLoadByte(uint8_t reg, int32_t offset){
+    emit({0x8A});
+    emitCPUOperand(reg, offset);
+}
+
+// mov [rbx + offset], reg8 (al, cl, dl only)
+void Dynarec::emitStoreByte(int32_t offset, uint8_t reg){
+    emit({0x88});
+    emitCPUOperand(reg, offset);
+}
+
+// mov arg0, rbx
+void Dynarec::emitArgCPU(){
+    uint8_t const reg = ARG_REGISTERS[0];
+    emit({uint8_t(0x48 | (reg >> 3)), 0x89, uint8_t(0xC0 | (RBX << 3) | (reg & 0x07))});
+}
+
+// movzx arg, word [rbx + offset]
+void Dynarec::emitArgWord(uint8_t arg, int32_t offset){
+    uint8_t const reg = ARG_REGISTERS[arg];
+    if (reg >= R8){
+        emit({0x44});
+    }
+    emit({0x0F, 0xB7});
+    emitCPUOperand(reg, offset);
+}
+
+// movzx arg, byte [rbx + offset]
+void Dynarec::emitArgByte(uint8_t arg, int32_t offset){
+    uint8_t const reg = ARG_REGISTERS[arg];
+    if (reg >= R8){
+        emit({0x44});
+    }
+    emit({0x0F, 0xB6});
+    emitCPUOperand(reg, offset);
+}
+
+// mov rax, function, call rax
+void Dynarec::emitCall(uintptr_t function){
+    emit({0x48, 0xB8});
+    emit64(function);
+    emit({0xFF, 0xD0});
+}
+
+// Builds the SM83 flags register from the x86 flags left by the preceding instruction
+// The lower nibble of F (and the carry, if preserveCarry) is kept from its previous value
+void Dynarec::emitFlags(bool zero, bool halfCarry, bool carry, uint8_t setBits, bool preserveCarry, int32_t offsetF){
+    emit({0x9C, 0x59}); // pushfq, pop rcx
+    if (carry){
+        emit({0x89, 0xCA}); // mov edx, ecx
+    }
+    // and ecx, Z | H, add ecx, ecx - moves bit 6 to 7 and bit 4 to 5
+    emit({0x83, 0xE1, uint8_t((zero ? X86_ZERO : 0x00) | (halfCarry ? X86_HALFCARRY : 0x00)), 0x01, 0xC9});
+    if (carry){
+        emit({0x83, 0xE2, 0x01, 0xC1, 0xE2, 0x04, 0x09, 0xD1}); // and edx, 1, shl edx, 4, or ecx, edx
+    }
+    // movzx edx, byte [F], and edx, mask, or ecx, edx
+    emit({0x0F, 0xB6});
+    emitCPUOperand(RDX, offsetF);
+    emit({0x83, 0xE2, uint8_t(preserveCarry ? 0x1F : 0x0F), 0x09, 0xD1});
+    if (setBits){
+        emit({0x83, 0xC9, setBits}); // or ecx, setBits
+    }
+    emitStoreByte(offsetF, RCX);
+}
+
+// Emits jcc rel32 (or jmp rel32 if conditionOpcode is 0), returning the position of the displacement to patch
+std::size_t Dynarec::emitJump(uint8_t conditionOpcode){
+    if (conditionOpcode){
+        emit({0x0F, conditionOpcode});
+    }
+    else{
+        emit({0xE9});
+    }
+    emit32(0);
+    return code.size() - 4;
+}
+
+// Jumps to an exit if the address offset bytes from the register pair at pairOffset is an I/O register (or IE), or
+// for a write, is in ROM (where writes select banks)
+// movzx eax, word [rbx + pairOffset], add eax, offset, movzx eax, ax, then cmp eax, 0xFFFF, je exit, (cmp eax, 0x8000,
+// jb exit,) and sub eax, 0xFF00, cmp eax, 0x80, jb exit
+void Dynarec::emitAccessGuard(int32_t pairOffset, int8_t offset, bool write, std::vector<std::size_t>& exitJumps){
+    emit({0x0F, 0xB7});
+    emitCPUOperand(RAX, pairOffset);
+    if (offset != 0){
+        emit({0x83, 0xC0, uint8_t(offset)});
+        emit({0x0F, 0xB7, 0xC0});
+    }
+    emit({0x3D});
+    emit32(0xFFFF);
+    exitJumps.push_back(emitJump(0x84));
+    if (write){
+        emit({0x3D});
+        emit32(0x8000);
+        exitJumps.push_back(emitJump(0x82));
+    }
+    emit({0x2D});
+    emit32(0xFF00);
+    emit({0x3D});
+    emit32(0x80);
+    exitJumps.push_back(emitJump(0x82));
+}
+
+// Points a jump emitted by emitJump at the current position
+void Dynarec::patchJump(std::size_t jump){
+    patchJump(jump, code.size());
+}
+
+// Points a jump emitted by emitJump at target
+void Dynarec::patchJump(std::size_t jump, std::size_t target){
+    uint32_t const displacement = uint32_t(target - (jump + 4));
+    std::memcpy(code.data() + jump, &displacement, sizeof(displacement));
+}
\ No newline at end of file
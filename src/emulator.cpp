@@ -3,13 +3,18 @@
 GBEmulator::GBEmulator() : cpu{memoryMap}, gpu{memoryMap, cpu}{
 }
 
-bool GBEmulator::start(std::string const& cartridgePath, std::string const& bootPath, bool printSerial){
-    window = SDL_CreateWindow("GB-EMU", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, winScale * winWidth, winScale * winHeight, winFlags);
-    if (!window){
-        throw std::runtime_error("Failed to create SDL window");
-    }
+bool GBEmulator::start(std::string const& cartridgePath, std::string const& bootPath, bool printSerial, CPUEngine engine,
+                       unsigned int headlessFrames, std::string const& tracePath, std::string const& profilePath,
+                       std::string const& guestProfilePath, std::string const& symbolPath){
+    auto const tLaunch = std::chrono::high_resolution_clock::now();
+    if (headlessFrames == 0){
+        window = SDL_CreateWindow("GB-EMU", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, winScale * winWidth, winScale * winHeight, winFlags);
+        if (!window){
+            throw std::runtime_error("Failed to create SDL window");
+        }
 
-    gpu.initialiseRenderer(window);
+        gpu.initialiseRenderer(window);
+    }
 
     if (bootPath.length() != 0){
         if (!memoryMap.loadBootProgram(bootPath)){
@@ -27,19 +32,49 @@ bool GBEmulator::start(std::string const& cartridgePath, std::string const& boot
             throw std::runtime_error("Failed to load cartridge at " + cartridgePath);
         }
         std::cout << "Loaded cartridge\n";
+        if (memoryMap.getSavePath().length() != 0){
+            std::cout << "Cartridge RAM is saved in " << memoryMap.getSavePath() << "\n";
+        }
     }
     else{
         throw std::runtime_error("Specify cartridge path using '-i [PATH]'");
     }
     
     verbose = printSerial;
+    if (verbose){
+        // Print serial data as soon as a transfer is started, then complete it
+        memoryMap.addIOListener(IORegister::SC, [this](uint8_t value){
+            if (value == 0x81){
+                printf("%c", char(memoryMap.readIO(IORegister::SB)));
+                memoryMap.writeIO(IORegister::SC, 0x00);
+            }
+        });
+    }
+    cpu.setEngine(engine);
+    if (tracePath.length() != 0){
+        cpu.startTraceFile(tracePath);
+    }
+    if (profilePath.length() != 0 && !ExecutionProfiler::enabled){
+        throw std::runtime_error("Profiling requires a build with -DGB_EMU_PROFILE");
+    }
+    this->profilePath = profilePath;
+    if (guestProfilePath.length() != 0){
+        cpu.startGuestProfile(symbolPath);
+    }
+    this->guestProfilePath = guestProfilePath;
+
+    directionInputReg = 0x00;
+    buttonInputReg = 0x00;
+    if (headlessFrames != 0){
+        stats.startupSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - tLaunch).count();
+        runHeadless(headlessFrames);
+        return EXIT_SUCCESS;
+    }
     
     if (SDL_Init( SDL_INIT_VIDEO ) < 0) {
         throw std::runtime_error("SDL failed to initialise (SDL error: " + std::string(SDL_GetError()) + ")");
     }
     
-    directionInputReg = 0x00;
-    buttonInputReg = 0x00;
     tStart = std::chrono::high_resolution_clock::now();
     while (!quit){
         frame();
@@ -49,6 +84,8 @@ bool GBEmulator::start(std::string const& cartridgePath, std::string const& boot
 
 void GBEmulator::finish(){
     if (verbose) cpu.finish();
+    memoryMap.flushSaveFile();
+    writeProfiles();
     quit = true;
 }
 
@@ -59,21 +96,7 @@ void GBEmulator::frame(){
         frameTime = maxFrameDuration;
     }
     uint32_t maxCyclesThisFrame = uint32_t(1e-6 * maxClockFreq * frameTime);
-    while (cyclesSinceLastUpdate < maxCyclesThisFrame){
-        uint16_t cycles = cpu.executeNextOpcode();
-        updateTimers(cycles);
-        gpu.update(cycles);
-        cpu.handleInterrupts(); // 5 M-cycles (per interrupt?)
-        cyclesSinceLastUpdate += cycles;
-
-        // Print serial data, if enabled
-        if (verbose && memoryMap.readByte(0xFF02) == 0x81){
-            char c = memoryMap.readByte(0xFF01);
-            printf("%c", c);
-            memoryMap.writeByte(0xFF02, 0x00);
-        }
-    }
-    cyclesSinceLastUpdate -= maxCyclesThisFrame;
+    emulate(maxCyclesThisFrame);
     gpu.render();
     SDL_Event event;
     while (SDL_PollEvent(&event)){
@@ -81,6 +104,121 @@ void GBEmulator::frame(){
     }
     cpu.processInput(buttonInputReg, directionInputReg);
     tStart = tNow;
+    ++stats.frames;
+    checkpoint();
+}
+
+// Runs fixed-length frames as fast as possible without creating a window, then prints statistics
+void GBEmulator::runHeadless(unsigned int frames){
+    auto const tBegin = std::chrono::high_resolution_clock::now();
+    for (unsigned int i = 0 ; i < frames ; ++i){
+        emulate(cyclesPerFrame);
+        cpu.processInput(buttonInputReg, directionInputReg);
+        ++stats.frames;
+        checkpoint();
+    }
+    auto const tEnd = std::chrono::high_resolution_clock::now();
+    if (verbose) cpu.finish();
+    memoryMap.flushSaveFile();
+    printStats(std::chrono::duration<double>(tEnd - tBegin).count());
+    writeProfiles();
+}
+
+// Save RAM reaches the OS as soon as it is written, so only a crash of the whole system could lose it - flushing it
+// every few seconds bounds how much that could lose, without slowing down writes
+void GBEmulator::checkpoint(){
+    if (stats.frames % saveInterval == 0){
+        memoryMap.flushSaveFile();
+    }
+}
+
+// Steps the CPU, timers and GPU until maxCycles have elapsed (any overshoot is carried into the next call)
+// The timers and GPU are updated after each batch of instructions, which is equivalent to updating them after
+// every instruction as batches end at the next event and before any instruction which could observe the difference
+void GBEmulator::emulate(uint32_t maxCycles){
+    try{
+        while (cyclesSinceLastUpdate < maxCycles){
+            uint32_t const remainingCycles = maxCycles - cyclesSinceLastUpdate;
+            uint16_t cycles = cpu.isHalted() ? skipHalt(remainingCycles) : skipIdleLoop(remainingCycles);
+            if (cycles == 0){
+                // Run as many instructions as possible before the timers and GPU must be updated
+                uint32_t const cyclesUntilEvent = std::min({gpu.cyclesUntilModeChange(), memoryMap.cyclesUntilTimerEvent(), maxBatchCycles,
+                                                            cpu.cyclesUntilGuestSample()});
+                cycles = cpu.run(remainingCycles, cyclesUntilEvent);
+            }
+            if (cycles == 0){
+                cycles = cpu.executeNextOpcode();
+            }
+            cpu.sampleGuest(cycles);
+            updateTimers(cycles);
+            gpu.update(cycles);
+            cpu.handleInterrupts(); // 5 M-cycles (per interrupt?)
+            cyclesSinceLastUpdate += cycles;
+        }
+    }
+    catch (...){
+        // Show what the CPU was running when things went wrong
+        if (InstructionTrace::enabled){
+            std::cout << "\nInstruction trace:\n";
+            cpu.printTrace();
+            std::cout << "\n";
+        }
+        throw;
+    }
+    cyclesSinceLastUpdate -= maxCycles;
+    stats.cycles += maxCycles;
+}
+
+// A halted CPU only wakes on an interrupt, which can only be requested by the GPU changing mode or by
+// a timer event, so skip straight to the earliest of these rather than stepping 4 cycles at a time
+// The skip is rounded up to whole HALT steps so that the result is identical to stepping
+uint16_t GBEmulator::skipHalt(uint32_t maxCycles){
+    uint32_t cycles = std::min({gpu.cyclesUntilModeChange(), memoryMap.cyclesUntilTimerEvent(), maxCycles, maxHaltSkip});
+    cycles = std::max((cycles + 3) & ~3u, 4u);
+    stats.haltCyclesSkipped += cycles - 4;
+    return cycles;
+}
+
+// An idle loop polls memory which cannot change before the next GPU mode change, timer event or input
+// update (at the end of the frame), so skip as many whole iterations as complete before the earliest of these
+// This is only valid if the previous iteration also ran without any of these happening, as otherwise
+// it may have read the old value
+// Returns 0 if the CPU is not in an idle loop, or no iterations can be skipped
+uint16_t GBEmulator::skipIdleLoop(uint32_t maxCycles){
+    uint16_t const iterationCycles = cpu.getIdleLoopCycles();
+    if (iterationCycles == 0){
+        return 0;
+    }
+    uint64_t const now = stats.cycles + cyclesSinceLastUpdate;
+    uint32_t const cyclesUntilEvent = std::min({gpu.cyclesUntilModeChange(), memoryMap.cyclesUntilTimerEvent(), maxCycles, maxIdleLoopSkip});
+    bool const unchanged = lastIdleLoop.cycle + iterationCycles == now && lastIdleLoop.cyclesUntilEvent > iterationCycles;
+    lastIdleLoop = {now, cyclesUntilEvent};
+    if (!unchanged || cyclesUntilEvent == 0){
+        return 0;
+    }
+    uint16_t const cycles = (cyclesUntilEvent - 1) / iterationCycles * iterationCycles;
+    stats.idleLoopCyclesSkipped += cycles;
+    return cycles;
+}
+
+void GBEmulator::printStats(double hostSeconds) const{
+    double const emulatedSeconds = double(stats.cycles) / maxClockFreq;
+    std::cout << std::dec << "\n**STATS**\n";
+    std::cout << "\tStartup time: " << 1000.0 * stats.startupSeconds << " ms\n";
+    std::cout << "\tFrames: " << stats.frames << "\n";
+    std::cout << "\tEmulated time: " << emulatedSeconds << " s\n";
+    std::cout << "\tHost time: " << hostSeconds << " s (" << emulatedSeconds / hostSeconds << "x real time)\n";
+    std::cout << "\tHALT cycles skipped: " << stats.haltCyclesSkipped << " (" << 100.0 * stats.haltCyclesSkipped / stats.cycles << "%)\n";
+    std::cout << "\tIdle loop cycles skipped: " << stats.idleLoopCyclesSkipped << " (" << 100.0 * stats.idleLoopCyclesSkipped / stats.cycles << "%)\n";
+}
+
+void GBEmulator::writeProfiles() const{
+    if (ExecutionProfiler::enabled){
+        cpu.reportProfile(profilePath);
+    }
+    if (guestProfilePath.length() != 0){
+        cpu.writeGuestProfile(guestProfilePath);
+    }
 }
 
 void GBEmulator::updateTimers(uint16_t cycles){
@@ -0,0 +1,105 @@
+#include "..\inc\file_image.h"
+
+#include <fstream>
+#include <filesystem>
+#include <algorithm>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+FileImage::~FileImage(){
+    unmap();
+}
+
+bool FileImage::open(std::string const& path, std::size_t size){
+    std::error_code error;
+    std::size_t const fileSize = std::filesystem::file_size(path, error);
+    if (error || size == 0){
+        return false;
+    }
+    unmap();
+    buffer.clear();
+    imageSize = size;
+    return map(path, std::min(fileSize, size)) || read(path, std::min(fileSize, size));
+}
+
+#ifdef _WIN32
+// Views of a file cannot extend past its end, so padded images are read instead
+bool FileImage::map(std::string const& path, std::size_t fileSize){
+    if (fileSize != imageSize){
+        return false;
+    }
+    HANDLE const file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE){
+        return false;
+    }
+    HANDLE const handle = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    if (!handle){
+        return false;
+    }
+    void* const view = MapViewOfFile(handle, FILE_MAP_READ, 0, 0, imageSize);
+    if (!view){
+        CloseHandle(handle);
+        return false;
+    }
+    mapping = static_cast<uint8_t const*>(view);
+    mappingHandle = handle;
+    return true;
+}
+
+void FileImage::unmap(){
+    if (mapping){
+        UnmapViewOfFile(mapping);
+        CloseHandle(mappingHandle);
+        mapping = nullptr;
+        mappingHandle = nullptr;
+    }
+}
+#else
+// Reserves the whole image as zero pages, then maps the file over the start of it (the rest of the file's last page
+// also reads as zero)
+bool FileImage::map(std::string const& path, std::size_t fileSize){
+    int const file = ::open(path.c_str(), O_RDONLY);
+    if (file < 0){
+        return false;
+    }
+    void* const image = mmap(nullptr, imageSize, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    bool mapped = image != MAP_FAILED;
+    if (mapped && fileSize != 0){
+        mapped = mmap(image, fileSize, PROT_READ, MAP_PRIVATE | MAP_FIXED, file, 0) != MAP_FAILED;
+        if (!mapped){
+            munmap(image, imageSize);
+        }
+    }
+    ::close(file);
+    if (!mapped){
+        return false;
+    }
+    mapping = static_cast<uint8_t const*>(image);
+    return true;
+}
+
+void FileImage::unmap(){
+    if (mapping){
+        munmap(const_cast<uint8_t*>(mapping), imageSize);
+        mapping = nullptr;
+    }
+}
+#endif
+
+bool FileImage::read(std::string const& path, std::size_t fileSize){
+    std::ifstream fileStream(path.c_str(), std::ios_base::binary);
+    if (!fileStream){
+        return false;
+    }
+    buffer.assign(imageSize, 0x00);
+    return bool(fileStream.read(reinterpret_cast<char*>(buffer.data()), fileSize));
+}
\ No newline at end of file
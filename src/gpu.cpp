@@ -6,7 +6,23 @@ uint32_t const static GB_COLOUR_BLACK = 0x000000FF,
                       GB_COLOUR_WHITE = 0xFFFFFFFF;
 std::array<uint32_t, 4> const static colours = {GB_COLOUR_WHITE, GB_COLOUR_LIGHT, GB_COLOUR_DARK, GB_COLOUR_BLACK};
 
-GPU::GPU(MemoryMap& memMap, CPU& proc) : memoryMap{memMap}, cpu{proc}, clock{0}{
+GPU::GPU(MemoryMap& memMap, CPU& proc) : memoryMap{memMap}, cpu{proc}, clock{0}, tileCache{memMap}{
+    framebuffer = std::vector<uint8_t>(winHeight * winWidth, 3); // Black
+    completedFrame = framebuffer;
+    // Keep the decoded registers up to date with the CPU's writes
+    decodeLCDControl(memoryMap.readIO(IORegister::LCDC));
+    lcd.mode = memoryMap.readIO(IORegister::STAT) & 0b11;
+    memoryMap.addIOListener(IORegister::LCDC, [this](uint8_t value){ decodeLCDControl(value); });
+    memoryMap.addIOListener(IORegister::STAT, [this](uint8_t value){ lcd.mode = value & 0b11; });
+    std::array<std::pair<IORegister, uint8_t LCDRegisters::*>, 7> constexpr registers = {{
+        {IORegister::SCY, &LCDRegisters::scrollY}, {IORegister::SCX, &LCDRegisters::scrollX}, {IORegister::BGP, &LCDRegisters::bgPalette},
+        {IORegister::OBP0, &LCDRegisters::objPalette0}, {IORegister::OBP1, &LCDRegisters::objPalette1}, {IORegister::WY, &LCDRegisters::winY},
+        {IORegister::WX, &LCDRegisters::winXPlusSeven}
+    }};
+    for (auto const& [reg, field] : registers){
+        lcd.*field = memoryMap.readIO(reg);
+        memoryMap.addIOListener(reg, [this, field](uint8_t value){ lcd.*field = value; });
+    }
 }
 
 void GPU::initialiseRenderer(SDL_Window* win){
@@ -18,26 +34,26 @@ void GPU::initialiseRenderer(SDL_Window* win){
     SDL_SetRenderDrawColor(renderer, 0, 0, 0, SDL_ALPHA_OPAQUE);
 
     if (!texture) throw std::runtime_error("Failed to create SDL texture");
-
-    LCDtexture = std::vector<uint32_t>(winHeight * winWidth, GB_COLOUR_BLACK);
-    framebuffer = LCDtexture;
-    bgBuffer = LCDtexture;
-
 }
 
 void GPU::update(uint16_t cycles){
 
     // DMA clock update
 
-    if (LCDEnabled())
+    if (lcd.LCDEnabled)
     {
         clock += cycles;
-        /* while(clock >= scanlineOAMDuration) */{
+        // Natively compiled blocks report several hundred cycles at once, so keep
+        // changing mode until the clock has caught up
+        bool modeChanged = true;
+        while (modeChanged){
+            modeChanged = false;
             switch(getMode()){ // Issue: consider using enum for the four modes. Durations can be in an array
                 // Horizontal blank
                 case 0:
                     if (clock >= hBlankDuration){
                         clock -= hBlankDuration;
+                        modeChanged = true;
                         if (incrementCurrentLine() == winHeight){ // is this right? check panDocs
                             setMode(1);
                             pushFrame();
@@ -54,6 +70,7 @@ void GPU::update(uint16_t cycles){
                 case 1:
                     if (clock >= cyclesPerLine){
                         clock -= cyclesPerLine;
+                        modeChanged = true;
                         if (incrementCurrentLine() == winHeight + linesInVBlank){
                             setMode(2);
                             resetCurrentLine();
@@ -65,6 +82,7 @@ void GPU::update(uint16_t cycles){
                 case 2:
                     if (clock >= scanlineOAMDuration){
                         clock -= scanlineOAMDuration;
+                        modeChanged = true;
                         setMode(3);
                     }
                     break;
@@ -72,6 +90,7 @@ void GPU::update(uint16_t cycles){
                 case 3:
                     if (clock >= scanlineVRAMDuration){
                         clock -= scanlineVRAMDuration;
+                        modeChanged = true;
                         setMode(0);
                         drawScanline();
                         cpu.requestInterrupt(1); // request LCD interrupt   
@@ -86,13 +105,44 @@ void GPU::update(uint16_t cycles){
     }
 }
 
+// Cycles until the next mode (or line, during vertical blank) change, which is the
+// earliest the GPU can next request an interrupt
+uint32_t GPU::cyclesUntilModeChange() const{
+    if (!lcd.LCDEnabled){
+        return std::numeric_limits<uint32_t>::max();
+    }
+    uint16_t duration;
+    switch(getMode()){
+        case 0:
+            duration = hBlankDuration;
+            break;
+        case 1:
+            duration = cyclesPerLine;
+            break;
+        case 2:
+            duration = scanlineOAMDuration;
+            break;
+        default:
+            duration = scanlineVRAMDuration;
+            break;
+    }
+    return clock >= duration ? 0 : duration - clock;
+}
+
 void GPU::render(){
-    // Draw LCDtexture to screen
-    uint32_t *lockedPixels = nullptr; // needed?
-    int pitch; // needed?
+    if (!renderer){
+        return;
+    }
+    // Expand the last complete frame to colours, straight into the texture
+    uint32_t *lockedPixels = nullptr;
+    int pitch = 0;
     SDL_RenderClear(renderer);
-    SDL_LockTexture(texture, nullptr, (void **)&lockedPixels, &pitch);
-    std::copy_n(LCDtexture.data(), LCDtexture.size(), lockedPixels);
+    if (SDL_LockTexture(texture, nullptr, (void **)&lockedPixels, &pitch) != 0){
+        throw std::runtime_error("Failed to lock SDL texture (SDL error: " + std::string(SDL_GetError()) + ")");
+    }
+    for (uint8_t y = 0 ; y < winHeight ; ++y){
+        kernels->applyPalette(completedFrame.data() + winWidth * y, winWidth, colours, lockedPixels + y * (pitch / sizeof(uint32_t)));
+    }
     SDL_UnlockTexture(texture);
 
     SDL_RenderCopy(renderer, texture, nullptr, nullptr);
@@ -112,202 +162,118 @@ void GPU::render(){
 // WindowY: 0xFF4A
 // WindowX + 7: 0xFF4B
 
-bool GPU::LCDEnabled() const{
-    HalfRegister temp = memoryMap.readByte(LCDControlRegAddress);
-    return temp.testBit(7);
-}
-
-// Determines which background map to use for window rendering
-// Unset: 0x9800 tilemap used
-// Set: 0x9C00 tilemap used
-bool GPU::windowTileMapArea() const{
-    HalfRegister temp = memoryMap.readByte(LCDControlRegAddress);
-    return temp.testBit(6);
-}
-
-// Determines whether window is displayed
-bool GPU::windowEnabled() const{
-    HalfRegister temp = memoryMap.readByte(LCDControlRegAddress);
-    return temp.testBit(5);
-}
-
-// Controls addressing mode for bg and window
-// Unset ???
-// Set: ???
-bool GPU::bgWindowTileDataArea() const{
-    HalfRegister temp = memoryMap.readByte(LCDControlRegAddress);
-    return temp.testBit(4);
-}
-
-// Determines which map used for bg rendering
-// Unset: 0x9800
-// Set: 0x9C00
-bool GPU::bgTileMapArea() const{
-    HalfRegister temp = memoryMap.readByte(LCDControlRegAddress);
-    return temp.testBit(3);
-}
-
-// Unset: ???
-// Set: ???
-bool GPU::objSize() const{
-    HalfRegister temp = memoryMap.readByte(LCDControlRegAddress);
-    return temp.testBit(2);
-}
-
-// Controls whether objects are displayed
-bool GPU::objEnabled() const{
-    HalfRegister temp = memoryMap.readByte(LCDControlRegAddress);
-    return temp.testBit(1);
-}
-
-// Controls whether bg and window are displayed
-bool GPU::bgEnabled() const{
-    HalfRegister temp = memoryMap.readByte(LCDControlRegAddress);
-    return temp.testBit(0);
+// Decodes the LCD registers as the CPU writes them
+// LCDC bits, from 7 to 0: LCD enabled, window tile map (0x9800 or 0x9C00), window enabled, bg and window tile data
+// (signed from 0x9000 or unsigned from 0x8000), bg tile map (0x9800 or 0x9C00), 8x16 objects, objects enabled and bg
+// and window enabled
+void GPU::decodeLCDControl(uint8_t value){
+    HalfRegister const temp = value;
+    lcd.LCDEnabled = temp.testBit(7);
+    lcd.windowTileMapArea = temp.testBit(6);
+    lcd.windowEnabled = temp.testBit(5);
+    lcd.bgWindowTileDataArea = temp.testBit(4);
+    lcd.bgTileMapArea = temp.testBit(3);
+    lcd.objSize = temp.testBit(2);
+    lcd.objEnabled = temp.testBit(1);
+    lcd.bgEnabled = temp.testBit(0);
 }
 
 uint8_t GPU::getMode() const{
-    return memoryMap.readByte(LCDControlRegAddress + 1) & 0b11;
+    return lcd.mode;
 }
 
 void GPU::setMode(uint8_t mode){
-    HalfRegister temp = memoryMap.readByte(LCDControlRegAddress + 1);
+    lcd.mode = mode & 0b11;
+    HalfRegister temp = memoryMap.readIO(IORegister::STAT);
     temp &= ~(0b11);
-    temp += mode & 0b11;
-    memoryMap.writeByte(LCDControlRegAddress + 1, temp);
+    temp += lcd.mode;
+    memoryMap.writeIO(IORegister::STAT, temp);
 }
 
 /*
 There are 384 8x8 (16B) tiles stored at addresses 0x8000-0x97FF
-Colours are 2-bit, with 0b00 == white, or transparent for objects (sprites)
-We use two pixel buffers, one for the bg/window, and one for objects
+Colours are 2-bit indices, which a palette maps to one of four shades (0 == white), or transparent for objects (sprites)
+The framebuffer holds shades, and is only expanded to colours when displayed
 */
 
-// Draw a single line to framebuffer (does not get displayed until hBlank)
-// First draw bg and window to bgBuffer
-// Then determine obj pixels, and composite with bgBuffer into framebuffer
+// Draw a single line to framebuffer (does not get displayed until vBlank)
+// First draw the bg and window colour indices to bgIndices, and shade them into framebuffer
+// Then draw objects over them, where bgIndices allows
 void GPU::drawScanline(){
+    uint8_t const line = getCurrentLine();
+    tileCache.update();
     drawBgScanline();
-    if(windowEnabled() && bgEnabled()){
+    if(lcd.windowEnabled && lcd.bgEnabled){
         drawWindowScanline();
     }
-    // Copy current line of bg buffer into framebuffer
-    std::copy(bgBuffer.begin() + winWidth * getCurrentLine(), bgBuffer.begin()  + winWidth * (getCurrentLine() + 1), framebuffer.begin() + winWidth * getCurrentLine());
-    if(objEnabled()){
+    std::array<uint8_t, 4> palette;
+    fillPalette(palette, lcd.bgEnabled ? lcd.bgPalette : 0x00); // All white while the bg is disabled
+    kernels->applyShades(bgIndices.data(), winWidth, palette, framebuffer.data() + winWidth * line);
+    if(lcd.objEnabled){
         drawObjScanline();
     }
 }
 
-void GPU::fillPalette(std::array<uint32_t, 4>& pal, uint16_t data){
+void GPU::fillPalette(std::array<uint8_t, 4>& pal, uint8_t data){
     for (int i = 0 ; i < 4 ; ++i){
-            pal[i] = colours[(data >> (2 * i)) & 0b11];
+            pal[i] = (data >> (2 * i)) & 0b11;
         }
 }  
 
-uint8_t GPU::getPaletteIndex(uint16_t tileDataAddress, uint8_t bit) const{
-    HalfRegister b1 = memoryMap.readByte(tileDataAddress);
-    HalfRegister b2 = memoryMap.readByte(tileDataAddress + 1);
-    HalfRegister pLow = b1.testBit(bit) ? 0x01 : 0x00;
-    HalfRegister pHigh = b2.testBit(bit) ? 0x02 : 0x00;
-    return pLow + pHigh;
+std::array<uint32_t, 4> const& GPU::getColours(){
+    return colours;
+}
+
+// Bg and window tile indices are unsigned from 0x8000 (tile 0), or signed from 0x9000 (tile 256)
+uint16_t GPU::getBgTile(uint8_t tileIndex) const{
+    return lcd.bgWindowTileDataArea ? tileIndex : 256 + static_cast<int8_t>(tileIndex);
 }
 
 void GPU::drawBgScanline(){
-    if(!bgEnabled()){
-        // Draw all white pixels if bg disabled
-        for (auto it = bgBuffer.begin() + winWidth * getCurrentLine(); it != bgBuffer.begin()  + winWidth * (getCurrentLine() + 1) ; ++it){
-            *it = GB_COLOUR_WHITE;
-        }
+    uint8_t const line = getCurrentLine();
+    if(!lcd.bgEnabled){
+        // Nothing is drawn if bg disabled, so objects are never behind it
+        bgIndices.fill(0);
     }
     else{
-        // Set addresses for the starts of the tile map and tile map data area respectively
-        uint16_t const tileMapAddress = bgTileMapArea() ? 0x9C00 : 0x9800;
-        uint16_t const tileMapDataAddress = bgWindowTileDataArea() ? 0x8000 : 0x9000;
+        // Set address for the start of the tile map
+        uint16_t const tileMapAddress = lcd.bgTileMapArea ? 0x9C00 : 0x9800;
         // Get tile y tile index and y pos within tile (same for all tiles in scanline)
         // Unlike the window, the bg has a wrapping tilemap, so index is modulo tileMapWidth
-        uint8_t const tileYIndex = ((getCurrentLine() + getScrollY()) / tileWidthInPixels) % tileMapWidth;
-        uint8_t const tileYPos = (getCurrentLine() + getScrollY()) % tileWidthInPixels;
-        // Load colour palette
-        std::array<uint32_t, 4> palette;
-        fillPalette(palette, getBgPalette());
-        // Draw each pixel in the scanline
-        auto it = bgBuffer.begin() + winWidth * getCurrentLine();
-        for (int x = 0 ; x < winWidth ; ++x, ++it){
-            uint8_t const tileXIndex = ((x + getScrollX()) / tileWidthInPixels) % tileMapWidth;
+        uint8_t const tileYIndex = ((line + lcd.scrollY) / tileWidthInPixels) % tileMapWidth;
+        uint8_t const tileYPos = (line + lcd.scrollY) % tileWidthInPixels;
+        // Copy a row of each tile which is at least partly on screen, then keep those from the scroll within the first
+        uint8_t tileXIndex = lcd.scrollX / tileWidthInPixels;
+        for (uint8_t tile = 0 ; tile < tilesPerLine ; ++tile, tileXIndex = (tileXIndex + 1) % tileMapWidth){
             uint8_t const tileIndex = memoryMap.readByte(tileMapAddress + tileMapWidth * tileYIndex + tileXIndex);
-
-            uint16_t tileDataAddress = tileMapDataAddress;
-            if(bgWindowTileDataArea()){
-                // Unsigned tile index (starting from 0x8000)
-                tileDataAddress += tileIndex * tileSizeInBytes;
-            }
-            else{
-                // Signed tile index (centred on 0x9000)
-                tileDataAddress += static_cast<int8_t>(tileIndex) * tileSizeInBytes;
-            }
-            tileDataAddress += uint16_t(tileYPos * 2);
-            uint8_t bit = 7 - ((getScrollX() + x) % 8);
-            /* HalfRegister b1 = memoryMap.readByte(tileDataAddress);
-            HalfRegister b2 = memoryMap.readByte(tileDataAddress + 1);
-
-            HalfRegister bit = 7 - ((getScrollX() + x) % 8);
-            HalfRegister pLow = b1.testBit(bit) ? 0x01 : 0x00;
-            HalfRegister pHigh = b2.testBit(bit) ? 0x02 : 0x00;
-
-            *it = palette[pLow + pHigh]; */
-           *it = palette[getPaletteIndex(tileDataAddress, bit)];
+            std::copy_n(tileCache.getRow(getBgTile(tileIndex), tileYPos), tileWidthInPixels, lineIndices.begin() + tileWidthInPixels * tile);
         }
+        std::copy_n(lineIndices.begin() + lcd.scrollX % tileWidthInPixels, winWidth, bgIndices.begin());
     }
 }
 
 void GPU::drawWindowScanline(){
+    uint8_t const line = getCurrentLine();
     // If scanline is above window, no drawing required (y=0 is top of screen)
-    int8_t const winYPos = getCurrentLine() - getWinY();
-    if (winYPos < 0) return;
-    int8_t const winXPos = getWinXPlusSeven() - 7;
-    // Set addresses for the starts of the tile map and tile map data area respectively
-    uint16_t const tileMapAddress = windowTileMapArea() ? 0x9C00 : 0x9800;
-    uint16_t const tileMapDataAddress = bgWindowTileDataArea() ? 0x8000 : 0x9000;
+    int const winYPos = line - lcd.winY;
+    int const winXPos = lcd.winXPlusSeven - 7;
+    if (winYPos < 0 || winXPos >= winWidth) return;
+    // Set address for the start of the tile map
+    uint16_t const tileMapAddress = lcd.windowTileMapArea ? 0x9C00 : 0x9800;
     // Get tile y tile index and y pos within tile (same for all tiles in scanline)
     uint8_t const tileYIndex = winYPos / tileWidthInPixels;
     uint8_t const tileYPos = winYPos % tileWidthInPixels;
-    // Load colour palette
-    std::array<uint32_t, 4> palette;
-    fillPalette(palette, getBgPalette());
-    // Draw each window pixel in the scanline
-    auto it = bgBuffer.begin() + winWidth * getCurrentLine();
-    for (int x = 0 ; x < winWidth ; ++x, ++it){
-        if (x < winXPos) continue;
-        uint8_t const tileXIndex = ((x - winXPos) / tileWidthInPixels);
+    // Copy a row of each window tile from the window's left edge, then keep those on screen
+    int const start = std::max(winXPos, 0);
+    for (uint8_t tileXIndex = 0 ; tileXIndex * tileWidthInPixels < winWidth - winXPos ; ++tileXIndex){
         uint8_t const tileIndex = memoryMap.readByte(tileMapAddress + tileMapWidth * tileYIndex + tileXIndex);
-
-        uint16_t tileDataAddress = tileMapDataAddress;
-        if(bgWindowTileDataArea()){
-            // Unsigned tile index (starting from 0x8000)
-            tileDataAddress += tileIndex * tileSizeInBytes;
-        }
-        else{
-            // Signed tile index (centred on 0x9000)
-            tileDataAddress += static_cast<int8_t>(tileIndex) * tileSizeInBytes;
-        }
-        tileDataAddress += uint16_t(tileYPos * 2);
-        /* HalfRegister b1 = memoryMap.readByte(tileDataAddress);
-        HalfRegister b2 = memoryMap.readByte(tileDataAddress + 1); */
-
-        HalfRegister bit = 7 - (x % 8);
-        /* HalfRegister pLow = b1.testBit(bit) ? 0x01 : 0x00;
-        HalfRegister pHigh = b2.testBit(bit) ? 0x02 : 0x00;
-
-        *it = palette[pLow + pHigh]; */
-
-        *it = palette[getPaletteIndex(tileDataAddress, bit)];
+        std::copy_n(tileCache.getRow(getBgTile(tileIndex), tileYPos), tileWidthInPixels, lineIndices.begin() + tileWidthInPixels * tileXIndex);
     }
+    std::copy_n(lineIndices.begin() + start - winXPos, winWidth - start, bgIndices.begin() + start);
 }
 
 void GPU::drawObjScanline(){
-    // Load colour palette
-    std::array<uint32_t, 4> bgPalette;
-    fillPalette(bgPalette, getBgPalette());
+    uint8_t const line = getCurrentLine();
     // Iterate over OAM from last sprite to first
     // Each sprite consists of four bytes:
     //  0: y Pos + 16
@@ -322,35 +288,30 @@ void GPU::drawObjScanline(){
     for (uint16_t objOAMAddress = OAMAddress + objOAMSizeInBytes * (numberOfObjs - 1) ; objOAMAddress >= OAMAddress ; objOAMAddress -= objOAMSizeInBytes){
         uint8_t const objY = memoryMap.readByte(objOAMAddress + 0) - 16;
         uint8_t const objWidth = 8;
-        uint8_t const objHeight = objSize() ? 2 * objWidth : objWidth;
+        uint8_t const objHeight = lcd.objSize ? 2 * objWidth : objWidth;
 
-        if ((objY <= getCurrentLine()) && (objY + objHeight > getCurrentLine())){
+        if ((objY <= line) && (objY + objHeight > line)){
             uint8_t const objX = memoryMap.readByte(objOAMAddress + 1) - 8;
             uint8_t tileIndex = memoryMap.readByte(objOAMAddress + 2);
             // In 8x16 mode, this is index of 'top' 8x8 tile in the sprite
-            if (objSize()){
+            if (lcd.objSize){
                 tileIndex &= 0xFE;
             }
             HalfRegister const objAttributes = memoryMap.readByte(objOAMAddress + 3);
-            std::array<uint32_t, 4> objPalette;
-            fillPalette(objPalette, !objAttributes.testBit(4) ? getObjPalette0() : getObjPalette1());
-            objPalette[0] = 0; // First entry is transparent
+            std::array<uint8_t, 4> objPalette;
+            fillPalette(objPalette, !objAttributes.testBit(4) ? lcd.objPalette0 : lcd.objPalette1);
 
-            uint16_t tileMapDataAddress = 0x8000 + objTileSizeInBytes * tileIndex;
-            uint8_t const tileYPos = objAttributes.testBit(6) ?  (objHeight - 1) - (getCurrentLine() - objY): getCurrentLine() - objY; // y pos w/in tile may be mirrored
-            tileMapDataAddress += 2 * tileYPos;
+            uint8_t const tileYPos = objAttributes.testBit(6) ?  (objHeight - 1) - (line - objY): line - objY; // y pos w/in tile may be mirrored
+            // Objects always use unsigned tile indices, and the row may be in the lower tile of an 8x16 object
+            uint8_t const* const row = tileCache.getRow(tileIndex + tileYPos / tileWidthInPixels, tileYPos % tileWidthInPixels, objAttributes.testBit(5));
 
             for (int i = 0 ; i < objWidth ; ++i){
                 int pixelX = objX + i;
-                if (pixelX >= 0 && pixelX <= winWidth){
-                    uint8_t const tileXPos = objAttributes.testBit(5) ? i : tileWidthInPixels - 1 - i; // x pos w/in tile may be mirrored
-
-                    uint8_t colourValue = getPaletteIndex(tileMapDataAddress, tileXPos);
-
-                    if (colourValue > 0){
-                        uint16_t index = getCurrentLine() * winWidth + pixelX;
-                        if(objAttributes.testBit(7) || bgBuffer[index] == bgPalette[0]){//|| !(bgBuffer[index] && 0x000000FF)){
-                            framebuffer[index] = objPalette[colourValue];
+                if (pixelX >= 0 && pixelX < winWidth){
+                    uint8_t const colourValue = row[i];
+                    if (colourValue > 0){ // Colour 0 is transparent
+                        if(!objAttributes.testBit(7) || bgIndices[pixelX] == 0){
+                            framebuffer[line * winWidth + pixelX] = objPalette[colourValue];
                         }
                     }
                 }
@@ -359,9 +320,14 @@ void GPU::drawObjScanline(){
     }
 }
 
+void GPU::setPixelKernels(PixelKernels const& pixelKernels){
+    kernels = &pixelKernels;
+    tileCache.setKernels(pixelKernels);
+}
+
 void GPU::pushFrame(){
-    // Push framebuffer to LCDtexture to be rendered to window by render()
-    LCDtexture = framebuffer;
+    // Keep the complete frame to be rendered to window by render()
+    completedFrame = framebuffer;
 }
 
 // Issue: consider combining below functions - possible enum?
@@ -369,47 +335,19 @@ void GPU::pushFrame(){
     return readByte(LCDControlRegAddress + ENUM);
 } */
 
-uint8_t GPU::getScrollY() const{
-    return memoryMap.readByte(LCDControlRegAddress + 2);
-}
-
-uint8_t GPU::getScrollX() const{
-    return memoryMap.readByte(LCDControlRegAddress + 3);
-}
-
 void GPU::resetCurrentLine(){
-    memoryMap.writeByte(LCDControlRegAddress + 4, 0);
+    memoryMap.writeIO(IORegister::LY, 0);
 }
 
 uint8_t GPU::getCurrentLine() const{
-    return memoryMap.readByte(LCDControlRegAddress + 4);
+    return memoryMap.readIO(IORegister::LY);
 }
 
 uint8_t GPU::incrementCurrentLine(){
     uint8_t temp = getCurrentLine();
-    memoryMap.writeByte(LCDControlRegAddress + 4, ++temp);
+    memoryMap.writeIO(IORegister::LY, ++temp);
     return temp;
 }
 
 // ...
 
-uint8_t GPU::getBgPalette() const{
-    return memoryMap.readByte(LCDControlRegAddress + 7);
-}
-
-uint8_t GPU::getObjPalette0() const{
-    return memoryMap.readByte(LCDControlRegAddress + 8);
-}
-
-uint8_t GPU::getObjPalette1() const{
-    return memoryMap.readByte(LCDControlRegAddress + 9);
-}
-
-uint8_t GPU::getWinY() const{
-    return memoryMap.readByte(LCDControlRegAddress + 0xA);
-}
-
-uint8_t GPU::getWinXPlusSeven() const{
-    return memoryMap.readByte(LCDControlRegAddress + 0xB);
-}
-
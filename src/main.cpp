@@ -5,6 +5,8 @@
 #include <SDL_main.h>
 
 #include "..\inc\test.h"
+#include "..\inc\benchmark.h"
+#include "..\inc\trace_file.h"
 
 /* 
 Command line arguments (can be used in any order, surplus args ignored)
@@ -13,21 +15,54 @@ Command line arguments (can be used in any order, surplus args ignored)
 
 *OPTIONAL* -b [path]: set the path to the boot program
 
-*OPTIONAL* -v: verbose printing mode (ASCII chars output via serial port, PC and opcodes at exit)
+*OPTIONAL* -v: verbose printing mode (ASCII chars output via serial port, PC and, if built with -DGB_EMU_TRACE,
+          the most recent instructions at exit)
+
+*OPTIONAL* --cpu=[interp|jit|diff]: CPU engine - interpreter (default), native code for hot ROM blocks,
+           or native code checked against the interpreter after every block
+
+*OPTIONAL* --headless=[frames]: run the given number of frames as fast as possible without a window,
+           then print statistics
+
+*OPTIONAL* --trace=[path]: write every instruction executed to a binary trace file (requires a build with -DGB_EMU_TRACE)
+
+*OPTIONAL* --profile=[path]: write the opcode profile to a CSV file on exit, rather than printing it (requires a build
+           with -DGB_EMU_PROFILE)
+
+*OPTIONAL* --guest-profile=[path]: sample where the cartridge program spends its time, writing folded call stacks
+           (as read by flamegraph tools) on exit
+
+*OPTIONAL* --sym=[path]: name code in the guest profile after the symbols in an RGBDS .sym file
+
+*OPTIONAL* --trace-diff [path] [path]: report the first instruction at which two trace files differ (ignores other args)
 
 *OPTIONAL* -test: run tests (ignores other args)
+
+*OPTIONAL* -p: run performance benchmarks (ignores other args)
  */
 
 int main(int argc, char** argv){
     try{
         std::vector<std::string> arguments(argv + 1, argv + argc);
-        std::string cartridgePath, bootPath;
+        std::string cartridgePath, bootPath, tracePath, profilePath, guestProfilePath, symbolPath;
         bool printSerial = false;
+        CPUEngine engine = CPUEngine::interpreter;
+        unsigned int headlessFrames = 0;
         for(auto arg = arguments.begin() ; arg != arguments.end() ; ++arg){
             if (strcmp(arg->c_str(), "-t") == 0){
                 TestFramework test;
                 return test.start();
             }
+            else if (strcmp(arg->c_str(), "-p") == 0){
+                BenchmarkFramework benchmark;
+                return benchmark.start();
+            }
+            else if (strcmp(arg->c_str(), "--trace-diff") == 0){
+                if (arguments.end() - arg < 3){
+                    throw std::runtime_error("Specify two trace files using '--trace-diff [PATH] [PATH]'");
+                }
+                return TraceReader::diff(*(arg + 1), *(arg + 2)) ? EXIT_SUCCESS : EXIT_FAILURE;
+            }
             else if (strcmp(arg->c_str(), "-i") == 0){
                 if (arg != arguments.end() - 1){
                     ++arg;
@@ -44,9 +79,45 @@ int main(int argc, char** argv){
             {
                 printSerial = true;
             }
+            else if (arg->rfind("--cpu=", 0) == 0){
+                std::string const engineName = arg->substr(6);
+                if (engineName == "interp"){
+                    engine = CPUEngine::interpreter;
+                }
+                else if (engineName == "jit"){
+                    engine = CPUEngine::jit;
+                }
+                else if (engineName == "diff"){
+                    engine = CPUEngine::differential;
+                }
+                else{
+                    throw std::runtime_error("Unknown CPU engine '" + engineName + "' (expected interp, jit or diff)");
+                }
+            }
+            else if (arg->rfind("--trace=", 0) == 0){
+                tracePath = arg->substr(8);
+            }
+            else if (arg->rfind("--profile=", 0) == 0){
+                profilePath = arg->substr(10);
+            }
+            else if (arg->rfind("--guest-profile=", 0) == 0){
+                guestProfilePath = arg->substr(16);
+            }
+            else if (arg->rfind("--sym=", 0) == 0){
+                symbolPath = arg->substr(6);
+            }
+            else if (arg->rfind("--headless=", 0) == 0){
+                std::string const frames = arg->substr(11);
+                char* end;
+                headlessFrames = std::strtoul(frames.c_str(), &end, 10);
+                if (*end != '\0' || headlessFrames == 0){
+                    throw std::runtime_error("Invalid headless frame count '" + frames + "'");
+                }
+            }
         }
         GBEmulator emulator;
-        return emulator.start(cartridgePath, bootPath, printSerial);  
+        return emulator.start(cartridgePath, bootPath, printSerial, engine, headlessFrames, tracePath, profilePath,
+                               guestProfilePath, symbolPath);  
     }
     catch (const std::runtime_error& exception){
         std::cout << "\nException thrown: " << exception.what();
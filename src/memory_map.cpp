@@ -2,21 +2,82 @@
 
 uint16_t constexpr static UPPER_BYTEMASK = 0xFF00;
 uint16_t constexpr static LOWER_BYTEMASK = 0x00FF;
+uint16_t constexpr static INTERRUPT_FLAG_ADDRESS = ioAddress(IORegister::IF);
+uint16_t constexpr static INTERRUPT_ENABLE_ADDRESS = 0xFFFF;
 
-MemoryMap::MemoryMap() : memory(0x10000, 0x00), bootMemory(0x100, 0x00), directionInputReg{0x00}, buttonInputReg{0x00}, 
+MemoryMap::MemoryMap() : memory(0x10000, 0x00), bootProgram{std::make_shared<FileImage const>(0x100)}, directionInputReg{0x00}, buttonInputReg{0x00}, 
     timer{.dividerCycles = timer.dividerFreq, .counterCycles = timer.counterFreq[timer.counterFreqIndex]} {
+    mapPages();
 }
 
-uint8_t MemoryMap::readByte(uint16_t address) const{
+// The page table points into this map's own memory, so is rebuilt rather than copied
+MemoryMap::MemoryMap(MemoryMap const& other) : memory{other.memory}, bootProgram{other.bootProgram}, cartridge{other.cartridge}, directionInputReg{other.directionInputReg},
+    buttonInputReg{other.buttonInputReg}, writeCounts{other.writeCounts}, timer{other.timer}, pendingInterrupts{other.pendingInterrupts},
+    isBooting{other.isBooting}, disableMemMapping{other.disableMemMapping} {
+    mapPages();
+}
+
+MemoryMap& MemoryMap::operator=(MemoryMap const& other){
+    memory = other.memory;
+    bootProgram = other.bootProgram;
+    cartridge = other.cartridge;
+    directionInputReg = other.directionInputReg;
+    buttonInputReg = other.buttonInputReg;
+    writeCounts = other.writeCounts;
+    timer = other.timer;
+    pendingInterrupts = other.pendingInterrupts;
+    isBooting = other.isBooting;
+    disableMemMapping = other.disableMemMapping;
+    mapPages();
+    return *this;
+}
+
+// Maps VRAM and WRAM straight to memory, echo RAM to the WRAM it mirrors and the cartridge's ROM and RAM to the banks
+// selected (see mapBanks) - OAM, the I/O registers, HRAM and IE (and writes to ROM) are left to the handlers
+// With mapping disabled, everything but writes to the last page (for IF and IE) maps straight to memory
+void MemoryMap::mapPages(){
+    for (uint16_t page = 0x00 ; page < 0x100 ; ++page){
+        countedPages[page] = page >= 0xE0 && page < 0xFE && !disableMemMapping ? page - 0x20 : page;
+        uint8_t* const pageMemory = &memory[countedPages[page] << 8];
+        readPages[page] = page < 0xFE || disableMemMapping ? pageMemory : nullptr;
+        writePages[page] = (page >= 0x80 || disableMemMapping) && page < 0xFE ? pageMemory : nullptr;
+    }
     if (disableMemMapping){
-        return memory[address];
+        writePages[0xFE] = &memory[0xFE00];
+    }
+    else{
+        mapBanks();
+    }
+}
+
+// Points the ROM pages at the selected ROM banks and the cartridge RAM pages at the selected RAM bank, which
+// only takes a few dozen stores however large the cartridge is
+// While booting, the first page is the boot program instead
+void MemoryMap::mapBanks(){
+    uint8_t const* const lowerBank = cartridge.getROMBankData(0x0000);
+    uint8_t const* const upperBank = cartridge.getROMBankData(0x4000);
+    for (uint16_t page = 0x00 ; page < 0x40 ; ++page){
+        readPages[page] = lowerBank + (page << 8);
+        readPages[page + 0x40] = upperBank + (page << 8);
     }
-    if (isBooting && (address < 0x0100)){
-        return bootMemory[address];
+    if (isBooting){
+        readPages[0x00] = bootProgram->data();
     }
-    else if (address >= 0xE000 && address < 0xFE00){
-        // Echo RAM
-        return memory[address - 0x2000];
+    std::array<uint8_t const*, 3> const romPages = {readPages[0x00], readPages[0x01], readPages[0x40]};
+    if (romPages != mappedROMPages){
+        mappedROMPages = romPages;
+        ++romBankGeneration;
+    }
+    uint8_t* const ramBank = cartridge.getRAMBankData();
+    for (uint16_t page = 0x00 ; page < 0x20 ; ++page){
+        readPages[0xA0 + page] = ramBank ? ramBank + (page << 8) : nullptr;
+        writePages[0xA0 + page] = ramBank ? ramBank + (page << 8) : nullptr;
+    }
+}
+
+uint8_t MemoryMap::readUnmapped(uint16_t address) const{
+    if (address >= 0xA000 && address < 0xC000){
+        return cartridge.readRAM(address);
     }
     else if (address >= 0xFEA0 && address <= 0xFEFF){
         // throw std::runtime_error("Access violation! Cannot read from [0xFEA0, 0xFEFF]");
@@ -24,19 +85,8 @@ uint8_t MemoryMap::readByte(uint16_t address) const{
         // Some games (including Tetris) use illegal reads/writes as a way to skip cycles!
         return 0x00;
     }
-    else if (address == 0xFF00){
-        // Process input
-        HalfRegister inputSelection = memory[address];
-        HalfRegister inputValue = 0x00;
-        if(!inputSelection.testBit(4)){
-            // D-pad enabled
-            inputValue |= ~directionInputReg;
-        }
-        if(!inputSelection.testBit(5)){
-            // Buttons enabled
-            inputValue |= ~buttonInputReg;
-        }
-        return 0x3F & ((inputSelection | 0x0F) & inputValue);
+    else if (address >= IO_REGISTERS_ADDRESS && address < IO_REGISTERS_ADDRESS + IO_REGISTER_COUNT){
+        return readIORegister(address & 0x7F);
     }
     else{
         return memory[address];
@@ -47,45 +97,112 @@ uint16_t MemoryMap::readWord(uint16_t address) const{
     return  (readByte(address + 1) << 8) | readByte(address);
 }
 
-void MemoryMap::writeByte(uint16_t address, uint8_t value){
+void MemoryMap::writeUnmapped(uint16_t address, uint8_t value){
     if (disableMemMapping){
         memory[address] = value;
+        recordWrite(address);
+        if (address == INTERRUPT_FLAG_ADDRESS || address == INTERRUPT_ENABLE_ADDRESS){
+            updatePendingInterrupts();
+        }
         return;
     }
     if (address < 0x8000){
-        // throw std::runtime_error("Access violation! Cannot write to [0x0000, 0x7FFF]");
+        // ROM cannot be written, but the MBC's registers are
+        cartridge.writeRegister(address, value);
+        mapBanks();
     }
-    else if (address >= 0xE000 && address < 0xFE00){
-        // Echo RAM
-        memory[address - 0x2000] = value;
+    else if (address >= 0xA000 && address < 0xC000){
+        cartridge.writeRAM(address, value);
     }
     else if(address >= 0xFEA0 && address <= 0xFEFF){
         // throw std::runtime_error("Access violation! Cannot write to [0xFEA0, 0xFEFF]");
     }
-    else if (address == 0xFF00){
-        // Input register - only write to bits 4 and 5
-        memory[address] = 0x30 & value; // lower bit info stored in inputRegs
+    else if (address >= IO_REGISTERS_ADDRESS && address < IO_REGISTERS_ADDRESS + IO_REGISTER_COUNT){
+        writeIORegister(address & 0x7F, value);
     }
-    else if (address == 0xFF04){
-        // Attempting to write to divider register clears it
-        memory[address] = 0;
+    else if (address == INTERRUPT_ENABLE_ADDRESS){
+        writeInterruptRegister(0xFF, value);
     }
-    else if (address == 0xFF07){
-        // Only bottom three bits of timer control register are used
-        memory[address] = value & 0x07;
-        setCounterFrequency(value & 0x03);
+    else{
+        memory[address] = value;
+        recordWrite(address);
     }
-    else if (address == 0xFF46){
-        // DMA transfer
-        transferDMA(value);
+}
+
+// Adding a register with side effects means adding its handlers here
+std::array<MemoryMap::IOHandlers, IO_REGISTER_COUNT> const MemoryMap::IO_HANDLERS = []{
+    std::array<IOHandlers, IO_REGISTER_COUNT> handlers{};
+    handlers[uint8_t(IORegister::JOYP)] = {&MemoryMap::readJoypad, &MemoryMap::writeJoypad};
+    handlers[uint8_t(IORegister::DIV)].write = &MemoryMap::writeDivider;
+    handlers[uint8_t(IORegister::TAC)].write = &MemoryMap::writeTimerControl;
+    handlers[uint8_t(IORegister::IF)].write = &MemoryMap::writeInterruptRegister;
+    handlers[uint8_t(IORegister::DMA)].write = &MemoryMap::writeDMA;
+    return handlers;
+}();
+
+uint8_t MemoryMap::readIORegister(uint8_t offset) const{
+    IOReadHandler const handler = IO_HANDLERS[offset].read;
+    return handler ? (this->*handler)(offset) : memory[IO_REGISTERS_ADDRESS | offset];
+}
+
+// Listeners are told of the value stored, once any handler has run
+void MemoryMap::writeIORegister(uint8_t offset, uint8_t value){
+    IOWriteHandler const handler = IO_HANDLERS[offset].write;
+    if (handler){
+        (this->*handler)(offset, value);
     }
     else{
-        memory[address] = value;
+        memory[IO_REGISTERS_ADDRESS | offset] = value;
+        recordWrite(IO_REGISTERS_ADDRESS | offset);
+    }
+    if (ioListeners[offset]){
+        ioListeners[offset](memory[IO_REGISTERS_ADDRESS | offset]);
+    }
+}
+
+void MemoryMap::addIOListener(IORegister reg, std::function<void(uint8_t)> listener){
+    ioListeners[uint8_t(reg)] = std::move(listener);
+}
+
+uint8_t MemoryMap::readJoypad(uint8_t offset) const{
+    HalfRegister inputSelection = memory[IO_REGISTERS_ADDRESS | offset];
+    HalfRegister inputValue = 0x00;
+    if(!inputSelection.testBit(4)){
+        // D-pad enabled
+        inputValue |= ~directionInputReg;
+    }
+    if(!inputSelection.testBit(5)){
+        // Buttons enabled
+        inputValue |= ~buttonInputReg;
     }
+    return 0x3F & ((inputSelection | 0x0F) & inputValue);
 }
 
-void MemoryMap::writeByte(uint16_t address, uint8_t value, std::vector<uint8_t>& target){
-    target[address] = value;
+// Only bits 4 and 5 (which select the buttons read) can be written - the buttons themselves are held in the input registers
+void MemoryMap::writeJoypad(uint8_t offset, uint8_t value){
+    memory[IO_REGISTERS_ADDRESS | offset] = 0x30 & value;
+}
+
+// Attempting to write to divider register clears it
+void MemoryMap::writeDivider(uint8_t offset, uint8_t){
+    memory[IO_REGISTERS_ADDRESS | offset] = 0;
+}
+
+// Only bottom three bits of timer control register are used
+void MemoryMap::writeTimerControl(uint8_t offset, uint8_t value){
+    memory[IO_REGISTERS_ADDRESS | offset] = value & 0x07;
+    setCounterFrequency(value & 0x03);
+}
+
+void MemoryMap::writeDMA(uint8_t, uint8_t value){
+    transferDMA(value);
+}
+
+// IF, or IE at offset 0xFF
+void MemoryMap::writeInterruptRegister(uint8_t offset, uint8_t value){
+    memory[IO_REGISTERS_ADDRESS | offset] = value;
+    recordWrite(IO_REGISTERS_ADDRESS | offset);
+    updatePendingInterrupts();
 }
 
 void MemoryMap::writeWord(uint16_t address, uint16_t value){
@@ -94,45 +211,62 @@ void MemoryMap::writeWord(uint16_t address, uint16_t value){
 }
 
 bool MemoryMap::loadBootProgram(std::string const& path){
+    auto image = std::make_shared<FileImage>();
+    if (!image->open(path, 0x100)){
+        return false;
+    }
+    bootProgram = std::move(image);
     isBooting = true;
-    return loadBinary(path, bootMemory);
+    mapPages();
+    return true;
 }
 
 bool MemoryMap::loadCartridge(std::string const& path){
-    return loadBinary(path, memory);
-}
-
-bool MemoryMap::loadBinary(std::string const& path, std::vector<uint8_t>& target){
-    std::ifstream fileStream(path.c_str(), std::ios_base::binary);
-    if (!fileStream){
-        return false;
-    }
-    std::vector<uint8_t> data((std::istreambuf_iterator<char>(fileStream)), (std::istreambuf_iterator<char>()));
-    for (std::size_t i = 0 ; i < data.size() ; ++i){
-        writeByte(i, data[i], target);
-    }
-    return true;
+    recordWriteAll();
+    bool const loaded = cartridge.load(path);
+    mapPages();
+    return loaded;
 }
 
 void MemoryMap::finishBooting(){
     isBooting = false;
+    mapPages();
+    // Cartridge is now visible in place of the boot program
+    for (uint16_t address = 0x0000 ; address < 0x0100 ; address += writeCountLineSize){
+        recordWrite(address);
+    }
 }
 
 bool MemoryMap::getBootStatus() const{
     return isBooting;
 }
 
+// Only memory and the selected RAM bank are set, as ROM cannot change
 void MemoryMap::setState(std::vector<uint8_t> const& state){
     memory = state;
-    finishBooting();
+    if (uint8_t* const ramBank = cartridge.getRAMBankData() ; ramBank && !disableMemMapping){
+        std::copy_n(state.begin() + 0xA000, 0x2000, ramBank);
+    }
+    recordWriteAll();
+    updatePendingInterrupts();
+    finishBooting(); // Also remaps the pages, as memory may have moved
 }
 
+// The cartridge's ROM and RAM are not held in memory, so the banks selected are copied in
 void MemoryMap::getState(std::vector<uint8_t>& state) const{
     state = memory;
+    if (!disableMemMapping){
+        std::copy_n(cartridge.getROMBankData(0x0000), 0x4000, state.begin());
+        std::copy_n(cartridge.getROMBankData(0x4000), 0x4000, state.begin() + 0x4000);
+        for (uint16_t address = 0xA000 ; address < 0xC000 ; ++address){
+            state[address] = readByte(address);
+        }
+    }
 }
 
 void MemoryMap::disableMapping(bool disabled){
     disableMemMapping = disabled;
+    mapPages();
 }
 
 void MemoryMap::transferDMA(uint8_t value){
@@ -144,17 +278,14 @@ void MemoryMap::transferDMA(uint8_t value){
 
 // Return true to trigger timer interrupt
 bool MemoryMap::updateTimerRegisters(uint16_t cycles){
-    uint16_t const timerDividerAddress = 0xFF04;
-    uint16_t const timerCounterAddress = 0xFF05;
-    uint16_t const timerModuloAddress = 0xFF06;
-    // uint16_t const timerControlAddress = 0xFF07;
+    cartridge.advanceClock(cycles);
 
     // step divider
     timer.dividerCycles -= cycles;
     while (timer.dividerCycles <= 0){
         timer.dividerCycles += timer.dividerFreq;
         incrementDIVRegister();
-        if (readByte(timerDividerAddress) == 0x00){
+        if (readIO(IORegister::DIV) == 0x00){
             break; // break on overflow
         }
     }
@@ -165,9 +296,9 @@ bool MemoryMap::updateTimerRegisters(uint16_t cycles){
         while (timer.counterCycles <= 0){
             timer.counterCycles += timer.counterFreq[timer.counterFreqIndex];
             incrementCounterRegister();
-            if (readByte(timerCounterAddress) == 0x00){
+            if (readIO(IORegister::TIMA) == 0x00){
                 // overflow
-                memory[timerCounterAddress] = memory[timerModuloAddress];
+                writeIO(IORegister::TIMA, readIO(IORegister::TMA));
                 return true; // request timer interrupt
             }
         }
@@ -175,19 +306,26 @@ bool MemoryMap::updateTimerRegisters(uint16_t cycles){
     return false;
 }
 
+// Cycles until DIV next wraps or TIMA next overflows - updateTimerRegisters() stops at either,
+// so any number of cycles up to this may be applied in a single update
+uint32_t MemoryMap::cyclesUntilTimerEvent() const{
+    int cycles = timer.dividerCycles + (0xFF - readIO(IORegister::DIV)) * timer.dividerFreq;
+    if (counterEnabled()){
+        cycles = std::min(cycles, timer.counterCycles + (0xFF - readIO(IORegister::TIMA)) * timer.counterFreq[timer.counterFreqIndex]);
+    }
+    return cycles > 0 ? cycles : 0;
+}
+
 void MemoryMap::incrementDIVRegister(){
-    uint16_t const timerDividerAddress = 0xFF04;
-    memory[timerDividerAddress]++;
+    writeIO(IORegister::DIV, readIO(IORegister::DIV) + 1);
 }
 
 void MemoryMap::incrementCounterRegister(){
-    uint16_t const timerCounterAddress = 0xFF05;
-    memory[timerCounterAddress]++;
+    writeIO(IORegister::TIMA, readIO(IORegister::TIMA) + 1);
 }
 
 bool MemoryMap::counterEnabled() const{
-    uint16_t const timerControlAddress = 0xFF07;
-    HalfRegister temp = readByte(timerControlAddress);
+    HalfRegister temp = readIO(IORegister::TAC);
     return temp.testBit(2);
 }
 
@@ -197,10 +335,88 @@ void MemoryMap::setCounterFrequency(uint8_t freq){
 }
 
 bool MemoryMap::processInput(uint8_t buttonInput, uint8_t directionInput){
-    HalfRegister inputReg = readByte(0xFF00);
+    HalfRegister inputReg = readByte(ioAddress(IORegister::JOYP));
     uint8_t dirDelta = !inputReg.testBit(4) ? (directionInput ^ directionInputReg) & directionInputReg : 0x00;
     uint8_t butDelta = !inputReg.testBit(5) ? (buttonInput ^ buttonInputReg) & buttonInputReg : 0x00;
     buttonInputReg = buttonInput;
     directionInputReg = directionInput;
     return (dirDelta > 0x00) || (butDelta > 0x00); // if true, request joypad interrupt
+}
+
+// Interrupts are numbered as for CPU::requestInterrupt
+void MemoryMap::requestInterrupt(uint8_t interrupt){
+    memory[INTERRUPT_FLAG_ADDRESS] |= 0b1 << interrupt;
+    recordWrite(INTERRUPT_FLAG_ADDRESS);
+    updatePendingInterrupts();
+}
+
+// Clears the request once the interrupt is serviced
+void MemoryMap::acknowledgeInterrupt(uint8_t interrupt){
+    memory[INTERRUPT_FLAG_ADDRESS] &= ~(0b1 << interrupt);
+    recordWrite(INTERRUPT_FLAG_ADDRESS);
+    updatePendingInterrupts();
+}
+
+void MemoryMap::updatePendingInterrupts(){
+    pendingInterrupts = memory[INTERRUPT_ENABLE_ADDRESS] & memory[INTERRUPT_FLAG_ADDRESS] & 0x1F;
+}
+
+uint16_t MemoryMap::getROMBank(uint16_t address) const{
+    return address < 0x8000 ? cartridge.getROMBank(address) : 0;
+}
+
+// Plain memory is ROM (for reads), VRAM, cartridge RAM (while a RAM bank is mapped) and WRAM
+// Echo RAM, OAM, the I/O registers, HRAM and IE are excluded
+// With mapping disabled, everything below the I/O registers is plain
+bool MemoryMap::isPlainMemory(uint16_t address, uint32_t length, bool write) const{
+    uint32_t const end = address + length;
+    if (end > (disableMemMapping ? 0xFF00 : 0xE000)){
+        return false;
+    }
+    for (uint32_t page = address >> 8 ; page < (end + 0xFF) >> 8 ; ++page){
+        if (!(write ? writePages[page] : readPages[page])){
+            return false;
+        }
+    }
+    return true;
+}
+
+// The ranges must not overlap, and both must be plain memory
+void MemoryMap::copyBlock(uint16_t target, uint16_t source, uint16_t length){
+    recordWrites(target, length);
+    while (length != 0){
+        uint16_t const chunk = std::min({int(length), 0x100 - (target & 0xFF), 0x100 - (source & 0xFF)});
+        std::copy_n(readPages[source >> 8] + (source & 0xFF), chunk, writePages[target >> 8] + (target & 0xFF));
+        target += chunk;
+        source += chunk;
+        length -= chunk;
+    }
+}
+
+void MemoryMap::fillBlock(uint16_t target, uint8_t value, uint16_t length){
+    recordWrites(target, length);
+    while (length != 0){
+        uint16_t const chunk = std::min(int(length), 0x100 - (target & 0xFF));
+        std::fill_n(writePages[target >> 8] + (target & 0xFF), chunk, value);
+        target += chunk;
+        length -= chunk;
+    }
+}
+
+uint32_t MemoryMap::getWriteCount(uint16_t address) const{
+    return writeCounts[address / writeCountLineSize];
+}
+
+void MemoryMap::recordWrites(uint16_t address, uint16_t length){
+    if (length != 0){
+        for (uint32_t line = address / writeCountLineSize ; line <= (address + length - 1u) / writeCountLineSize ; ++line){
+            ++writeCounts[line];
+        }
+    }
+}
+
+void MemoryMap::recordWriteAll(){
+    for (auto& count : writeCounts){
+        ++count;
+    }
 }
\ No newline at end of file
@@ -0,0 +1,37 @@
+#include "..\inc\opcode_info.h"
+
+#include <sstream>
+#include <iomanip>
+
+std::string disassemble(uint8_t const* bytes){
+    if (bytes[0] == 0xCB){
+        return std::string(OPCODE_CB_INFO[bytes[1]].mnemonic);
+    }
+    OpcodeInfo const& info = OPCODE_INFO[bytes[0]];
+    if (!info.isLegal()){
+        std::ostringstream illegal;
+        illegal << "ILLEGAL 0x" << std::hex << std::uppercase << std::setfill('0') << std::setw(2) << +bytes[0];
+        return illegal.str();
+    }
+    std::string_view placeholder;
+    std::ostringstream operand;
+    operand << std::hex << std::uppercase << std::setfill('0');
+    switch(info.operand){
+    case OperandType::u8:
+        placeholder = "u8";
+        operand << "0x" << std::setw(2) << +bytes[1];
+        break;
+    case OperandType::i8:
+        placeholder = "i8";
+        operand << std::dec << +int8_t(bytes[1]);
+        break;
+    case OperandType::u16:
+        placeholder = "u16";
+        operand << "0x" << std::setw(4) << (bytes[1] | (bytes[2] << 8));
+        break;
+    default:
+        return std::string(info.mnemonic);
+    }
+    std::string text(info.mnemonic);
+    return text.replace(text.find(placeholder), placeholder.length(), operand.str());
+}
\ No newline at end of file
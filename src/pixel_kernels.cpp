@@ -0,0 +1,112 @@
+#include "..\inc\pixel_kernels.h"
+
+#include <cstring>
+
+#ifdef GB_EMU_SIMD_AVAILABLE
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define GB_EMU_TARGET_AVX2
+#else
+#define GB_EMU_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+// Each byte b spread out to one bit per byte, with bit 7 in the first byte
+std::array<uint64_t, 0x100> constexpr static SPREAD_BITS = []{
+    std::array<uint64_t, 0x100> table{};
+    for (uint16_t b = 0 ; b < 0x100 ; ++b){
+        for (uint8_t x = 0 ; x < 8 ; ++x){
+            table[b] |= uint64_t((b >> (7 - x)) & 0x01) << (8 * x);
+        }
+    }
+    return table;
+}();
+
+void static decodeRowScalar(uint8_t lower, uint8_t upper, uint8_t* indices){
+    uint64_t const row = SPREAD_BITS[lower] | (SPREAD_BITS[upper] << 1);
+    for (uint8_t x = 0 ; x < 8 ; ++x){
+        indices[x] = uint8_t(row >> (8 * x));
+    }
+}
+
+void static applyPaletteScalar(uint8_t const* indices, std::size_t count, std::array<uint32_t, 4> const& palette, uint32_t* pixels){
+    for (std::size_t i = 0 ; i < count ; ++i){
+        pixels[i] = palette[indices[i]];
+    }
+}
+
+void static applyShadesScalar(uint8_t const* indices, std::size_t count, std::array<uint8_t, 4> const& shades, uint8_t* output){
+    for (std::size_t i = 0 ; i < count ; ++i){
+        output[i] = shades[indices[i]];
+    }
+}
+
+#ifdef GB_EMU_SIMD_AVAILABLE
+// Tests each pixel's bit in both planes at once - the lower plane in the first eight bytes and the upper in the rest
+void static decodeRowSSE2(uint8_t lower, uint8_t upper, uint8_t* indices){
+    __m128i const masks = _mm_setr_epi8(char(0x80), 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01,
+                                        char(0x80), 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01);
+    __m128i const weights = _mm_setr_epi8(1, 1, 1, 1, 1, 1, 1, 1, 2, 2, 2, 2, 2, 2, 2, 2);
+    __m128i const planes = _mm_unpacklo_epi64(_mm_set1_epi8(char(lower)), _mm_set1_epi8(char(upper)));
+    __m128i const set = _mm_cmpeq_epi8(_mm_and_si128(planes, masks), masks);
+    __m128i const bits = _mm_and_si128(set, weights);
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(indices), _mm_add_epi8(bits, _mm_srli_si128(bits, 8)));
+}
+
+// Eight pixels at a time, with the palette held in the lower half of a register and indexed by a shuffle
+void GB_EMU_TARGET_AVX2 static applyPaletteAVX2(uint8_t const* indices, std::size_t count, std::array<uint32_t, 4> const& palette, uint32_t* pixels){
+    __m256i const colours = _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<__m128i const*>(palette.data())));
+    std::size_t i = 0;
+    for ( ; i + 8 <= count ; i += 8){
+        __m256i const lanes = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<__m128i const*>(indices + i)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(pixels + i), _mm256_permutevar8x32_epi32(colours, lanes));
+    }
+    applyPaletteScalar(indices + i, count - i, palette, pixels + i);
+}
+
+// 32 pixels at a time, with the shades repeated through each lane and indexed by a byte shuffle
+void GB_EMU_TARGET_AVX2 static applyShadesAVX2(uint8_t const* indices, std::size_t count, std::array<uint8_t, 4> const& shades, uint8_t* output){
+    int32_t packed;
+    std::memcpy(&packed, shades.data(), sizeof(packed));
+    __m256i const table = _mm256_set1_epi32(packed);
+    std::size_t i = 0;
+    for ( ; i + 32 <= count ; i += 32){
+        __m256i const lanes = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(indices + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(output + i), _mm256_shuffle_epi8(table, lanes));
+    }
+    applyShadesScalar(indices + i, count - i, shades, output + i);
+}
+
+bool static hostSupportsAVX2(){
+#ifdef _MSC_VER
+    std::array<int, 4> registers;
+    __cpuid(registers.data(), 0);
+    if (registers[0] < 7){
+        return false;
+    }
+    __cpuid(registers.data(), 1);
+    bool const osSavesYMM = (registers[2] & (1 << 27)) && (_xgetbv(0) & 0x06) == 0x06;
+    __cpuidex(registers.data(), 7, 0);
+    return osSavesYMM && (registers[1] & (1 << 5));
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+
+PixelKernels const& PixelKernels::scalar(){
+    static PixelKernels const kernels{"scalar", decodeRowScalar, applyPaletteScalar, applyShadesScalar};
+    return kernels;
+}
+
+PixelKernels const& PixelKernels::best(){
+#ifdef GB_EMU_SIMD_AVAILABLE
+    static PixelKernels const sse2{"SSE2", decodeRowSSE2, applyPaletteScalar, applyShadesScalar};
+    static PixelKernels const avx2{"AVX2", decodeRowSSE2, applyPaletteAVX2, applyShadesAVX2};
+    static bool const avx2Supported = hostSupportsAVX2();
+    return avx2Supported ? avx2 : sse2;
+#else
+    return scalar();
+#endif
+}
\ No newline at end of file
@@ -0,0 +1,217 @@
+#include "..\inc\profiler.h"
+#include "..\inc\opcode_info.h"
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <numeric>
+#include <map>
+#include <stdexcept>
+
+// The cheapest of a run of back-to-back clock reads is taken as the overhead of timing an instruction
+OpcodeProfiler::OpcodeProfiler(){
+    clockOverhead = Clock::duration::max();
+    for (int i = 0 ; i < 1000 ; ++i){
+        auto const start = Clock::now();
+        clockOverhead = std::min(clockOverhead, Clock::now() - start);
+    }
+}
+
+void OpcodeProfiler::recordSample(uint16_t index, uint16_t cycles, Clock::duration elapsed){
+    record(index, cycles);
+    counters[index].samples += 1;
+    if (elapsed > clockOverhead){
+        counters[index].sampledNanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed - clockOverhead).count();
+    }
+}
+
+void OpcodeProfiler::clear(){
+    counters = {};
+    instructions = 0;
+    nativeBlocks = 0;
+    nativeCycles = 0;
+}
+
+std::string_view opcodeFamily(std::string_view mnemonic){
+    std::string_view const family = mnemonic.substr(0, mnemonic.find(' '));
+    return family.empty() ? "(illegal)" : family;
+}
+
+std::string_view static opcodeName(uint16_t index){
+    return index < 0x100 ? OPCODE_INFO[index].mnemonic : OPCODE_CB_INFO[index & 0xFF].mnemonic;
+}
+
+std::string static opcodeLabel(uint16_t index){
+    std::ostringstream label;
+    label << (index < 0x100 ? "0x" : "0xCB") << std::hex << std::uppercase << std::setfill('0') << std::setw(2) << (index & 0xFF);
+    return label.str();
+}
+
+// Prints the opcodes accounting for the most emulated cycles, then the estimated host time taken by each opcode family
+// Host times are extrapolated from the sampled executions, so are only meaningful after many samples
+void OpcodeProfiler::printReport(std::size_t rows) const{
+    uint64_t totalExecutions = 0, totalCycles = 0, totalNanoseconds = 0;
+    std::map<std::string_view, uint64_t> familyNanoseconds;
+    for (uint16_t i = 0 ; i < counters.size() ; ++i){
+        totalExecutions += counters[i].executions;
+        totalCycles += counters[i].cycles;
+        totalNanoseconds += counters[i].sampledNanoseconds;
+        if (counters[i].samples != 0){
+            familyNanoseconds[opcodeFamily(opcodeName(i))] += counters[i].sampledNanoseconds;
+        }
+    }
+    std::vector<uint16_t> order(counters.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [this](uint16_t a, uint16_t b){ return counters[a].cycles > counters[b].cycles; });
+
+    std::cout << std::dec << std::setfill(' ') << std::fixed << std::setprecision(1) << "\n**OPCODE PROFILE**\n";
+    std::cout << "\tInstructions: " << totalExecutions << ", cycles: " << totalCycles;
+    if (nativeBlocks != 0){
+        std::cout << " (plus " << nativeCycles << " cycles in " << nativeBlocks << " native blocks)";
+    }
+    std::cout << "\n\t" << std::left << std::setw(8) << "Opcode" << std::right << std::setw(14) << "Executions" << std::setw(8) << "%"
+              << std::setw(14) << "Cycles" << std::setw(8) << "%" << std::setw(10) << "ns/exec" << "  Description\n";
+    for (std::size_t i = 0 ; i < std::min(rows, order.size()) && counters[order[i]].executions != 0 ; ++i){
+        Counters const& c = counters[order[i]];
+        std::cout << "\t" << std::left << std::setw(8) << opcodeLabel(order[i]) << std::right << std::setw(14) << c.executions
+                  << std::setw(7) << 100.0 * c.executions / totalExecutions << "%" << std::setw(14) << c.cycles
+                  << std::setw(7) << 100.0 * c.cycles / totalCycles << "%" << std::setw(10);
+        if (c.samples != 0){
+            std::cout << double(c.sampledNanoseconds) / c.samples;
+        }
+        else{
+            std::cout << "-";
+        }
+        std::cout << "  " << opcodeName(order[i]) << "\n";
+    }
+
+    std::vector<std::pair<std::string_view, uint64_t>> families(familyNanoseconds.begin(), familyNanoseconds.end());
+    std::stable_sort(families.begin(), families.end(), [](auto const& a, auto const& b){ return a.second > b.second; });
+    std::cout << "\t" << std::left << std::setw(12) << "Family" << std::right << std::setw(14) << "Host ms (est)" << std::setw(8) << "%" << "\n";
+    for (auto const& [family, nanoseconds] : families){
+        std::cout << "\t" << std::left << std::setw(12) << family << std::right << std::setw(14) << 1e-6 * nanoseconds * sampleInterval
+                  << std::setw(7) << 100.0 * nanoseconds / totalNanoseconds << "%\n";
+    }
+    std::cout << std::defaultfloat << std::setprecision(6);
+}
+
+// Writes one row per opcode executed, for comparison between runs
+void OpcodeProfiler::writeCSV(std::string const& path) const{
+    std::ofstream file(path);
+    if (!file){
+        throw std::runtime_error("Failed to open profile file " + path);
+    }
+    file << "opcode,description,family,executions,cycles,samples,sampled_ns\n";
+    for (uint16_t i = 0 ; i < counters.size() ; ++i){
+        Counters const& c = counters[i];
+        if (c.executions == 0){
+            continue;
+        }
+        std::string_view const name = opcodeName(i);
+        file << opcodeLabel(i) << ",\"" << name << "\"," << opcodeFamily(name) << "," << c.executions << ","
+             << c.cycles << "," << c.samples << "," << c.sampledNanoseconds << "\n";
+    }
+    if (nativeBlocks != 0){
+        file << "native,\"Native blocks\",native," << nativeBlocks << "," << nativeCycles << ",0,0\n";
+    }
+}
+
+// Reads symbols from an RGBDS .sym file, in which each line is of the form "BB:AAAA Name" (comments begin with ';')
+void GuestProfiler::loadSymbols(std::string const& path){
+    std::ifstream file(path);
+    if (!file){
+        throw std::runtime_error("Failed to open symbol file " + path);
+    }
+    std::string line;
+    while (std::getline(file, line)){
+        std::istringstream stream(line.substr(0, line.find(';')));
+        unsigned int bank, address;
+        char separator;
+        std::string name;
+        if (stream >> std::hex >> bank >> separator >> address >> name && separator == ':' && address <= 0xFFFF){
+            symbols[(bank << 16) | address] = name;
+        }
+    }
+}
+
+// Discards frames whose return address is below SP, as they must have returned (or been abandoned)
+void GuestProfiler::unwind(uint16_t SP){
+    while (!stack.empty() && stack.back().SP < SP){
+        stack.pop_back();
+    }
+}
+
+// Called once the return address has been pushed
+void GuestProfiler::call(uint32_t entry, uint16_t SP){
+    // Any frame whose return address has just been overwritten is also gone
+    while (!stack.empty() && stack.back().SP <= SP){
+        stack.pop_back();
+    }
+    if (stack.size() < maxDepth){
+        stack.push_back({entry, SP});
+    }
+}
+
+// Called once the return address has been popped
+void GuestProfiler::ret(uint16_t SP){
+    unwind(SP);
+}
+
+void GuestProfiler::sample(uint32_t location, uint16_t SP){
+    unwind(SP);
+    std::vector<uint32_t> entries;
+    entries.reserve(stack.size() + 1);
+    for (auto const& frame : stack){
+        entries.push_back(frame.entry);
+    }
+    entries.push_back(location);
+    samples[entries] += pendingCycles;
+    pendingCycles = 0;
+}
+
+// Memory regions which symbols may be looked up across - ROM banks, VRAM, cartridge RAM, WRAM and the rest
+uint16_t static symbolRegion(uint16_t address){
+    return address < 0x8000 ? address >> 14 : address >> 13;
+}
+
+// Names a location after the closest symbol at or before it in the same bank and region, or as BB:AAAA
+std::string GuestProfiler::describe(uint32_t location) const{
+    auto symbol = symbols.upper_bound(location);
+    if (symbol != symbols.begin()){
+        --symbol;
+        if ((symbol->first >> 16) == (location >> 16) && symbolRegion(symbol->first) == symbolRegion(location)){
+            return symbol->second;
+        }
+    }
+    std::ostringstream name;
+    name << std::hex << std::uppercase << std::setfill('0') << std::setw(2) << (location >> 16) << ":" << std::setw(4) << (location & 0xFFFF);
+    return name.str();
+}
+
+// Writes one line per distinct stack, "outermost;...;innermost cycles", as read by flamegraph.pl and similar tools
+// The PC is only added as a separate frame when it is not named after the function containing it
+void GuestProfiler::writeFoldedStacks(std::string const& path) const{
+    std::ofstream file(path);
+    if (!file){
+        throw std::runtime_error("Failed to open guest profile file " + path);
+    }
+    std::map<std::string, uint64_t> folded;
+    for (auto const& [entries, cycles] : samples){
+        std::string line;
+        std::string previous;
+        for (std::size_t i = 0 ; i < entries.size() ; ++i){
+            std::string const name = describe(entries[i]);
+            if (i == entries.size() - 1 && name == previous){
+                break;
+            }
+            line += (line.empty() ? "" : ";") + name;
+            previous = name;
+        }
+        folded[line] += cycles;
+    }
+    for (auto const& [line, cycles] : folded){
+        file << line << " " << cycles << "\n";
+    }
+}
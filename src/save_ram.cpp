@@ -0,0 +1,130 @@
+#include "..\inc\save_ram.h"
+
+#include <fstream>
+#include <algorithm>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+SaveRAM::SaveRAM(SaveRAM const& other) : buffer(other.data(), other.data() + other.ramSize), ramSize{other.ramSize}{
+}
+
+SaveRAM& SaveRAM::operator=(SaveRAM const& other){
+    if (this != &other){
+        unmap();
+        buffer.assign(other.data(), other.data() + other.ramSize);
+        ramSize = other.ramSize;
+        path.clear();
+    }
+    return *this;
+}
+
+SaveRAM::~SaveRAM(){
+    unmap();
+}
+
+// Falls back to reading the save file into memory (and writing it back on each flush) if it cannot be mapped
+bool SaveRAM::open(std::string const& path, std::size_t size){
+    unmap();
+    ramSize = size;
+    buffer.assign(size, 0x00);
+    if (size == 0){
+        return false;
+    }
+    this->path = path;
+    if (map(path)){
+        buffer.clear();
+        return true;
+    }
+    std::ifstream fileStream(path.c_str(), std::ios_base::binary);
+    if (fileStream){
+        fileStream.read(reinterpret_cast<char*>(buffer.data()), size);
+    }
+    return true;
+}
+
+#ifdef _WIN32
+// The view is never more than the RAM, but the mapping object extends the file if it is shorter
+bool SaveRAM::map(std::string const& path){
+    HANDLE const file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE){
+        return false;
+    }
+    LARGE_INTEGER fileSize;
+    GetFileSizeEx(file, &fileSize);
+    std::size_t const mappingSize = std::max<std::size_t>(ramSize, fileSize.QuadPart);
+    HANDLE const handle = CreateFileMappingA(file, nullptr, PAGE_READWRITE, DWORD(uint64_t(mappingSize) >> 32), DWORD(mappingSize), nullptr);
+    CloseHandle(file);
+    if (!handle){
+        return false;
+    }
+    void* const view = MapViewOfFile(handle, FILE_MAP_WRITE, 0, 0, ramSize);
+    if (!view){
+        CloseHandle(handle);
+        return false;
+    }
+    mapping = static_cast<uint8_t*>(view);
+    mappingHandle = handle;
+    return true;
+}
+
+void SaveRAM::flush(){
+    if (mapping){
+        FlushViewOfFile(mapping, ramSize);
+    }
+    else if (!path.empty()){
+        std::ofstream(path, std::ios_base::binary).write(reinterpret_cast<char const*>(buffer.data()), ramSize);
+    }
+}
+
+void SaveRAM::unmap(){
+    if (mapping){
+        UnmapViewOfFile(mapping);
+        CloseHandle(mappingHandle);
+        mapping = nullptr;
+        mappingHandle = nullptr;
+    }
+}
+#else
+bool SaveRAM::map(std::string const& path){
+    int const file = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (file < 0){
+        return false;
+    }
+    struct stat status;
+    bool mapped = fstat(file, &status) == 0 && (std::size_t(status.st_size) >= ramSize || ftruncate(file, ramSize) == 0);
+    if (mapped){
+        void* const ram = mmap(nullptr, ramSize, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+        mapped = ram != MAP_FAILED;
+        if (mapped){
+            mapping = static_cast<uint8_t*>(ram);
+        }
+    }
+    ::close(file);
+    return mapped;
+}
+
+void SaveRAM::flush(){
+    if (mapping){
+        msync(mapping, ramSize, MS_ASYNC);
+    }
+    else if (!path.empty()){
+        std::ofstream(path, std::ios_base::binary).write(reinterpret_cast<char const*>(buffer.data()), ramSize);
+    }
+}
+
+void SaveRAM::unmap(){
+    if (mapping){
+        munmap(mapping, ramSize);
+        mapping = nullptr;
+    }
+}
+#endif
\ No newline at end of file
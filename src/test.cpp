@@ -28,7 +28,12 @@ bool TestFramework::start(){
     // Run opcode tests - issue: consider splitting out into separate fn
     std::cout << "**OPCODE TESTS**";
     // Standard opcodes
-    std::vector<int> illegalOpcodes{0x10 /*STOP*/, 0x76 /*HALT*/, 0xCB /*PREFIX*/, 0xD3, 0xDB, 0xDD, 0xE3, 0xE4, 0xEB, 0xEC, 0xED, 0xF4, 0xFC, 0xFD};
+    std::vector<int> illegalOpcodes{0x10 /*STOP*/, 0x76 /*HALT*/, 0xCB /*PREFIX*/};
+    for (int i = 0x00 ; i < 0x100 ; ++i){
+        if (!OPCODE_INFO[i].isLegal()){
+            illegalOpcodes.push_back(i);
+        }
+    }
     int const numColumns = 8;
     numTestsPassed = 0;
     for (int i = 0x00 ; i < 0x100; ++i){
@@ -94,6 +99,745 @@ bool TestFramework::testWordRW(){
            memUnit.readByte(0xABCD + 1) == 0x56;
 }
 
+// Echo RAM aliases WRAM in both directions, ROM and the unusable region ignore writes, and a copy has its own memory
+bool TestFramework::testMemoryPages(){
+    MemoryMap memUnit;
+    memUnit.writeByte(0xC123, 0x12);
+    memUnit.writeByte(0xE456, 0x34);
+    memUnit.writeByte(0x1234, 0x56);
+    memUnit.writeByte(0xFEB0, 0x78);
+    MemoryMap copy(memUnit);
+    memUnit.writeByte(0xC123, 0x9A);
+    return memUnit.readByte(0xE123) == 0x9A && memUnit.readByte(0xC456) == 0x34 && memUnit.readByte(0x1234) == 0x00 &&
+           memUnit.readByte(0xFEB0) == 0x00 && copy.readByte(0xC123) == 0x12 && copy.readByte(0xE123) == 0x12 &&
+           memUnit.getWriteCount(0xC456) == 1;
+}
+
+// Registers with side effects go through their handlers, and listeners hear of CPU writes but not of writes by their owners
+bool TestFramework::testIORegisters(){
+    MemoryMap mem;
+    std::vector<uint8_t> serial;
+    mem.addIOListener(IORegister::SC, [&serial, &mem](uint8_t value){
+        if (value == 0x81){
+            serial.push_back(mem.readIO(IORegister::SB));
+        }
+    });
+    mem.writeByte(0xFF01, 'G');
+    mem.writeByte(0xFF02, 0x81);
+    mem.writeByte(0xFF04, 0x12); // DIV
+    mem.writeByte(0xFF07, 0xFD); // TAC
+    mem.writeByte(0xFF00, 0xEF); // JOYP
+    mem.writeByte(0xFF47, 0xE4); // BGP
+    mem.writeIO(IORegister::SC, 0x81);
+    MemoryMap copy = mem;
+    copy.writeByte(0xFF02, 0x81);
+    return serial.size() == 1 && serial[0] == 'G' && mem.readIO(IORegister::DIV) == 0x00 && mem.readIO(IORegister::TAC) == 0x05 &&
+           mem.readIO(IORegister::JOYP) == 0x20 && mem.readByte(0xFF00) == 0x2F && mem.readByte(0xFF47) == 0xE4 &&
+           mem.readIO(IORegister::BGP) == 0xE4;
+}
+
+// Tiles are decoded when first used, then again only once VRAM has been written
+bool TestFramework::testTileCache(){
+    MemoryMap mem;
+    TileCache cache(mem);
+    mem.writeByte(0x8012, 0b10110001); // Tile 1, row 1
+    mem.writeByte(0x8013, 0b01100011);
+    cache.update();
+    std::array<uint8_t, 8> const expected = {1, 2, 3, 1, 0, 0, 2, 3};
+    bool res = std::equal(expected.begin(), expected.end(), cache.getRow(1, 1)) &&
+               std::equal(expected.rbegin(), expected.rend(), cache.getRow(1, 1, true)) && cache.getRow(1, 0)[0] == 0;
+    mem.fillBlock(0x97F0, 0xFF, 0x10); // Tile 383, as written by a fused fill loop
+    res = res && cache.getRow(383, 7)[7] == 0;
+    cache.update();
+    return res && cache.getRow(383, 7)[7] == 3 && cache.getRow(383, 0, true)[0] == 3;
+}
+
+// The fastest kernels the host supports must match the scalar kernels for every tile row, and for lengths with a tail
+bool TestFramework::testPixelKernels(){
+    PixelKernels const& scalar = PixelKernels::scalar();
+    PixelKernels const& best = PixelKernels::best();
+    bool res = true;
+    for (uint32_t row = 0 ; row < 0x10000 ; ++row){
+        std::array<uint8_t, 8> expected, actual;
+        scalar.decodeRow(row & 0xFF, row >> 8, expected.data());
+        best.decodeRow(row & 0xFF, row >> 8, actual.data());
+        res = res && expected == actual && expected[0] == (((row >> 7) & 0x01) | ((row >> 14) & 0x02));
+    }
+    std::array<uint8_t, 163> indices;
+    for (std::size_t i = 0 ; i < indices.size() ; ++i){
+        indices[i] = (i * 7 + i / 5) & 0x03;
+    }
+    std::array<uint32_t, 4> const palette = {0xFFFFFFFF, 0xFFAAAAAA, 0xFF555555, 0xFF000000};
+    for (std::size_t count : {0, 1, 8, 13, 160}){
+        std::array<uint32_t, 163> expected{}, actual{};
+        scalar.applyPalette(indices.data() + 3, count, palette, expected.data());
+        best.applyPalette(indices.data() + 3, count, palette, actual.data());
+        res = res && expected == actual && (count == 0 || expected[0] == palette[indices[3]]);
+        std::array<uint8_t, 163> expectedShades{}, actualShades{};
+        scalar.applyShades(indices.data() + 3, count, {3, 1, 0, 2}, expectedShades.data());
+        best.applyShades(indices.data() + 3, count, {3, 1, 0, 2}, actualShades.data());
+        res = res && expectedShades == actualShades;
+    }
+    return res;
+}
+
+// Objects behind the bg only show over bg colour index 0, even where the palette gives another index the same shade
+bool TestFramework::testObjectPriority(){
+    MemoryMap mem;
+    CPU cpu(mem);
+    GPU gpu(mem, cpu);
+    cpu.simulateBoot();
+    mem.fillBlock(0x8010, 0xFF, 1); // Tile 1 row 0 is colour 1
+    mem.fillBlock(0x8020, 0xFF, 2); // Tile 2 row 0 is colour 3
+    mem.fillBlock(0x9800, 0x00, 0x400);
+    mem.writeByte(0x9800, 0x01);
+    mem.writeByte(0x9801, 0x01);
+    std::array<uint8_t, 12> const objs = {
+        16, 8, 2, 0x80, // Behind the bg, over colour 1
+        16, 24, 2, 0x80, // Behind the bg, over colour 0
+        16, 16, 2, 0x00 // In front of the bg, over colour 1
+    };
+    for (uint8_t i = 0 ; i < objs.size() ; ++i){
+        mem.writeByte(0xFE00 + i, objs[i]);
+    }
+    mem.writeByte(ioAddress(IORegister::BGP), 0xE0); // Colours 0 and 1 are both white
+    mem.writeByte(ioAddress(IORegister::OBP0), 0xE4);
+    mem.writeByte(ioAddress(IORegister::LCDC), 0x93); // LCD, unsigned tile data, objects and bg enabled
+    for (int line = 0 ; line < 2 * 154 ; ++line){
+        gpu.update(456);
+    }
+    std::vector<uint8_t> const& frame = gpu.getFrame();
+    return frame.size() == 160 * 144 && frame[0] == 0 && frame[8] == 3 && frame[16] == 3 && frame[24] == 0 && frame[160] == 0;
+}
+
+// Loads cartridges whose banks each start with their own index, then switches ROM and RAM banks through the MBC
+bool TestFramework::testBankControllers(){
+    std::string const path = (std::filesystem::temp_directory_path() / "gb_emu_test.gb").string();
+    auto const loadCartridge = [&path](MemoryMap& mem, uint8_t type, uint16_t romBanks, uint8_t ramSize){
+        std::vector<uint8_t> rom(romBanks * 0x4000, 0x00);
+        for (uint16_t bank = 0 ; bank < romBanks ; ++bank){
+            rom[bank * 0x4000] = uint8_t(bank);
+        }
+        rom[0x147] = type;
+        rom[0x149] = ramSize;
+        std::ofstream(path, std::ios_base::binary).write(reinterpret_cast<char const*>(rom.data()), rom.size());
+        return mem.loadCartridge(path);
+    };
+    // MBC1 with 64 ROM banks and 4 RAM banks
+    MemoryMap mbc1;
+    bool res = loadCartridge(mbc1, 0x02, 64, 0x03) && mbc1.readByte(0x4000) == 1;
+    mbc1.writeByte(0x2000, 0x05);
+    res = res && mbc1.readByte(0x4000) == 5 && mbc1.getROMBank(0x4000) == 5;
+    mbc1.writeByte(0x2000, 0x00); // Selects bank 1
+    mbc1.writeByte(0x4000, 0x01); // Upper bits
+    res = res && mbc1.readByte(0x4000) == 0x21 && mbc1.readByte(0x0000) == 0 && mbc1.readByte(0xA000) == 0xFF;
+    mbc1.writeByte(0x0000, 0x0A); // Enable RAM
+    mbc1.writeByte(0xA000, 0x42);
+    mbc1.writeByte(0x6000, 0x01); // Upper bits select RAM bank 1 and ROM bank 0x20 at 0x0000
+    res = res && mbc1.readByte(0x0000) == 0x20 && mbc1.readByte(0xA000) == 0x00;
+    mbc1.writeByte(0x4000, 0x00);
+    res = res && mbc1.readByte(0xA000) == 0x42;
+    // MBC2 RAM holds only the lower half of each byte
+    MemoryMap mbc2;
+    res = res && loadCartridge(mbc2, 0x05, 16, 0x00);
+    mbc2.writeByte(0x0000, 0x0A);
+    mbc2.writeByte(0x2100, 0x03);
+    mbc2.writeByte(0xA001, 0x5A);
+    res = res && mbc2.readByte(0x4000) == 3 && mbc2.readByte(0xA201) == 0xFA;
+    // MBC3 clock, which counts emulated time once latched (only sold with a battery, so the RAM has a save file)
+    std::string const savePath = std::filesystem::path(path).replace_extension(".sav").string();
+    std::filesystem::remove(savePath);
+    MemoryMap mbc3;
+    res = res && loadCartridge(mbc3, 0x10, 128, 0x03) && mbc3.getSavePath() == savePath;
+    mbc3.writeByte(0x0000, 0x0A);
+    mbc3.writeByte(0x2000, 0x7F);
+    mbc3.writeByte(0x4000, 0x09); // Minutes
+    mbc3.writeByte(0xA000, 59);
+    for (int i = 0 ; i < 128 * 61 ; ++i){
+        mbc3.updateTimerRegisters(0x8000); // 61 seconds
+    }
+    mbc3.writeByte(0x6000, 0x00);
+    mbc3.writeByte(0x6000, 0x01);
+    uint8_t const minutes = mbc3.readByte(0xA000);
+    mbc3.writeByte(0x4000, 0x0A); // Hours
+    res = res && mbc3.readByte(0x4000) == 0x7F && minutes == 0 && mbc3.readByte(0xA000) == 1;
+    // MBC5 can select bank 0 in 0x4000-0x7FFF
+    MemoryMap mbc5;
+    res = res && loadCartridge(mbc5, 0x19, 8, 0x00);
+    mbc5.writeByte(0x2000, 0x00);
+    res = res && mbc5.readByte(0x4000) == 0;
+    mbc5.writeByte(0x2000, 0x0E); // Masked to the 8 banks present
+    res = res && mbc5.readByte(0x4000) == 6 && mbc5.getSavePath().empty();
+    std::filesystem::remove(path);
+    std::filesystem::remove(savePath);
+    return res;
+}
+
+// Writes to battery-backed RAM must reach the save file without being saved explicitly, but not from a copy of the memory map
+bool TestFramework::testSaveRAM(){
+    std::string const path = (std::filesystem::temp_directory_path() / "gb_emu_test.gb").string();
+    std::string const savePath = (std::filesystem::temp_directory_path() / "gb_emu_test.sav").string();
+    std::vector<uint8_t> rom(0x10000, 0x00);
+    rom[0x147] = 0x03; // MBC1 with RAM and a battery
+    rom[0x149] = 0x03; // 4 RAM banks
+    std::ofstream(path, std::ios_base::binary).write(reinterpret_cast<char const*>(rom.data()), rom.size());
+    std::filesystem::remove(savePath);
+    bool res;
+    {
+        MemoryMap mem;
+        res = mem.loadCartridge(path);
+        mem.writeByte(0x0000, 0x0A);
+        mem.writeByte(0xA000, 0x12);
+        mem.writeByte(0x6000, 0x01);
+        mem.writeByte(0x4000, 0x02); // RAM bank 2
+        mem.writeByte(0xA123, 0x34);
+        MemoryMap copy = mem;
+        copy.writeByte(0xA123, 0x99);
+        res = res && mem.readByte(0xA123) == 0x34 && copy.readByte(0xA123) == 0x99;
+        mem.writeByte(0x0000, 0x00);
+        std::ifstream saveFile(savePath, std::ios_base::binary);
+        std::vector<uint8_t> const save((std::istreambuf_iterator<char>(saveFile)), (std::istreambuf_iterator<char>()));
+        res = res && save.size() == 0x8000 && save[0x0000] == 0x12 && save[0x4123] == 0x34;
+    }
+    MemoryMap reloaded;
+    res = res && reloaded.loadCartridge(path);
+    reloaded.writeByte(0x0000, 0x0A);
+    res = res && reloaded.readByte(0xA000) == 0x12;
+    std::filesystem::remove(path);
+    std::filesystem::remove(savePath);
+    return res;
+}
+
+// Maps a boot program over the start of a cartridge which is shorter than its two banks, so must be padded with zeros
+bool TestFramework::testFileImages(){
+    std::string const bootPath = (std::filesystem::temp_directory_path() / "gb_emu_test_boot.bin").string();
+    std::string const cartridgePath = (std::filesystem::temp_directory_path() / "gb_emu_test.gb").string();
+    std::vector<uint8_t> const boot(0x100, 0x31);
+    std::vector<uint8_t> cartridge(0x5001, 0x77);
+    cartridge[0x147] = 0x00; // No MBC
+    std::ofstream(bootPath, std::ios_base::binary).write(reinterpret_cast<char const*>(boot.data()), boot.size());
+    std::ofstream(cartridgePath, std::ios_base::binary).write(reinterpret_cast<char const*>(cartridge.data()), cartridge.size());
+    MemoryMap mem;
+    bool res = !mem.loadBootProgram(bootPath + ".missing") && mem.loadBootProgram(bootPath) && mem.loadCartridge(cartridgePath);
+    res = res && mem.readByte(0x00FF) == 0x31 && mem.readByte(0x0100) == 0x77 && mem.readByte(0x5000) == 0x77 && mem.readByte(0x5001) == 0x00
+              && mem.readByte(0x7FFF) == 0x00;
+    mem.finishBooting();
+    res = res && mem.readByte(0x00FF) == 0x77;
+    std::filesystem::remove(bootPath);
+    std::filesystem::remove(cartridgePath);
+    return res;
+}
+
+// Overwrites a cached LD A, u8 in WRAM with LD B, u8, which must be re-decoded
+bool TestFramework::testBlockCacheInvalidation(){
+    CPUState state{};
+    state.memory = std::vector<uint8_t>(0x10000, 0x00);
+    state.PC = 0xC000;
+    state.memory[0xC000] = 0x3E; // LD A, 0x01
+    state.memory[0xC001] = 0x01;
+    state.memory[0xC002] = 0x18; // JR to 0xC000
+    state.memory[0xC003] = 0xFC;
+    MemoryMap mem;
+    CPU cpu(mem);
+    cpu.setState(state);
+    cpu.executeNextOpcode();
+    cpu.executeNextOpcode();
+    mem.writeByte(0xC000, 0x06); // LD B, 0x01
+    cpu.executeNextOpcode();
+    cpu.getState(state);
+    return state.A == 0x01 && state.B == 0x01 && state.PC == 0xC002;
+}
+
+// Runs a loop of natively compiled loads, ALU operations and branches (plus a CB opcode, which
+// calls its interpreter handler) in differential mode, which throws if the engines ever disagree
+bool TestFramework::testDynarec(){
+    std::vector<uint8_t> const program{
+        0x21, 0x00, 0xC0,       // LD HL, 0xC000
+        0x01, 0x34, 0x12,       // LD BC, 0x1234
+        0x11, 0x00, 0xC1,       // LD DE, 0xC100
+        0x2A,                   // LD A, (HL++)
+        0x88,                   // ADC A, B
+        0x9E,                   // SBC A, (HL)
+        0x12,                   // LD (DE), A
+        0x13,                   // INC DE
+        0x91,                   // SUB A, C
+        0xEE, 0x5A,             // XOR A, 0x5A
+        0x4F,                   // LD C, A
+        0x2F,                   // CPL
+        0x0C,                   // INC C
+        0x86,                   // ADD A, (HL)
+        0xB2,                   // OR A, D
+        0xA3,                   // AND A, E
+        0xCE, 0x77,             // ADC A, 0x77
+        0xDE, 0x13,             // SBC A, 0x13
+        0x77,                   // LD (HL), A
+        0xFE, 0x40,             // CP A, 0x40
+        0x38, 0x02,             // JR C to 0x0022
+        0x3D,                   // DEC A
+        0x47,                   // LD B, A
+        0xCB, 0x37,             // SWAP A
+        0x05,                   // DEC B
+        0x20, 0xE2,             // JR NZ to 0x0009
+        0xC3, 0x06, 0x00        // JP 0x0006
+    };
+    CPUState state{};
+    state.memory = std::vector<uint8_t>(0x10000, 0x00);
+    std::copy(program.begin(), program.end(), state.memory.begin());
+    for (int i = 0 ; i < 0x2000 ; ++i){
+        state.memory[0xC000 + i] = uint8_t(i * 37 + 11);
+    }
+    MemoryMap mem;
+    CPU cpu(mem);
+    mem.disableMapping();
+    cpu.setState(state);
+    cpu.setEngine(CPUEngine::differential);
+    try{
+        for (int i = 0 ; i < 100000 ; ++i){
+            cpu.executeNextOpcode();
+        }
+    }
+    catch (std::runtime_error const&){
+        return false;
+    }
+    return true;
+}
+
+// Requests an interrupt part way through a hot block by writing IF through HL - the JIT must leave native code before
+// the write, so the interrupt is taken (and records E) at the same instruction as in the interpreter
+bool TestFramework::testDynarecIO(){
+    std::vector<uint8_t> const program{
+        0x31, 0xFE, 0xDF,       // LD SP, 0xDFFE
+        0x21, 0x0F, 0xFF,       // LD HL, 0xFF0F
+        0x06, 0x40,             // LD B, 0x40
+        0xFB,                   // EI
+        0x3E, 0x01,             // LD A, 0x01
+        0x0C,                   // INC C
+        0x77,                   // LD (HL), A
+        0x1C,                   // INC E
+        0x05,                   // DEC B
+        0x20, 0xF8,             // JR NZ to 0x0009
+        0x18, 0xFE              // JR to 0x0011
+    };
+    std::vector<uint8_t> const handler{
+        0x7B,                   // LD A, E
+        0x82,                   // ADD A, D
+        0x57,                   // LD D, A
+        0xD9                    // RETI
+    };
+    CPUState state{};
+    state.memory = std::vector<uint8_t>(0x10000, 0x00);
+    std::copy(program.begin(), program.end(), state.memory.begin());
+    std::copy(handler.begin(), handler.end(), state.memory.begin() + 0x40);
+    state.memory[0xFFFF] = 0x01; // VBlank enabled
+    MemoryMap nativeMem, mem;
+    CPU nativeCPU(nativeMem), cpu(mem);
+    nativeMem.disableMapping();
+    mem.disableMapping();
+    nativeCPU.setState(state);
+    cpu.setState(state);
+    nativeCPU.setEngine(CPUEngine::differential);
+    try{
+        for (int i = 0 ; i < 2000 ; ++i){
+            nativeCPU.executeNextOpcode();
+            nativeCPU.handleInterrupts();
+            cpu.executeNextOpcode();
+            cpu.handleInterrupts();
+        }
+    }
+    catch (std::runtime_error const&){
+        return false;
+    }
+    CPUState nativeState, expectedState;
+    nativeCPU.getState(nativeState);
+    cpu.getState(expectedState);
+    return nativeState == expectedState && expectedState.PC == 0x0011;
+}
+
+// Requests an interrupt while interrupts are disabled, then enables them in a hot block - the interpreter takes the
+// interrupt straight after EI, so native code must too (rather than running on to the DI)
+bool TestFramework::testDynarecInterrupts(){
+    std::vector<uint8_t> const program{
+        0x31, 0xFE, 0xDF,       // LD SP, 0xDFFE
+        0x21, 0x0F, 0xFF,       // LD HL, 0xFF0F
+        0x3E, 0x01,             // LD A, 0x01
+        0x06, 0x40,             // LD B, 0x40
+        0x77,                   // LD (HL), A
+        0x18, 0x00,             // JR to 0x000D
+        0xFB,                   // EI
+        0x0C,                   // INC C
+        0xF3,                   // DI
+        0x05,                   // DEC B
+        0x20, 0xF7,             // JR NZ to 0x000A
+        0x18, 0xFE              // JR to 0x0013
+    };
+    std::vector<uint8_t> const handler{
+        0x14,                   // INC D
+        0xC9                    // RET (leaving interrupts disabled)
+    };
+    CPUState state{};
+    state.memory = std::vector<uint8_t>(0x10000, 0x00);
+    std::copy(program.begin(), program.end(), state.memory.begin());
+    std::copy(handler.begin(), handler.end(), state.memory.begin() + 0x40);
+    state.memory[0xFFFF] = 0x01; // VBlank enabled
+    MemoryMap nativeMem, mem;
+    CPU nativeCPU(nativeMem), cpu(mem);
+    nativeMem.disableMapping();
+    mem.disableMapping();
+    nativeCPU.setState(state);
+    cpu.setState(state);
+    nativeCPU.setEngine(CPUEngine::differential);
+    try{
+        for (int i = 0 ; i < 2000 ; ++i){
+            nativeCPU.executeNextOpcode();
+            nativeCPU.handleInterrupts();
+            cpu.executeNextOpcode();
+            cpu.handleInterrupts();
+        }
+    }
+    catch (std::runtime_error const&){
+        return false;
+    }
+    CPUState nativeState, expectedState;
+    nativeCPU.getState(nativeState);
+    cpu.getState(expectedState);
+    return nativeState == expectedState && expectedState.D == 0x40 && expectedState.PC == 0x0013;
+}
+
+// Runs a hot block in bank 1 which selects bank 1 through the MBC until it finally selects bank 2 part way through -
+// the instructions after that write must come from bank 2, as they do without the block cache
+bool TestFramework::testBankSwitchInBlock(){
+    std::vector<uint8_t> const bank1{
+        0x21, 0x00, 0x20,       // LD HL, 0x2000
+        0x1E, 0x40,             // LD E, 0x40
+        0x3E, 0x01,             // LD A, 0x01
+        0x1D,                   // DEC E
+        0x20, 0x04,             // JR NZ to 0x400E
+        0x3E, 0x02,             // LD A, 0x02
+        0x18, 0x00,             // JR to 0x400E
+        0x77,                   // LD (HL), A
+        0x04,                   // INC B
+        0x18, 0xF5              // JR to 0x4007
+    };
+    std::vector<uint8_t> const bank2{
+        0x0C,                   // INC C (at 0x400F)
+        0x18, 0xFE              // JR to 0x4010
+    };
+    std::vector<uint8_t> rom(4 * 0x4000, 0x00);
+    rom[0x100] = 0xC3; // JP 0x4000
+    rom[0x101] = 0x00;
+    rom[0x102] = 0x40;
+    rom[0x147] = 0x01; // MBC1
+    std::copy(bank1.begin(), bank1.end(), rom.begin() + 0x4000);
+    std::copy(bank2.begin(), bank2.end(), rom.begin() + 2 * 0x4000 + 0x000F);
+    std::string const path = (std::filesystem::temp_directory_path() / "gb_emu_test.gb").string();
+    std::ofstream(path, std::ios_base::binary).write(reinterpret_cast<char const*>(rom.data()), rom.size());
+    auto const runCartridge = [&path](std::optional<CPUEngine> engine){
+        MemoryMap mem;
+        CPU cpu(mem);
+        CPUState state{};
+        if (!mem.loadCartridge(path)){
+            return state;
+        }
+        if (engine){
+            cpu.setEngine(*engine);
+        }
+        else{
+            cpu.enableBlockCache(false);
+        }
+        cpu.simulateBoot();
+        for (int i = 0 ; i < 600 ; ++i){
+            cpu.executeNextOpcode();
+        }
+        cpu.getState(state);
+        return state;
+    };
+    bool res;
+    try{
+        CPUState const expectedState = runCartridge(std::nullopt);
+        res = expectedState.B == 0x3F && expectedState.C == 0x14 && expectedState.PC == 0x4010 &&
+              runCartridge(CPUEngine::interpreter) == expectedState && runCartridge(CPUEngine::differential) == expectedState;
+    }
+    catch (std::runtime_error const&){
+        res = false;
+    }
+    std::filesystem::remove(path);
+    return res;
+}
+
+// A loop polling LY is recognised once it has branched back, but a counting loop is not, nor a loop re-entered with
+// its pointer moved to a register which changes on its own
+bool TestFramework::testIdleLoop(){
+    CPUState state{};
+    state.memory = std::vector<uint8_t>(0x10000, 0x00);
+    std::vector<uint8_t> const program{
+        0xF0, 0x44,             // LDH A, (0x44)
+        0xFE, 0x90,             // CP A, 0x90
+        0x20, 0xFA,             // JR NZ to 0x0000
+        0x05,                   // DEC B
+        0x20, 0xFD              // JR NZ to 0x0006
+    };
+    std::copy(program.begin(), program.end(), state.memory.begin());
+    state.B = 0x02;
+    MemoryMap mem;
+    CPU cpu(mem);
+    mem.disableMapping();
+    cpu.setState(state);
+    bool res = true;
+    for (int i = 0 ; i < 3 ; ++i){
+        res = res && cpu.getIdleLoopCycles() == 0;
+        cpu.executeNextOpcode();
+    }
+    res = res && cpu.getIdleLoopCycles() == 32;
+    mem.writeByte(0xFF44, 0x90);
+    for (int i = 0 ; i < 5 ; ++i){
+        cpu.executeNextOpcode();
+    }
+    cpu.getState(state);
+    res = res && state.PC == 0x0006 && cpu.getIdleLoopCycles() == 0;
+    // The same loop entered again polling TIMA through HL is not idle
+    std::vector<uint8_t> const subroutine{
+        0xCD, 0x10, 0x00,       // CALL 0x0010
+        0x21, 0x05, 0xFF,       // LD HL, 0xFF05
+        0xCD, 0x10, 0x00,       // CALL 0x0010
+        0x18, 0xFE,             // JR to 0x0009
+        0x00, 0x00, 0x00, 0x00, 0x00,
+        0x7E,                   // LD A, (HL)
+        0xA7,                   // AND A, A
+        0x28, 0xFC,             // JR Z to 0x0010
+        0xC9                    // RET
+    };
+    state = {};
+    state.memory = std::vector<uint8_t>(0x10000, 0x00);
+    std::copy(subroutine.begin(), subroutine.end(), state.memory.begin());
+    state.SP = 0xDFFE;
+    state.H = 0xC0;
+    cpu.setState(state);
+    for (int i = 0 ; i < 4 ; ++i){
+        cpu.executeNextOpcode();
+    }
+    res = res && cpu.getIdleLoopCycles() == 24;
+    mem.writeByte(0xC000, 0x01);
+    for (int i = 0 ; i < 9 ; ++i){
+        cpu.executeNextOpcode();
+    }
+    cpu.getState(state);
+    return res && state.PC == 0x0010 && state.H == 0xFF && cpu.getIdleLoopCycles() == 0;
+}
+
+// Runs copy, fill, delay and poll loops in batches of varying length, with and without superinstructions, which must
+// take the same cycles in every batch and leave the same state
+bool TestFramework::testSuperinstructions(){
+    std::vector<uint8_t> const program{
+        0x21, 0x00, 0x01,       // LD HL, 0x0100
+        0x11, 0x00, 0xC0,       // LD DE, 0xC000
+        0x01, 0x34, 0x02,       // LD BC, 0x0234
+        0x2A,                   // LD A, (HL++)
+        0x12,                   // LD (DE), A
+        0x13,                   // INC DE
+        0x0B,                   // DEC BC
+        0x78,                   // LD A, B
+        0xB1,                   // OR A, C
+        0x20, 0xF8,             // JR NZ to 0x0009
+        0x21, 0x00, 0xD0,       // LD HL, 0xD000
+        0x11, 0x00, 0xC0,       // LD DE, 0xC000
+        0x0E, 0x90,             // LD C, 0x90
+        0x1A,                   // LD A, (DE)
+        0x22,                   // LD (HL++), A
+        0x13,                   // INC DE
+        0x0D,                   // DEC C
+        0x20, 0xFA,             // JR NZ to 0x0019
+        0x3E, 0x5A,             // LD A, 0x5A
+        0x21, 0xFF, 0xDF,       // LD HL, 0xDFFF
+        0x16, 0x00,             // LD D, 0x00
+        0x32,                   // LD (HL--), A
+        0x15,                   // DEC D
+        0x20, 0xFC,             // JR NZ to 0x0026
+        0x21, 0x00, 0xC8,       // LD HL, 0xC800
+        0x1E, 0x33,             // LD E, 0x33
+        0x22,                   // LD (HL++), A
+        0x1D,                   // DEC E
+        0x20, 0xFC,             // JR NZ to 0x002F
+        0x06, 0x00,             // LD B, 0x00
+        0x05,                   // DEC B
+        0x20, 0xFD,             // JR NZ to 0x0035
+        0x11, 0x00, 0x03,       // LD DE, 0x0300
+        0x1B,                   // DEC DE
+        0x7B,                   // LD A, E
+        0xB2,                   // OR A, D
+        0x20, 0xFB,             // JR NZ to 0x003B
+        0xF0, 0x80,             // LDH A, (0x80)
+        0xFE, 0x00,             // CP A, 0x00
+        0x20, 0xFA,             // JR NZ to 0x0040
+        0xC3, 0x00, 0x00        // JP 0x0000
+    };
+    CPUState state{};
+    state.memory = std::vector<uint8_t>(0x10000, 0x00);
+    std::copy(program.begin(), program.end(), state.memory.begin());
+    for (int i = 0 ; i < 0x300 ; ++i){
+        state.memory[0x0100 + i] = uint8_t(i * 37 + 11);
+    }
+    MemoryMap fusedMem, mem;
+    CPU fusedCPU(fusedMem), cpu(mem);
+    fusedMem.disableMapping();
+    mem.disableMapping();
+    fusedCPU.setState(state);
+    cpu.setState(state);
+    cpu.enableSuperinstructions(false);
+    for (uint32_t i = 0 ; i < 2000 ; ++i){
+        uint32_t const budget = 20 + i * 53 % 3000;
+        if (fusedCPU.run(budget, budget) != cpu.run(budget, budget)){
+            return false;
+        }
+    }
+    CPUState fusedState, expectedState;
+    fusedCPU.getState(fusedState);
+    cpu.getState(expectedState);
+    return fusedState == expectedState;
+}
+
+// Once full, the buffer keeps only the most recent entries, indexed from the oldest
+bool TestFramework::testTraceBuffer(){
+    TraceBuffer<8> trace;
+    bool res = trace.size() == 0;
+    for (uint16_t i = 0 ; i < 12 ; ++i){
+        trace.record({i, uint16_t(0x100 + i), 0, uint8_t(i), 0x00});
+    }
+    res = res && trace.size() == 8;
+    for (std::size_t i = 0 ; i < trace.size() ; ++i){
+        res = res && trace[i].PC == 0x104 + i && trace[i].cycle == 4 + i;
+    }
+    trace.clear();
+    return res && trace.size() == 0;
+}
+
+// Records with sequential and non-sequential PCs, long cycle gaps and changing registers decode unchanged
+bool TestFramework::testTraceFile(){
+    std::string const path = (std::filesystem::temp_directory_path() / "gb_emu_test.trc").string();
+    std::vector<TraceRecord> records;
+    TraceRecord record;
+    for (uint16_t i = 0 ; i < 50000 ; ++i){
+        record.cycle += i % 100 == 0 ? 70224ull * i : 4 * (i % 6);
+        record.PC = i % 7 == 0 ? uint16_t(i * 13) : uint16_t(record.PC + record.length);
+        record.SP = 0xFFFE - 2 * (i % 3);
+        record.registers[i % 8] = uint8_t(i);
+        record.length = 1 + i % 3;
+        record.opcodeBytes = {uint8_t(i), uint8_t(record.length > 1 ? i >> 8 : 0), uint8_t(record.length > 2 ? i * 3 : 0)}; // Unused bytes are zero
+        records.push_back(record);
+    }
+    {
+        TraceWriter writer(path);
+        for (auto const& r : records){
+            writer.record(r);
+        }
+    }
+    TraceReader reader(path);
+    bool res = true;
+    for (auto const& r : records){
+        res = res && reader.next(record) && record == r;
+    }
+    res = res && !reader.next(record);
+    std::filesystem::remove(path);
+    return res;
+}
+
+bool TestFramework::testOpcodeProfiler(){
+    OpcodeProfiler profiler;
+    uint32_t samples = 0;
+    for (uint32_t i = 0 ; i < 4 * OpcodeProfiler::sampleInterval ; ++i){
+        if (profiler.sampleDue()){
+            profiler.recordSample(0x1CB, 8, std::chrono::microseconds(1));
+            ++samples;
+        }
+        else{
+            profiler.record(i % 2 == 0 ? 0x1CB : 0x00, i % 2 == 0 ? 8 : 4);
+        }
+    }
+    bool res = samples == 4 && profiler[0x1CB].samples == 4 && profiler[0x1CB].sampledNanoseconds > 0;
+    res = res && profiler[0x1CB].executions + profiler[0x00].executions == 4 * OpcodeProfiler::sampleInterval;
+    res = res && profiler[0x1CB].cycles == 8 * profiler[0x1CB].executions && profiler[0x00].cycles == 4 * profiler[0x00].executions;
+    res = res && opcodeFamily("BIT 1, E") == "BIT" && opcodeFamily("ADD HL, BC") == "ADD" && opcodeFamily("") == "(illegal)";
+    profiler.clear();
+    return res && profiler[0x1CB].executions == 0;
+}
+
+// Calls nest, returns unwind, and frames abandoned by resetting SP are discarded
+bool TestFramework::testGuestProfiler(){
+    std::string const path = (std::filesystem::temp_directory_path() / "gb_emu_test.folded").string();
+    GuestProfiler profiler;
+    profiler.call(0x0200, 0xDFFC);
+    profiler.advance(GuestProfiler::sampleInterval, 0x0204, 0xDFFC);
+    profiler.call(0x14000, 0xDFFA);
+    profiler.advance(GuestProfiler::sampleInterval, 0x14010, 0xDFFA);
+    profiler.ret(0xDFFC);
+    profiler.advance(GuestProfiler::sampleInterval / 2, 0x0208, 0xDFFC);
+    profiler.advance(GuestProfiler::sampleInterval / 2, 0x0208, 0xDFFC);
+    profiler.call(0x0040, 0xDFFA);
+    profiler.advance(2 * GuestProfiler::sampleInterval, 0x0041, 0xE000);
+    profiler.writeFoldedStacks(path);
+    std::ifstream file(path);
+    std::vector<std::string> lines;
+    for (std::string line ; std::getline(file, line) ; ){
+        lines.push_back(line);
+    }
+    file.close();
+    std::filesystem::remove(path);
+    return lines == std::vector<std::string>{"00:0041 2048", "00:0200;00:0204 1024", "00:0200;00:0208 1024", "00:0200;01:4000;01:4010 1024"};
+}
+
+// Every handler returns the cycles given in the opcode tables, for both outcomes of a conditional branch
+bool TestFramework::testOpcodeCycles(){
+    bool res = true;
+    for (uint16_t i = 0x000 ; i < 0x200 ; ++i){
+        uint8_t const opcode = i < 0x100 ? i : 0xCB;
+        uint8_t const opcodeCB = i & 0xFF;
+        if (!OPCODE_INFO[opcode].isLegal() || (opcode == 0xCB && i < 0x100)){
+            continue;
+        }
+        OpcodeInfo const& info = getOpcodeInfo(opcode, opcodeCB);
+        std::vector<uint16_t> cycles;
+        for (uint8_t flags : {0x00, 0xF0}){
+            MemoryMap mem;
+            CPU cpu(mem);
+            mem.disableMapping();
+            CPUState state{std::vector<uint8_t>(0x10000, 0x00), 0x00, flags, 0x00, 0x00, 0x00, 0x00, 0xC0, 0x00, 0xD000, 0x0100, false, false};
+            state.memory[0x0100] = opcode;
+            state.memory[0x0101] = opcodeCB;
+            cpu.setState(state);
+            cycles.push_back(cpu.executeNextOpcode());
+        }
+        // Taken on one of the two runs, as a condition and its inverse see opposite flags
+        std::sort(cycles.begin(), cycles.end());
+        res = res && cycles[0] == info.cycles && cycles[1] == info.branchCycles;
+    }
+    return res;
+}
+
+// With VBlank and timer both pending, only VBlank is serviced - the timer waits until interrupts are re-enabled
+bool TestFramework::testInterruptPriority(){
+    CPUState state{};
+    state.memory = std::vector<uint8_t>(0x10000, 0x00);
+    state.memory[0xFF0F] = 0x05; // VBlank and timer requested
+    state.memory[0xFFFF] = 0x1D; // All but LCD enabled
+    state.PC = 0x1234;
+    state.SP = 0xFFFE;
+    state.interrupts = true;
+    MemoryMap mem;
+    CPU cpu(mem);
+    mem.disableMapping();
+    cpu.setState(state);
+    bool res = mem.getPendingInterrupts() == 0x05;
+    cpu.handleInterrupts();
+    cpu.handleInterrupts();
+    cpu.getState(state);
+    res = res && state.PC == 0x0040 && state.SP == 0xFFFC && !state.interrupts && mem.readWord(0xFFFC) == 0x1234;
+    res = res && mem.readByte(0xFF0F) == 0x04 && mem.getPendingInterrupts() == 0x04;
+    // Requesting a disabled interrupt leaves it in IF only, until IE is written
+    cpu.requestInterrupt(1);
+    res = res && mem.readByte(0xFF0F) == 0x06 && mem.getPendingInterrupts() == 0x04;
+    mem.writeByte(0xFFFF, 0x02);
+    return res && mem.getPendingInterrupts() == 0x02;
+}
+
 bool TestFramework::testBitHalfRegister(){
     bool res = true;
     for (int i = 0 ; i < 8 ; ++i){
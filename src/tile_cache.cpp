@@ -0,0 +1,27 @@
+#include "..\inc\tile_cache.h"
+
+TileCache::TileCache(MemoryMap const& memMap) : memoryMap{memMap}{
+}
+
+void TileCache::update(){
+    for (uint16_t line = 0 ; line < writeCounts.size() ; ++line){
+        uint32_t const writeCount = memoryMap.getWriteCount(0x8000 + line * MemoryMap::writeCountLineSize);
+        if (writeCount != writeCounts[line] || !decoded){
+            writeCounts[line] = writeCount;
+            for (uint16_t tile = line * tilesPerLine ; tile < (line + 1) * tilesPerLine ; ++tile){
+                decodeTile(tile);
+            }
+        }
+    }
+    decoded = true;
+}
+
+// Each row is two bytes, holding the lower then upper bits of its eight pixels' indices
+void TileCache::decodeTile(uint16_t tile){
+    for (uint8_t y = 0 ; y < 8 ; ++y){
+        uint16_t const address = 0x8000 + 16 * tile + 2 * y;
+        auto& row = tiles[0][tile][y];
+        kernels->decodeRow(memoryMap.readByte(address), memoryMap.readByte(address + 1), row.data());
+        std::reverse_copy(row.begin(), row.end(), tiles[1][tile][y].begin());
+    }
+}
\ No newline at end of file
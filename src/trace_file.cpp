@@ -0,0 +1,226 @@
+#include "..\inc\trace_file.h"
+#include "..\inc\opcode_info.h"
+
+#include <iostream>
+#include <iomanip>
+#include <stdexcept>
+#include <bit>
+
+std::array<char, 8> constexpr static TRACE_FILE_HEADER = {'G', 'B', 'T', 'R', 'A', 'C', 'E', 1};
+
+uint8_t constexpr static FLAG_LENGTH = 0x03;
+uint8_t constexpr static FLAG_PC = 0x04;
+uint8_t constexpr static FLAG_SP = 0x08;
+std::size_t constexpr static MAX_ENTRY_SIZE = 27; // With a 10-byte cycle count
+
+TraceWriter::TraceWriter(std::string const& path) : file(path, std::ios::binary){
+    if (!file){
+        throw std::runtime_error("Failed to open trace file " + path);
+    }
+    file.write(TRACE_FILE_HEADER.data(), TRACE_FILE_HEADER.size());
+    buffer.reserve(bufferSize);
+    writer = std::thread(&TraceWriter::writeBuffers, this);
+}
+
+TraceWriter::~TraceWriter(){
+    submitBuffer();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        finished = true;
+    }
+    buffersReady.notify_one();
+    writer.join();
+    if (!file){
+        std::cout << "Failed to write trace file\n";
+    }
+}
+
+void TraceWriter::record(TraceRecord const& record){
+    uint8_t registerMask = 0x00;
+    for (std::size_t i = 0 ; i < record.registers.size() ; ++i){
+        if (record.registers[i] != previous.registers[i]){
+            registerMask |= 0b1 << i;
+        }
+    }
+    uint8_t flags = record.length & FLAG_LENGTH;
+    if (record.PC != uint16_t(previous.PC + previous.length)){
+        flags |= FLAG_PC;
+    }
+    if (record.SP != previous.SP){
+        flags |= FLAG_SP;
+    }
+    buffer.push_back(registerMask);
+    buffer.push_back(flags);
+    uint64_t cycles = record.cycle - previous.cycle;
+    while (cycles >= 0x80){
+        buffer.push_back(uint8_t(cycles) | 0x80);
+        cycles >>= 7;
+    }
+    buffer.push_back(uint8_t(cycles));
+    if (flags & FLAG_PC){
+        buffer.push_back(uint8_t(record.PC));
+        buffer.push_back(uint8_t(record.PC >> 8));
+    }
+    buffer.insert(buffer.end(), record.opcodeBytes.begin(), record.opcodeBytes.begin() + record.length);
+    for (std::size_t i = 0 ; i < record.registers.size() ; ++i){
+        if (registerMask & (0b1 << i)){
+            buffer.push_back(record.registers[i]);
+        }
+    }
+    if (flags & FLAG_SP){
+        buffer.push_back(uint8_t(record.SP));
+        buffer.push_back(uint8_t(record.SP >> 8));
+    }
+    previous = record;
+    if (buffer.size() > bufferSize - MAX_ENTRY_SIZE){
+        submitBuffer();
+    }
+}
+
+// Hands the current buffer to the writer thread, continuing with a spare one
+void TraceWriter::submitBuffer(){
+    std::vector<uint8_t> next;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        fullBuffers.push_back(std::move(buffer));
+        if (!spareBuffers.empty()){
+            next = std::move(spareBuffers.back());
+            spareBuffers.pop_back();
+        }
+    }
+    buffersReady.notify_one();
+    next.clear();
+    next.reserve(bufferSize);
+    buffer = std::move(next);
+}
+
+// Runs on the writer thread until the writer is destroyed, writing buffers in the order they were filled
+void TraceWriter::writeBuffers(){
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true){
+        buffersReady.wait(lock, [this]{ return finished || !fullBuffers.empty(); });
+        if (fullBuffers.empty()){
+            return; // Finished, and everything has been written
+        }
+        std::vector<uint8_t> fullBuffer = std::move(fullBuffers.front());
+        fullBuffers.pop_front();
+        lock.unlock();
+        file.write(reinterpret_cast<char const*>(fullBuffer.data()), fullBuffer.size());
+        lock.lock();
+        spareBuffers.push_back(std::move(fullBuffer));
+    }
+}
+
+TraceReader::TraceReader(std::string const& path) : file(path, std::ios::binary){
+    std::array<char, TRACE_FILE_HEADER.size()> header{};
+    if (!file.read(header.data(), header.size()) || header != TRACE_FILE_HEADER){
+        throw std::runtime_error("Failed to read trace file " + path);
+    }
+    buffer.reserve(bufferSize);
+}
+
+// Decodes the next record, returning false at the end of the file
+bool TraceReader::next(TraceRecord& record){
+    if (!fill(2)){
+        return false;
+    }
+    uint8_t const registerMask = buffer[position];
+    uint8_t const flags = buffer[position + 1];
+    // Check the rest of the entry is present, assuming the longest possible cycle count
+    fill(MAX_ENTRY_SIZE);
+    position += 2;
+    uint64_t cycles = 0;
+    for (unsigned int shift = 0 ; position < buffer.size() ; shift += 7){
+        uint8_t const byte = buffer[position++];
+        cycles |= uint64_t(byte & 0x7F) << shift;
+        if (!(byte & 0x80)){
+            break;
+        }
+    }
+    std::size_t const remaining = ((flags & FLAG_PC) ? 2 : 0) + (flags & FLAG_LENGTH) + std::popcount(registerMask) + ((flags & FLAG_SP) ? 2 : 0);
+    if (buffer.size() - position < remaining){
+        throw std::runtime_error("Trace file is truncated");
+    }
+    current.cycle += cycles;
+    current.PC += current.length;
+    if (flags & FLAG_PC){
+        current.PC = buffer[position] | (buffer[position + 1] << 8);
+        position += 2;
+    }
+    current.length = flags & FLAG_LENGTH;
+    current.opcodeBytes = {};
+    for (uint8_t i = 0 ; i < current.length ; ++i){
+        current.opcodeBytes[i] = buffer[position++];
+    }
+    for (std::size_t i = 0 ; i < current.registers.size() ; ++i){
+        if (registerMask & (0b1 << i)){
+            current.registers[i] = buffer[position++];
+        }
+    }
+    if (flags & FLAG_SP){
+        current.SP = buffer[position] | (buffer[position + 1] << 8);
+        position += 2;
+    }
+    record = current;
+    return true;
+}
+
+// Ensures at least bytes are buffered (if the file holds that many), returning false if it does not
+bool TraceReader::fill(std::size_t bytes){
+    if (buffer.size() - position >= bytes){
+        return true;
+    }
+    buffer.erase(buffer.begin(), buffer.begin() + position);
+    position = 0;
+    std::size_t const kept = buffer.size();
+    buffer.resize(bufferSize);
+    file.read(reinterpret_cast<char*>(buffer.data() + kept), bufferSize - kept);
+    buffer.resize(kept + file.gcount());
+    return buffer.size() >= bytes;
+}
+
+void static printRecord(uint64_t index, TraceRecord const& record){
+    auto const& r = record.registers;
+    std::cout << "\t#" << std::dec << index << " cycle " << record.cycle << std::hex << std::setfill('0')
+              << " PC 0x" << std::setw(4) << record.PC << " opcode";
+    for (uint8_t i = 0 ; i < record.length ; ++i){
+        std::cout << " " << std::setw(2) << +record.opcodeBytes[i];
+    }
+    std::cout << " (" << disassemble(record.opcodeBytes.data()) << ")";
+    std::cout << " AF 0x" << std::setw(2) << +r[0] << std::setw(2) << +r[1] << " BC 0x" << std::setw(2) << +r[2] << std::setw(2) << +r[3]
+              << " DE 0x" << std::setw(2) << +r[4] << std::setw(2) << +r[5] << " HL 0x" << std::setw(2) << +r[6] << std::setw(2) << +r[7]
+              << " SP 0x" << std::setw(4) << record.SP << std::dec << "\n";
+}
+
+// Compares two trace files, reporting the first instruction at which they differ
+// Returns true if the traces are identical
+bool TraceReader::diff(std::string const& pathA, std::string const& pathB){
+    TraceReader readerA(pathA), readerB(pathB);
+    TraceRecord a, b, last;
+    uint64_t index = 0;
+    while (true){
+        bool const moreA = readerA.next(a);
+        bool const moreB = readerB.next(b);
+        if (!moreA && !moreB){
+            std::cout << "Traces are identical (" << index << " instructions)\n";
+            return true;
+        }
+        if (moreA != moreB){
+            std::cout << "Traces are identical for " << index << " instructions, then " << (moreA ? pathB : pathA) << " ends\n";
+            return false;
+        }
+        if (!(a == b)){
+            std::cout << "Traces diverge at instruction " << index << "\n";
+            if (index != 0){
+                printRecord(index - 1, last);
+            }
+            std::cout << pathA << ":\n";
+            printRecord(index, a);
+            std::cout << pathB << ":\n";
+            printRecord(index, b);
+            return false;
+        }
+        last = a;
+        ++index;
+    }
+}
\ No newline at end of file